@@ -0,0 +1,166 @@
+﻿using Microsoft.Maker.Firmata;
+using Microsoft.Maker.RemoteWiring;
+using Microsoft.VisualStudio.TestPlatform.UnitTestFramework;
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace RemoteWiringUnitTests
+{
+    [TestClass]
+    public class FirmataParserTests
+    {
+        private const int ResponseReadTimeout = 10000;
+
+        // Longer than the message timeout of the Firmata parser
+        private const int MessageTimeoutDelay = 700;
+
+        private static MockBoard CreateBoard()
+        {
+            var pin = new MockPin(0);
+
+            pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.INPUT, 1));
+            pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.PULLUP, 1));
+            pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.OUTPUT, 1));
+
+            return new MockBoard(new List<MockPin>() { pin });
+        }
+
+        [TestMethod]
+        public async Task TestParserMessageSplitAcrossReadsSuccess()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            byte pinUnderTest = 0;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            deviceUnderTest.pinMode(pinUnderTest, PinMode.INPUT);
+            var abortedBefore = deviceUnderTest.getMetrics().Connection.MessagesAborted;
+
+            // Act
+            deviceHelper.Stream.SendRawBytes((ushort)Command.DIGITAL_MESSAGE, 0x01);
+            Assert.IsTrue(deviceHelper.Stream.WaitForResponseRead(ResponseReadTimeout), "First half of the message was not read");
+            Assert.AreEqual(PinState.LOW, deviceUnderTest.digitalRead(pinUnderTest), "Partial message was reported");
+
+            deviceHelper.Stream.SendRawBytes(0x00);
+            Assert.IsTrue(deviceHelper.Stream.WaitForResponseRead(ResponseReadTimeout), "Second half of the message was not read");
+
+            // Wait for the report to be processed
+            await Task.Delay(100);
+
+            // Assert
+            Assert.AreEqual(PinState.HIGH, deviceUnderTest.digitalRead(pinUnderTest), "Message split across reads was not reassembled");
+            Assert.AreEqual(abortedBefore, deviceUnderTest.getMetrics().Connection.MessagesAborted, "Message split across reads was aborted");
+        }
+
+        [TestMethod]
+        public async Task TestParserSysexSpanningReadsSuccess()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            var expectedMessage = "Hi";
+            string actualMessage = null;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            deviceUnderTest.StringMessageReceived += (message) => { actualMessage = message; };
+
+            // Act
+            // Each character is sent as two 7-bit bytes
+            deviceHelper.Stream.SendRawBytes((ushort)Command.START_SYSEX, (ushort)SysexCommand.STRING_DATA, (ushort)'H');
+            Assert.IsTrue(deviceHelper.Stream.WaitForResponseRead(ResponseReadTimeout), "First part of the sysex message was not read");
+
+            deviceHelper.Stream.SendRawBytes(0x00, (ushort)'i');
+            Assert.IsTrue(deviceHelper.Stream.WaitForResponseRead(ResponseReadTimeout), "Second part of the sysex message was not read");
+            Assert.IsNull(actualMessage, "Partial sysex message was reported");
+
+            deviceHelper.Stream.SendRawBytes(0x00, (ushort)Command.END_SYSEX);
+            Assert.IsTrue(deviceHelper.Stream.WaitForResponseRead(ResponseReadTimeout), "Last part of the sysex message was not read");
+
+            // Wait for the message to be processed
+            await Task.Delay(100);
+
+            // Assert
+            Assert.AreEqual(expectedMessage, actualMessage, "Sysex message spanning reads was not reassembled");
+        }
+
+        [TestMethod]
+        public async Task TestParserPartialMessageTimesOut()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            byte pinUnderTest = 0;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            deviceUnderTest.pinMode(pinUnderTest, PinMode.INPUT);
+            var timedOutBefore = deviceUnderTest.getMetrics().Connection.MessagesTimedOut;
+
+            // Act
+            deviceHelper.Stream.SendRawBytes((ushort)Command.DIGITAL_MESSAGE, 0x01);
+            Assert.IsTrue(deviceHelper.Stream.WaitForResponseRead(ResponseReadTimeout), "Partial message was not read");
+
+            await Task.Delay(MessageTimeoutDelay);
+
+            // The late byte would complete the stale message if it had not been discarded
+            deviceHelper.Stream.SendRawBytes(0x00);
+            Assert.IsTrue(deviceHelper.Stream.WaitForResponseRead(ResponseReadTimeout), "Late byte was not read");
+
+            // Wait for the byte to be processed
+            await Task.Delay(100);
+
+            // Assert
+            Assert.AreEqual(PinState.LOW, deviceUnderTest.digitalRead(pinUnderTest), "Timed out message was completed by a late byte");
+            Assert.AreEqual(timedOutBefore + 1, deviceUnderTest.getMetrics().Connection.MessagesTimedOut, "Timed out message was not counted");
+        }
+
+        [TestMethod]
+        public async Task TestParserUnknownByteSkipped()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            byte pinUnderTest = 0;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            deviceUnderTest.pinMode(pinUnderTest, PinMode.INPUT);
+            var skippedBefore = deviceUnderTest.getMetrics().Connection.UnknownBytesSkipped;
+
+            // Act
+            // A data byte received outside of a message, followed by a complete message
+            deviceHelper.Stream.SendRawBytes(0x05, (ushort)Command.DIGITAL_MESSAGE, 0x01, 0x00);
+            Assert.IsTrue(deviceHelper.Stream.WaitForResponseRead(ResponseReadTimeout), "Message was not read");
+
+            // Wait for the report to be processed
+            await Task.Delay(100);
+
+            // Assert
+            Assert.AreEqual(skippedBefore + 1, deviceUnderTest.getMetrics().Connection.UnknownBytesSkipped, "Unknown byte was not skipped");
+            Assert.AreEqual(PinState.HIGH, deviceUnderTest.digitalRead(pinUnderTest), "Message following an unknown byte was not parsed");
+        }
+    }
+}
@@ -3,6 +3,7 @@ using Microsoft.VisualStudio.TestPlatform.UnitTestFramework;
 using System;
 using System.Collections.Generic;
 using System.Linq;
+using System.Runtime.InteropServices.WindowsRuntime;
 using System.Text;
 using System.Threading;
 using System.Threading.Tasks;
@@ -153,6 +154,56 @@ namespace RemoteWiringUnitTests
             Assert.AreEqual(totalExpectedI2cPins, deviceUnderTest.DeviceHardwareProfile.I2cPins.Count(), "I2c pins were not correctly enumerated");
             Assert.AreEqual(totalExpectedPwmPins, deviceUnderTest.DeviceHardwareProfile.PwmPins.Count(), "Pwm pins were not correctly enumerated");
             Assert.AreEqual(totalExpectedServoPins, deviceUnderTest.DeviceHardwareProfile.ServoPins.Count(), "Servo pins were not correctly enumerated");
+
+            // The views list the same pins, and are built once rather than on every access
+            var profile = deviceUnderTest.DeviceHardwareProfile;
+            CollectionAssert.AreEqual(profile.AnalogPins.ToList(), profile.AnalogPinsView.ToList(), "Analog pin view does not match");
+            CollectionAssert.AreEqual(profile.DigitalPins.ToList(), profile.DigitalPinsView.ToList(), "Digital pin view does not match");
+            CollectionAssert.AreEqual(profile.DisabledPins.ToList(), profile.DisabledPinsView.ToList(), "Disabled pin view does not match");
+            CollectionAssert.AreEqual(profile.I2cPins.ToList(), profile.I2cPinsView.ToList(), "I2c pin view does not match");
+            CollectionAssert.AreEqual(profile.PwmPins.ToList(), profile.PwmPinsView.ToList(), "Pwm pin view does not match");
+            CollectionAssert.AreEqual(profile.ServoPins.ToList(), profile.ServoPinsView.ToList(), "Servo pin view does not match");
+            Assert.AreSame(profile.ServoPinsView, profile.ServoPinsView, "Pin view was rebuilt on access");
+        }
+
+        [TestMethod]
+        public void TestUnknownModeValueSkipped()
+        {
+            // Arrange
+            // SHIFT is not a capability the profile records; its value byte happens to equal PWM and must not be read as the next mode
+            byte[] capabilityResponse =
+            {
+                (byte)PinMode.SHIFT, (byte)PinMode.PWM,
+                (byte)PinMode.OUTPUT, 1,
+                0x7F
+            };
+
+            // Act
+            var profile = new HardwareProfile(capabilityResponse.AsBuffer());
+
+            // Assert
+            Assert.IsTrue(profile.IsValid, "Capability response with an unknown mode was rejected");
+            Assert.AreEqual(1, profile.TotalPinCount, "Unknown mode changed the pin count");
+            Assert.IsTrue(profile.isDigitalOutputSupported(0), "Mode following the unknown mode was not recorded");
+            Assert.IsFalse(profile.isPwmSupported(0), "Value byte of the unknown mode was read as a mode");
+        }
+
+        [TestMethod]
+        public void TestMoreThanMaxPinsRejected()
+        {
+            // Arrange
+            // A pin with no modes is described by its end-of-pin marker alone
+            byte[] maxPins = Enumerable.Repeat((byte)0x7F, 128).ToArray();
+            byte[] tooManyPins = Enumerable.Repeat((byte)0x7F, 129).ToArray();
+
+            // Act
+            var maxProfile = new HardwareProfile(maxPins.AsBuffer());
+            var tooManyProfile = new HardwareProfile(tooManyPins.AsBuffer());
+
+            // Assert
+            Assert.IsTrue(maxProfile.IsValid, "Capability response with 128 pins was rejected");
+            Assert.AreEqual(128, maxProfile.TotalPinCount, "Total pin count was not communicated properly");
+            Assert.IsFalse(tooManyProfile.IsValid, "Capability response with more than 128 pins was accepted");
         }
 
         [TestMethod]
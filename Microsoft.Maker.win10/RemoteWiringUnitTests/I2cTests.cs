@@ -0,0 +1,187 @@
+﻿using Microsoft.Maker.Firmata;
+using Microsoft.Maker.RemoteWiring;
+using Microsoft.VisualStudio.TestPlatform.UnitTestFramework;
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Runtime.InteropServices.WindowsRuntime;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace RemoteWiringUnitTests
+{
+    [TestClass]
+    public class I2cTests
+    {
+        private const byte DeviceAddress = 0x68;
+        private const byte DeviceRegister = 0x3B;
+        private const int ResponseReadTimeout = 10000;
+
+        private static MockBoard CreateBoard()
+        {
+            var pin = new MockPin(0);
+
+            pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.INPUT, 1));
+            pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.OUTPUT, 1));
+            pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.I2C, 1));
+
+            return new MockBoard(new List<MockPin>() { pin });
+        }
+
+        // An I2C_REPLY sysex message, every byte sent as two 7-bit bytes
+        private static ushort[] PrepareI2cReply(byte address, byte register, params byte[] data)
+        {
+            var message = new List<ushort>();
+            message.Add((ushort)Command.START_SYSEX);
+            message.Add((ushort)SysexCommand.I2C_REPLY);
+
+            foreach (var value in new byte[] { address, register }.Concat(data))
+            {
+                message.Add((ushort)(value & 0x7F));
+                message.Add((ushort)(value >> 7));
+            }
+
+            message.Add((ushort)Command.END_SYSEX);
+            return message.ToArray();
+        }
+
+        [TestMethod]
+        public async Task TestI2cLateReplyDiscarded()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            byte lateValue = 0x11;
+            byte expectedValue = 0x22;
+            bool timedOut = false;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            var i2c = deviceUnderTest.I2c;
+
+            // Act
+            try
+            {
+                await i2c.readAsync(DeviceAddress, DeviceRegister, 1, 100);
+            }
+            catch (Exception)
+            {
+                timedOut = true;
+            }
+
+            var read = i2c.readAsync(DeviceAddress, DeviceRegister, 1, 5000).AsTask();
+
+            // The reply to the read which timed out arrives ahead of the reply to the second read
+            deviceHelper.Stream.SendRawBytes(PrepareI2cReply(DeviceAddress, DeviceRegister, lateValue));
+            Assert.IsTrue(deviceHelper.Stream.WaitForResponseRead(ResponseReadTimeout), "Late reply was not read");
+
+            deviceHelper.Stream.SendRawBytes(PrepareI2cReply(DeviceAddress, DeviceRegister, expectedValue));
+            var reply = await read;
+
+            // Assert
+            Assert.IsTrue(timedOut, "First read did not time out");
+            Assert.AreEqual(expectedValue, reply.ToArray()[0], "Read was completed with the reply to a read which had timed out");
+        }
+
+        [TestMethod]
+        public void TestI2cBlockPastLastRegisterRejected()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            bool readRejected = false;
+            bool writeRejected = false;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            var i2c = deviceUnderTest.I2c;
+
+            // Act
+            try
+            {
+                i2c.readBlockAsync(DeviceAddress, 0xF0, 32);
+            }
+            catch (ArgumentException)
+            {
+                readRejected = true;
+            }
+
+            try
+            {
+                i2c.writeBlockAsync(DeviceAddress, 0xF0, new byte[32].AsBuffer());
+            }
+            catch (ArgumentException)
+            {
+                writeRejected = true;
+            }
+
+            // Assert
+            Assert.IsTrue(readRejected, "Read running past register 0xFF was not rejected");
+            Assert.IsTrue(writeRejected, "Write running past register 0xFF was not rejected");
+        }
+
+        [TestMethod]
+        public void TestI2cTransmissionSentUnchanged()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            bool tooLongRejected = false;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            var i2c = deviceUnderTest.I2c;
+            deviceHelper.Stream.TakeSentBytes();
+
+            // Act
+            // A two byte EEPROM address followed by data; no byte of it may be treated as a register
+            i2c.beginTransmission(DeviceAddress);
+            for (int i = 0; i < 30; i++)
+            {
+                i2c.write((byte)i);
+            }
+            i2c.endTransmission();
+            var sent = deviceHelper.Stream.TakeSentBytes();
+
+            i2c.beginTransmission(DeviceAddress);
+            for (int i = 0; i < 31; i++)
+            {
+                i2c.write((byte)i);
+            }
+
+            try
+            {
+                i2c.endTransmission();
+            }
+            catch (ArgumentException)
+            {
+                tooLongRejected = true;
+            }
+
+            // Assert
+            var expected = new List<ushort>() { (ushort)Command.START_SYSEX, (ushort)SysexCommand.I2C_REQUEST, DeviceAddress, 0 };
+            for (int i = 0; i < 30; i++)
+            {
+                expected.Add((ushort)i);
+                expected.Add(0);
+            }
+            expected.Add((ushort)Command.END_SYSEX);
+
+            CollectionAssert.AreEqual(expected, sent, "Transmission was not sent as one unchanged I2C request");
+            Assert.IsTrue(tooLongRejected, "Transmission longer than one I2C request was not rejected");
+        }
+    }
+}
@@ -25,6 +25,9 @@ namespace RemoteWiringUnitTests
         public List<UInt16> LastFlushedReadBuffer;
         public uint BaudRate;
 
+        // Every byte flushed to the board, in order
+        private List<UInt16> sentBytes;
+
         private bool writeBufferFlushing;
 
         public event IStreamConnectionCallback ConnectionEstablished;
@@ -45,6 +48,7 @@ namespace RemoteWiringUnitTests
             this.ResponseBuffer = new List<UInt16>();
             this.ActiveReadBuffer = new List<UInt16>();
             this.LastFlushedReadBuffer = new List<UInt16>();
+            this.sentBytes = new List<UInt16>();
         }
 
         public ushort available()
@@ -73,6 +77,11 @@ namespace RemoteWiringUnitTests
             this.ActiveReadBuffer.Clear();
             if (this.LastFlushedReadBuffer.Count == 0) return;
 
+            lock (this.sentBytes)
+            {
+                this.sentBytes.AddRange(this.LastFlushedReadBuffer);
+            }
+
             bool isSysEx = false;
 
             Command command = (Command)this.LastFlushedReadBuffer[0];
@@ -151,6 +160,35 @@ namespace RemoteWiringUnitTests
             sendMessage(prepareDigitalUpdateMessage(pinNumber, state));
         }
 
+        /// <summary>
+        /// Returns every byte flushed to the board since the last call
+        /// </summary>
+        public List<UInt16> TakeSentBytes()
+        {
+            lock (this.sentBytes)
+            {
+                var bytes = new List<UInt16>(this.sentBytes);
+                this.sentBytes.Clear();
+                return bytes;
+            }
+        }
+
+        /// <summary>
+        /// Sends arbitrary bytes to the device; the device receives them in a single read
+        /// </summary>
+        public void SendRawBytes(params ushort[] bytes)
+        {
+            sendMessage(new List<UInt16>(bytes));
+        }
+
+        /// <summary>
+        /// Waits until the device has read every byte of the last response, so the next response arrives in a separate read
+        /// </summary>
+        public bool WaitForResponseRead(int millisecondsTimeout)
+        {
+            return SpinWait.SpinUntil(() => { return !this.writeBufferFlushing; }, millisecondsTimeout);
+        }
+
         private void sendMessage(List<UInt16> message)
         {
             this.ResponseBuffer.Clear();
@@ -255,7 +293,11 @@ namespace RemoteWiringUnitTests
 
         public ushort write(byte[] buffer_)
         {
-            throw new NotImplementedException();
+            foreach (var c_ in buffer_)
+            {
+                this.ActiveReadBuffer.Add(c_);
+            }
+            return (ushort)buffer_.Length;
         }
     }
 }
@@ -27,6 +27,11 @@ namespace RemoteWiringUnitTests
 
         private MockStream mockFirmataStream;
 
+        public MockStream Stream
+        {
+            get { return this.mockFirmataStream; }
+        }
+
         public RemoteDevice CreateDeviceUnderTestAndConnect(MockBoard board)
         {
             // setup and start connection events
@@ -0,0 +1,246 @@
+﻿using Microsoft.Maker.Firmata;
+using Microsoft.Maker.RemoteWiring;
+using Microsoft.VisualStudio.TestPlatform.UnitTestFramework;
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace RemoteWiringUnitTests
+{
+    [TestClass]
+    public class RemoteDeviceTests
+    {
+        private static MockBoard CreateBoard()
+        {
+            var pin = new MockPin(0);
+
+            pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.INPUT, 1));
+            pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.PULLUP, 1));
+            pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.OUTPUT, 1));
+
+            return new MockBoard(new List<MockPin>() { pin });
+        }
+
+        private static bool ContainsSequence(List<UInt16> bytes, params UInt16[] sequence)
+        {
+            for (int start = 0; start + sequence.Length <= bytes.Count; start++)
+            {
+                if (bytes.Skip(start).Take(sequence.Length).SequenceEqual(sequence)) return true;
+            }
+
+            return false;
+        }
+
+        [TestMethod]
+        public void TestRedundantDigitalWriteSuppressed()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            byte pinUnderTest = 0;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            deviceUnderTest.setRedundantCommandSuppression(true);
+            deviceUnderTest.pinMode(pinUnderTest, PinMode.OUTPUT);
+            deviceUnderTest.digitalWrite(pinUnderTest, PinState.HIGH);
+            var firstWrite = deviceHelper.Stream.TakeSentBytes();
+            var suppressedBefore = deviceUnderTest.getSuppressedCommandCount();
+
+            // Act
+            deviceUnderTest.digitalWrite(pinUnderTest, PinState.HIGH);
+            var secondWrite = deviceHelper.Stream.TakeSentBytes();
+
+            // Assert
+            Assert.IsTrue(ContainsSequence(firstWrite, (ushort)Command.DIGITAL_MESSAGE, 0x01, 0x00), "First write was not sent");
+            Assert.AreEqual(0, secondWrite.Count, "Redundant write was sent to the board");
+            Assert.AreEqual(suppressedBefore + 1, deviceUnderTest.getSuppressedCommandCount(), "Redundant write was not counted");
+            Assert.AreEqual(PinState.HIGH, deviceUnderTest.digitalRead(pinUnderTest), "Suppressed write changed the cached state");
+        }
+
+        [TestMethod]
+        public void TestRedundantPinModeSuppressed()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            byte pinUnderTest = 0;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            deviceUnderTest.setRedundantCommandSuppression(true);
+            deviceUnderTest.pinMode(pinUnderTest, PinMode.OUTPUT);
+            var firstMode = deviceHelper.Stream.TakeSentBytes();
+            var suppressedBefore = deviceUnderTest.getSuppressedCommandCount();
+
+            // Act
+            deviceUnderTest.pinMode(pinUnderTest, PinMode.OUTPUT);
+            var secondMode = deviceHelper.Stream.TakeSentBytes();
+
+            // Assert
+            Assert.IsTrue(ContainsSequence(firstMode, (ushort)Command.SET_PIN_MODE, pinUnderTest, (ushort)PinMode.OUTPUT), "First pin mode was not sent");
+            Assert.AreEqual(0, secondMode.Count, "Redundant pin mode was sent to the board");
+            Assert.AreEqual(suppressedBefore + 1, deviceUnderTest.getSuppressedCommandCount(), "Redundant pin mode was not counted");
+        }
+
+        [TestMethod]
+        public void TestCommandsNotSuppressedByDefault()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            byte pinUnderTest = 0;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            deviceUnderTest.pinMode(pinUnderTest, PinMode.OUTPUT);
+            deviceUnderTest.digitalWrite(pinUnderTest, PinState.HIGH);
+            deviceHelper.Stream.TakeSentBytes();
+
+            // Act
+            deviceUnderTest.digitalWrite(pinUnderTest, PinState.HIGH);
+            var secondWrite = deviceHelper.Stream.TakeSentBytes();
+
+            // Assert
+            Assert.IsTrue(ContainsSequence(secondWrite, (ushort)Command.DIGITAL_MESSAGE, 0x01, 0x00), "Repeated write was not sent");
+            Assert.AreEqual(0UL, deviceUnderTest.getSuppressedCommandCount(), "A command was suppressed while suppression was disabled");
+        }
+
+        [TestMethod]
+        public void TestRefreshDeviceStateResendsEverything()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            byte pinUnderTest = 0;
+
+            var board = CreateBoard();
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(board);
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            deviceUnderTest.setRedundantCommandSuppression(true);
+            deviceUnderTest.pinMode(pinUnderTest, PinMode.OUTPUT);
+            deviceUnderTest.digitalWrite(pinUnderTest, PinState.HIGH);
+            deviceHelper.Stream.TakeSentBytes();
+
+            // Act
+            deviceUnderTest.refreshDeviceState();
+            var refresh = deviceHelper.Stream.TakeSentBytes();
+
+            deviceUnderTest.digitalWrite(pinUnderTest, PinState.HIGH);
+            var writeAfterRefresh = deviceHelper.Stream.TakeSentBytes();
+
+            // Assert
+            Assert.IsTrue(ContainsSequence(refresh, (ushort)Command.SET_PIN_MODE, pinUnderTest, (ushort)PinMode.OUTPUT), "Pin mode was not re-sent");
+            Assert.IsTrue(ContainsSequence(refresh, (ushort)Command.DIGITAL_MESSAGE, 0x01, 0x00), "Digital port value was not re-sent");
+            Assert.AreEqual(0, writeAfterRefresh.Count, "Refreshed state was not recorded as sent");
+        }
+
+        [TestMethod]
+        public void TestReportDigitalPinEnablesPort()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            byte pinUnderTest = 2;
+
+            var pins = new List<MockPin>();
+            for (byte i = 0; i <= pinUnderTest; i++)
+            {
+                var pin = new MockPin(i);
+                pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.INPUT, 1));
+                pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.OUTPUT, 1));
+                pins.Add(pin);
+            }
+
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(new MockBoard(pins));
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            // Act
+            deviceUnderTest.pinMode(pinUnderTest, PinMode.INPUT);
+            var subscribe = deviceHelper.Stream.TakeSentBytes();
+
+            deviceUnderTest.refreshDeviceState();
+            var refresh = deviceHelper.Stream.TakeSentBytes();
+
+            deviceUnderTest.pinMode(pinUnderTest, PinMode.OUTPUT);
+            var unsubscribe = deviceHelper.Stream.TakeSentBytes();
+
+            // Assert
+            // The argument of REPORT_DIGITAL_PIN enables or disables reporting of the whole port, it is not a pin mask
+            Assert.IsTrue(ContainsSequence(subscribe, (ushort)Command.REPORT_DIGITAL_PIN, 1), "Port reporting was not enabled");
+            Assert.IsTrue(ContainsSequence(refresh, (ushort)Command.REPORT_DIGITAL_PIN, 1), "Port reporting was not re-enabled");
+            Assert.IsTrue(ContainsSequence(unsubscribe, (ushort)Command.REPORT_DIGITAL_PIN, 0), "Port reporting was not disabled");
+        }
+
+        [TestMethod]
+        public void TestAnalogWriteEncoding()
+        {
+            // Arrange
+            RemoteDevice deviceUnderTest = null;
+            RemoteDeviceHelper deviceHelper = new RemoteDeviceHelper();
+            byte compactPin = 3;
+            byte extendedPin = 20;
+            ushort pwmResolution = 8;
+
+            var pins = new List<MockPin>();
+            for (byte i = 0; i <= extendedPin; i++)
+            {
+                var pin = new MockPin(i);
+                pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.OUTPUT, 1));
+                pin.SupportedModes.Add(new KeyValuePair<PinMode, ushort>(PinMode.PWM, pwmResolution));
+                pins.Add(pin);
+            }
+
+            deviceUnderTest = deviceHelper.CreateDeviceUnderTestAndConnect(new MockBoard(pins));
+
+            // Wait until the mock board is ready
+            SpinWait.SpinUntil(() => { return deviceHelper.DeviceState == DeviceState.Ready; }, 100000);
+
+            deviceUnderTest.pinMode(compactPin, PinMode.PWM);
+            deviceUnderTest.pinMode(extendedPin, PinMode.PWM);
+            deviceHelper.Stream.TakeSentBytes();
+
+            // Act
+            deviceUnderTest.analogWrite(compactPin, 200);
+            var compact = deviceHelper.Stream.TakeSentBytes();
+
+            deviceUnderTest.analogWrite(extendedPin, 200);
+            var extended = deviceHelper.Stream.TakeSentBytes();
+
+            deviceUnderTest.analogWrite(compactPin, 1000);
+            var saturated = deviceHelper.Stream.TakeSentBytes();
+
+            // Assert
+            CollectionAssert.AreEqual(new List<ushort>() { 0xE3, 0x48, 0x01 }, compact, "Pin 3 was not sent as a compact ANALOG_MESSAGE");
+
+            // START_SYSEX, EXTENDED_ANALOG, pin, at least two value bytes, END_SYSEX
+            Assert.IsTrue(extended.Count >= 6, "EXTENDED_ANALOG carried fewer than two value bytes");
+            CollectionAssert.AreEqual(new List<ushort>() { (ushort)Command.START_SYSEX, (ushort)SysexCommand.EXTENDED_ANALOG, extendedPin, 0x48, 0x01 }, extended.Take(5).ToList(), "Pin 20 was not sent with EXTENDED_ANALOG");
+            Assert.IsTrue(extended.Skip(5).Take(extended.Count - 6).All(b => b == 0), "EXTENDED_ANALOG value carried extra bits");
+            Assert.AreEqual((ushort)Command.END_SYSEX, extended.Last(), "EXTENDED_ANALOG was not terminated");
+
+            // 1000 does not fit in 8 bits, so it is sent as 255
+            CollectionAssert.AreEqual(new List<ushort>() { 0xE3, 0x7F, 0x01 }, saturated, "Value above the PWM resolution was not saturated");
+        }
+    }
+}
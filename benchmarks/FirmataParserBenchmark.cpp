@@ -0,0 +1,530 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "FirmataParser.h"
+#include "ProtocolTrace.h"
+#include "SevenBitCodec.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::Maker::Firmata;
+
+//******************************************************************************
+//* Allocation counting
+//******************************************************************************
+
+namespace {
+    std::atomic<uint64_t> allocations( ATOMIC_VAR_INIT( 0 ) );
+}
+
+void *
+operator new(
+    size_t size_
+    )
+{
+    allocations.fetch_add( 1, std::memory_order_relaxed );
+    void *memory = std::malloc( size_ ? size_ : 1 );
+    if( !memory ) throw std::bad_alloc();
+    return memory;
+}
+
+void
+operator delete(
+    void *memory_
+    ) noexcept
+{
+    std::free( memory_ );
+}
+
+void
+operator delete(
+    void *memory_,
+    size_t
+    ) noexcept
+{
+    std::free( memory_ );
+}
+
+namespace {
+
+//******************************************************************************
+//* Workloads
+//******************************************************************************
+
+    typedef FirmataParser::clock clock;
+
+    //command values as sent by StandardFirmata
+    const uint8_t ANALOG_MESSAGE = 0xE0;
+    const uint8_t DIGITAL_MESSAGE = 0x90;
+    const uint8_t START_SYSEX = 0xF0;
+    const uint8_t END_SYSEX = 0xF7;
+    const uint8_t STRING_DATA = 0x71;
+    const uint8_t I2C_REPLY = 0x77;
+
+    //the parser is configured with the same timeout UwpFirmata uses
+    const std::chrono::milliseconds MESSAGE_TIMEOUT( 500 );
+
+    //bytes handed to the parser per call; a full-speed USB CDC packet
+    const size_t CHUNK_SIZE = 64;
+
+    const size_t MESSAGES_PER_WORKLOAD = 1 << 20;
+    const double SECONDS_PER_RUN = 0.5;
+
+    //a chunk of received bytes and the simulated time at which it arrived
+    struct Chunk
+    {
+        size_t offset;
+        size_t length;
+        clock::duration arrival;
+    };
+
+    struct Workload
+    {
+        std::string name;
+        std::vector<uint8_t> bytes;
+        std::vector<Chunk> chunks;
+    };
+
+    //splits the stream into CHUNK_SIZE reads, one per simulated microsecond
+    void
+    chunkEvenly(
+        Workload &workload_
+    )
+    {
+        for( size_t offset = 0; offset < workload_.bytes.size(); offset += CHUNK_SIZE )
+        {
+            Chunk chunk = { offset, ( std::min )( CHUNK_SIZE, workload_.bytes.size() - offset ), std::chrono::microseconds( workload_.chunks.size() ) };
+            workload_.chunks.push_back( chunk );
+        }
+    }
+
+    void
+    appendChannelMessage(
+        std::vector<uint8_t> &bytes_,
+        uint8_t command_,
+        uint8_t channel_,
+        uint16_t value_
+    )
+    {
+        bytes_.push_back( command_ | ( channel_ & 0x0F ) );
+        bytes_.push_back( value_ & 0x7F );
+        bytes_.push_back( ( value_ >> 7 ) & 0x7F );
+    }
+
+    void
+    appendSysex(
+        std::vector<uint8_t> &bytes_,
+        uint8_t command_,
+        const std::vector<uint8_t> &payload_
+    )
+    {
+        size_t start = bytes_.size();
+        bytes_.push_back( START_SYSEX );
+        bytes_.push_back( command_ );
+        bytes_.resize( start + 2 + payload_.size() * 2 );
+        SevenBitCodec::encode( payload_.data(), payload_.size(), bytes_.data() + start + 2 );
+        bytes_.push_back( END_SYSEX );
+    }
+
+    Workload
+    analogFlood(
+        std::mt19937 &random_
+    )
+    {
+        Workload workload = { "analog flood (16 pins)", {}, {} };
+        for( size_t i = 0; i < MESSAGES_PER_WORKLOAD; ++i )
+        {
+            appendChannelMessage( workload.bytes, ANALOG_MESSAGE, i % 16, random_() & 0x3FF );
+        }
+        chunkEvenly( workload );
+        return workload;
+    }
+
+    Workload
+    digitalChurn(
+        std::mt19937 &random_
+    )
+    {
+        Workload workload = { "digital port churn", {}, {} };
+        for( size_t i = 0; i < MESSAGES_PER_WORKLOAD; ++i )
+        {
+            appendChannelMessage( workload.bytes, DIGITAL_MESSAGE, random_() % 16, random_() & 0xFF );
+        }
+        chunkEvenly( workload );
+        return workload;
+    }
+
+    Workload
+    mixedReports(
+        std::mt19937 &random_
+    )
+    {
+        Workload workload = { "mixed analog/digital", {}, {} };
+        for( size_t i = 0; i < MESSAGES_PER_WORKLOAD; ++i )
+        {
+            if( random_() & 1 )
+            {
+                appendChannelMessage( workload.bytes, ANALOG_MESSAGE, random_() % 16, random_() & 0x3FF );
+            }
+            else
+            {
+                appendChannelMessage( workload.bytes, DIGITAL_MESSAGE, random_() % 16, random_() & 0xFF );
+            }
+        }
+        chunkEvenly( workload );
+        return workload;
+    }
+
+    Workload
+    sysexBursts(
+        std::mt19937 &random_
+    )
+    {
+        Workload workload = { "sysex bursts (1 KB strings)", {}, {} };
+        std::vector<uint8_t> payload( 1024 );
+        for( size_t i = 0; i < MESSAGES_PER_WORKLOAD / 256; ++i )
+        {
+            for( uint8_t &byte : payload ) { byte = static_cast<uint8_t>( 0x20 + random_() % 0x5F ); }
+            appendSysex( workload.bytes, STRING_DATA, payload );
+        }
+        chunkEvenly( workload );
+        return workload;
+    }
+
+    Workload
+    i2cReplies(
+        std::mt19937 &random_
+    )
+    {
+        Workload workload = { "i2c replies (6 data bytes)", {}, {} };
+        std::vector<uint8_t> payload( 8 );
+        for( size_t i = 0; i < MESSAGES_PER_WORKLOAD / 4; ++i )
+        {
+            //address, register, then an accelerometer-style six byte sample
+            payload[0] = 0x68;
+            payload[1] = 0x3B;
+            for( size_t j = 2; j < payload.size(); ++j ) { payload[j] = static_cast<uint8_t>( random_() ); }
+            appendSysex( workload.bytes, I2C_REPLY, payload );
+        }
+        chunkEvenly( workload );
+        return workload;
+    }
+
+    //analog reports in which one message in 16 is cut short, either by the next command byte or by the line going quiet for longer
+    //than the message timeout, so both the abort and the timeout paths are exercised
+    Workload
+    corruptedStream(
+        std::mt19937 &random_
+    )
+    {
+        Workload workload = { "corrupted/truncated", {}, {} };
+        clock::duration arrival = clock::duration::zero();
+        size_t chunk_start = 0;
+
+        for( size_t i = 0; i < MESSAGES_PER_WORKLOAD; ++i )
+        {
+            appendChannelMessage( workload.bytes, ANALOG_MESSAGE, i % 16, random_() & 0x3FF );
+
+            uint32_t fault = random_() % 32;
+            if( fault == 0 )
+            {
+                //drop the last data byte; the next command aborts the message
+                workload.bytes.pop_back();
+            }
+            else if( fault == 1 )
+            {
+                //drop the last data byte and stall, so the partial message times out before the next chunk
+                workload.bytes.pop_back();
+                Chunk chunk = { chunk_start, workload.bytes.size() - chunk_start, arrival };
+                workload.chunks.push_back( chunk );
+                chunk_start = workload.bytes.size();
+                arrival += MESSAGE_TIMEOUT + std::chrono::milliseconds( 1 );
+                continue;
+            }
+
+            if( workload.bytes.size() - chunk_start >= CHUNK_SIZE )
+            {
+                Chunk chunk = { chunk_start, workload.bytes.size() - chunk_start, arrival };
+                workload.chunks.push_back( chunk );
+                chunk_start = workload.bytes.size();
+                arrival += std::chrono::microseconds( 1 );
+            }
+        }
+
+        if( chunk_start < workload.bytes.size() )
+        {
+            Chunk chunk = { chunk_start, workload.bytes.size() - chunk_start, arrival };
+            workload.chunks.push_back( chunk );
+        }
+        return workload;
+    }
+
+    //the bytes received in a trace recorded with UwpFirmata::startTrace, fed in the chunks and at the times they were read
+    bool
+    recordedTrace(
+        const char *path_,
+        Workload &workload_
+    )
+    {
+        TraceReader reader;
+        if( !reader.load( path_ ) ) return false;
+
+        workload_.name = "trace";
+        ProtocolTrace::Record record;
+        while( reader.next( record ) )
+        {
+            if( record.direction != ProtocolTrace::Direction::INBOUND ) continue;
+
+            Chunk chunk = { workload_.bytes.size(), record.length, std::chrono::nanoseconds( record.timestamp_ns ) };
+            workload_.bytes.insert( workload_.bytes.end(), record.data, record.data + record.length );
+            workload_.chunks.push_back( chunk );
+        }
+        return !workload_.chunks.empty();
+    }
+
+//******************************************************************************
+//* Event handling
+//******************************************************************************
+
+    //the work UwpFirmata::dispatchMessage and RemoteDevice::onAnalogReport / onDigitalReport do for each message, less the WinRT
+    //event plumbing: cache updates under the device lock, changed-pin detection and in-place decoding of two 7-bit byte payloads
+    class DeviceModel
+    {
+    public:
+        DeviceModel(
+            void
+        ) :
+            changed_pins( 0 ),
+            payload_bytes( 0 )
+        {
+            _analog_pins.fill( 0 );
+            _digital_port.fill( 0 );
+            _subscribed_ports.fill( 0xFF );
+        }
+
+        void
+        operator()(
+            const FirmataMessage &message_
+        )
+        {
+            switch( message_.command )
+            {
+            case ANALOG_MESSAGE:
+            {
+                std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+                _analog_pins[message_.channel] = message_.data[0] | ( message_.data[1] << 7 );
+                break;
+            }
+
+            case DIGITAL_MESSAGE:
+            {
+                uint8_t port_val = static_cast<uint8_t>( message_.data[0] | ( message_.data[1] << 7 ) );
+                uint8_t port_xor;
+                {
+                    std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+                    port_val |= ~_subscribed_ports[message_.channel] & _digital_port[message_.channel];
+                    port_xor = port_val ^ _digital_port[message_.channel];
+                    _digital_port[message_.channel] = port_val;
+                }
+
+                //RemoteDevice raises one event per changed pin
+                for( ; port_xor; port_xor &= port_xor - 1 ) { ++changed_pins; }
+                break;
+            }
+
+            case START_SYSEX:
+                if( message_.sysex_command == STRING_DATA || message_.sysex_command == I2C_REPLY )
+                {
+                    payload_bytes += SevenBitCodec::decode( message_.data, message_.length, message_.data );
+                }
+                break;
+            }
+        }
+
+        uint64_t changed_pins;
+        uint64_t payload_bytes;
+
+    private:
+        std::recursive_mutex _device_mutex;
+        std::array<uint16_t, 16> _analog_pins;
+        std::array<uint8_t, 16> _digital_port;
+        std::array<uint8_t, 16> _subscribed_ports;
+    };
+
+//******************************************************************************
+//* Measurement
+//******************************************************************************
+
+    struct Result
+    {
+        double messages_per_second;
+        double ns_per_message;
+        double allocations_per_message;
+        double p50_ns;
+        double p99_ns;
+        uint64_t aborted;
+        uint64_t timed_out;
+    };
+
+    //feeds the whole workload once, returning the number of messages completed
+    template <typename Handler>
+    size_t
+    feedWorkload(
+        FirmataParser &parser_,
+        Workload &workload_,
+        clock::time_point epoch_,
+        Handler &&handler_
+    )
+    {
+        size_t messages = 0;
+        for( const Chunk &chunk : workload_.chunks )
+        {
+            messages += parser_.feed( workload_.bytes.data() + chunk.offset, chunk.length, epoch_ + chunk.arrival, handler_ );
+        }
+        return messages;
+    }
+
+    Result
+    measure(
+        const Workload &original_
+    )
+    {
+        Result result = {};
+
+        //handlers decode payloads in place, so every pass parses a fresh copy of the stream
+        Workload workload = original_;
+        DeviceModel device;
+        FirmataParser parser;
+        parser.setMessageTimeout( MESSAGE_TIMEOUT );
+
+        //a first pass grows the parser's buffers and counts the faults in a single pass over the workload
+        clock::time_point epoch = clock::now();
+        workload.bytes = original_.bytes;
+        feedWorkload( parser, workload, epoch, device );
+        result.aborted = parser.messagesAborted();
+        result.timed_out = parser.messagesTimedOut();
+
+        //throughput: repeat the workload until enough time has passed, counting heap allocations made while parsing
+        size_t messages = 0;
+        uint64_t allocations_before = 0;
+        std::chrono::duration<double> elapsed( 0 );
+        size_t passes = 0;
+        while( elapsed.count() < SECONDS_PER_RUN )
+        {
+            workload.bytes = original_.bytes;
+            epoch += original_.chunks.back().arrival + MESSAGE_TIMEOUT * 2;
+
+            allocations_before = allocations.load();
+            auto start = clock::now();
+            messages += feedWorkload( parser, workload, epoch, device );
+            elapsed += clock::now() - start;
+            result.allocations_per_message += static_cast<double>( allocations.load() - allocations_before );
+            ++passes;
+        }
+
+        result.messages_per_second = messages / elapsed.count();
+        result.ns_per_message = elapsed.count() * 1e9 / messages;
+        result.allocations_per_message /= messages;
+
+        //latency: the time from handing a chunk to the parser until the handler sees each message it completes
+        std::vector<double> latencies;
+        latencies.reserve( messages / passes );
+        workload.bytes = original_.bytes;
+        epoch += original_.chunks.back().arrival + MESSAGE_TIMEOUT * 2;
+        for( const Chunk &chunk : workload.chunks )
+        {
+            auto chunk_start = clock::now();
+            parser.feed( workload.bytes.data() + chunk.offset, chunk.length, epoch + chunk.arrival, [ & ]( const FirmataMessage &message_ ) -> void
+            {
+                device( message_ );
+                latencies.push_back( std::chrono::duration<double, std::nano>( clock::now() - chunk_start ).count() );
+            } );
+        }
+
+        if( !latencies.empty() )
+        {
+            auto p50 = latencies.begin() + latencies.size() / 2;
+            std::nth_element( latencies.begin(), p50, latencies.end() );
+            result.p50_ns = *p50;
+
+            auto p99 = latencies.begin() + ( latencies.size() * 99 ) / 100;
+            std::nth_element( latencies.begin(), p99, latencies.end() );
+            result.p99_ns = *p99;
+        }
+
+        return result;
+    }
+}
+
+int
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    std::mt19937 random( 0x46697274 );
+    std::vector<Workload> workloads;
+    workloads.push_back( analogFlood( random ) );
+    workloads.push_back( digitalChurn( random ) );
+    workloads.push_back( mixedReports( random ) );
+    workloads.push_back( sysexBursts( random ) );
+    workloads.push_back( i2cReplies( random ) );
+    workloads.push_back( corruptedStream( random ) );
+
+    //any recorded traces given on the command line are measured as well
+    for( int i = 1; i < argc; ++i )
+    {
+        Workload trace;
+        if( !recordedTrace( argv[i], trace ) )
+        {
+            std::fprintf( stderr, "unable to load trace %s\n", argv[i] );
+            return 1;
+        }
+        trace.name += " (" + std::string( argv[i] ) + ")";
+        workloads.push_back( trace );
+    }
+
+    std::printf( "%-28s %12s %10s %10s %10s %10s %10s %10s\n", "workload", "msgs/sec", "ns/msg", "allocs/msg", "p50 (ns)", "p99 (ns)", "aborted", "timed out" );
+    for( const Workload &workload : workloads )
+    {
+        Result result = measure( workload );
+        std::printf( "%-28s %12.0f %10.1f %10.4f %10.0f %10.0f %10llu %10llu\n", workload.name.c_str(), result.messages_per_second,
+            result.ns_per_message, result.allocations_per_message, result.p50_ns, result.p99_ns,
+            static_cast<unsigned long long>( result.aborted ), static_cast<unsigned long long>( result.timed_out ) );
+    }
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "SevenBitCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace Microsoft::Maker::Firmata;
+
+namespace {
+    const size_t PAYLOAD_SIZES[] = { 16, 64, 512, 4096, 65536 };
+    const size_t BYTES_PER_RUN = 256 * 1024 * 1024;
+
+    //the per-byte encoder UwpFirmata used before the whole-buffer kernels, appending each pair to a growing frame
+    void
+    encodePerByte(
+        const std::vector<uint8_t> &source_,
+        std::vector<uint8_t> &frame_
+    )
+    {
+        frame_.clear();
+        for( uint8_t byte : source_ )
+        {
+            frame_.push_back( byte & 0x7F );
+            frame_.push_back( ( byte >> 7 ) & 0x7F );
+        }
+    }
+
+    //keeps the optimizer from discarding results
+    volatile uint8_t sink;
+
+    template <typename Kernel>
+    double
+    measure(
+        size_t payload_size_,
+        Kernel &&kernel_
+    )
+    {
+        size_t iterations = ( std::max )( static_cast<size_t>( 1 ), BYTES_PER_RUN / payload_size_ );
+
+        //warm up caches and the branch predictor
+        for( size_t i = 0; i < iterations / 16 + 1; ++i ) { kernel_(); }
+
+        auto start = std::chrono::steady_clock::now();
+        for( size_t i = 0; i < iterations; ++i ) { kernel_(); }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        return ( static_cast<double>( iterations ) * payload_size_ ) / elapsed.count();
+    }
+}
+
+int
+main(
+    void
+    )
+{
+    std::mt19937 random( 7 );
+
+    std::printf( "%10s %14s %14s %14s %14s %14s\n", "payload", "per-byte enc", "scalar enc", "simd enc", "scalar dec", "simd dec" );
+    std::printf( "%10s %14s %14s %14s %14s %14s\n", "(bytes)", "(MB/s)", "(MB/s)", "(MB/s)", "(MB/s)", "(MB/s)" );
+
+    for( size_t payload_size : PAYLOAD_SIZES )
+    {
+        std::vector<uint8_t> payload( payload_size );
+        for( auto &byte : payload ) { byte = static_cast<uint8_t>( random() ); }
+
+        std::vector<uint8_t> frame;
+        std::vector<uint8_t> encoded( payload_size * 2 );
+        std::vector<uint8_t> decoded( payload_size );
+        SevenBitCodec::encodeScalar( payload.data(), payload.size(), encoded.data() );
+
+        //throughput is reported in terms of unencoded payload bytes for both directions
+        double per_byte = measure( payload_size, [ & ]() { encodePerByte( payload, frame ); sink = frame.back(); } );
+        double scalar_encode = measure( payload_size, [ & ]() { SevenBitCodec::encodeScalar( payload.data(), payload.size(), frame.data() ); sink = frame.back(); } );
+        double simd_encode = measure( payload_size, [ & ]() { SevenBitCodec::encode( payload.data(), payload.size(), frame.data() ); sink = frame.back(); } );
+        double scalar_decode = measure( payload_size, [ & ]() { SevenBitCodec::decodeScalar( encoded.data(), encoded.size(), decoded.data() ); sink = decoded.back(); } );
+        double simd_decode = measure( payload_size, [ & ]() { SevenBitCodec::decode( encoded.data(), encoded.size(), decoded.data() ); sink = decoded.back(); } );
+
+        if( decoded != payload )
+        {
+            std::printf( "decoded payload of %zu bytes does not match the original\n", payload_size );
+            return 1;
+        }
+
+        std::printf( "%10zu %14.0f %14.0f %14.0f %14.0f %14.0f\n", payload_size, per_byte / 1e6, scalar_encode / 1e6, simd_encode / 1e6, scalar_decode / 1e6, simd_decode / 1e6 );
+    }
+
+    return 0;
+}
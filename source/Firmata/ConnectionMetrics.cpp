@@ -0,0 +1,287 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "ConnectionMetrics.h"
+
+#include <cstdio>
+
+using namespace Microsoft::Maker::Firmata;
+
+namespace {
+    struct NamedValue
+    {
+        uint8_t value;
+        const char *name;
+    };
+
+    //command values are repeated here because the metrics must not depend on WinRT types
+    const NamedValue COMMAND_NAMES[] = {
+        { 0x90, "DIGITAL_MESSAGE" },
+        { 0xC0, "REPORT_ANALOG_PIN" },
+        { 0xD0, "REPORT_DIGITAL_PIN" },
+        { 0xE0, "ANALOG_MESSAGE" },
+        { 0xF0, "START_SYSEX" },
+        { 0xF4, "SET_PIN_MODE" },
+        { 0xF7, "END_SYSEX" },
+        { 0xF9, "PROTOCOL_VERSION" },
+        { 0xFF, "SYSTEM_RESET" },
+    };
+
+    const NamedValue SYSEX_COMMAND_NAMES[] = {
+        { 0x61, "ENCODER_DATA" },
+        { 0x69, "ANALOG_MAPPING_QUERY" },
+        { 0x6A, "ANALOG_MAPPING_RESPONSE" },
+        { 0x6B, "CAPABILITY_QUERY" },
+        { 0x6C, "CAPABILITY_RESPONSE" },
+        { 0x6D, "PIN_STATE_QUERY" },
+        { 0x6E, "PIN_STATE_RESPONSE" },
+        { 0x6F, "EXTENDED_ANALOG" },
+        { 0x70, "SERVO_CONFIG" },
+        { 0x71, "STRING_DATA" },
+        { 0x72, "STEPPER_DATA" },
+        { 0x73, "ONEWIRE_DATA" },
+        { 0x75, "SHIFT_DATA" },
+        { 0x76, "I2C_REQUEST" },
+        { 0x77, "I2C_REPLY" },
+        { 0x78, "I2C_CONFIG" },
+        { 0x79, "REPORT_FIRMWARE" },
+        { 0x7A, "SAMPLING_INTERVAL" },
+        { 0x7B, "SCHEDULER_DATA" },
+        { 0x7E, "SYSEX_NON_REALTIME" },
+        { 0x7F, "SYSEX_REALTIME" },
+    };
+
+    const char * const EVENT_NAMES[] = {
+        "AnalogValueUpdated",
+        "DigitalPortValueUpdated",
+        "StringMessageReceived",
+        "SysexMessageReceived",
+        "PinCapabilityResponseReceived",
+        "I2cReplyReceived",
+    };
+
+    //returns the name of a known command, or its value in hex
+    template <size_t N>
+    std::string
+    commandName(
+        const NamedValue ( &names_ )[N],
+        size_t value_
+    )
+    {
+        for( const NamedValue &named : names_ )
+        {
+            if( named.value == value_ ) return named.name;
+        }
+
+        char hex[8];
+        std::snprintf( hex, sizeof( hex ), "0x%02X", static_cast<unsigned int>( value_ ) );
+        return hex;
+    }
+
+    //the fixed counters, in the order they are exported
+    struct Field
+    {
+        const char *name;
+        uint64_t ConnectionMetrics::Snapshot::*counter;
+    };
+
+    const Field FIELDS[] = {
+        { "bytes_received", &ConnectionMetrics::Snapshot::bytes_received },
+        { "messages_received", &ConnectionMetrics::Snapshot::messages_received },
+        { "unknown_bytes_skipped", &ConnectionMetrics::Snapshot::unknown_bytes_skipped },
+        { "messages_timed_out", &ConnectionMetrics::Snapshot::messages_timed_out },
+        { "messages_aborted", &ConnectionMetrics::Snapshot::messages_aborted },
+        { "input_busy_ns", &ConnectionMetrics::Snapshot::input_busy_ns },
+        { "input_idle_ns", &ConnectionMetrics::Snapshot::input_idle_ns },
+        { "input_errors", &ConnectionMetrics::Snapshot::input_errors },
+        { "bytes_sent", &ConnectionMetrics::Snapshot::bytes_sent },
+        { "writes", &ConnectionMetrics::Snapshot::writes },
+        { "lock_acquisitions", &ConnectionMetrics::Snapshot::lock_acquisitions },
+        { "lock_contentions", &ConnectionMetrics::Snapshot::lock_contentions },
+        { "lock_wait_ns", &ConnectionMetrics::Snapshot::lock_wait_ns },
+    };
+
+    void
+    appendCounter(
+        std::string &text_,
+        const std::string &name_,
+        uint64_t value_,
+        const char *format_
+    )
+    {
+        char line[128];
+        std::snprintf( line, sizeof( line ), format_, name_.c_str(), static_cast<unsigned long long>( value_ ) );
+        text_ += line;
+    }
+
+    //appends a JSON object holding the non-zero counters of a table
+    template <size_t Size, size_t N>
+    void
+    appendJsonTable(
+        std::string &json_,
+        const char *name_,
+        const std::array<uint64_t, Size> &counters_,
+        const NamedValue ( &names_ )[N]
+    )
+    {
+        json_ += ",\"";
+        json_ += name_;
+        json_ += "\":{";
+
+        bool first = true;
+        for( size_t i = 0; i < Size; ++i )
+        {
+            if( !counters_[i] ) continue;
+            appendCounter( json_, commandName( names_, i ), counters_[i], first ? "\"%s\":%llu" : ",\"%s\":%llu" );
+            first = false;
+        }
+        json_ += "}";
+    }
+}
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+ConnectionMetrics::ConnectionMetrics(
+    void
+    ) :
+    _bytes_received( 0 ),
+    _unknown_bytes_skipped( 0 ),
+    _messages_timed_out( 0 ),
+    _messages_aborted( 0 ),
+    _input_busy_ns( 0 ),
+    _input_idle_ns( 0 ),
+    _input_errors( 0 ),
+    _bytes_sent( 0 ),
+    _writes( 0 )
+{
+    for( std::atomic<uint64_t> &counter : _messages_by_command ) { counter.store( 0, std::memory_order_relaxed ); }
+    for( std::atomic<uint64_t> &counter : _messages_by_sysex_command ) { counter.store( 0, std::memory_order_relaxed ); }
+    for( std::atomic<uint64_t> &counter : _events_raised ) { counter.store( 0, std::memory_order_relaxed ); }
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+void
+ConnectionMetrics::recordParserTotals(
+    const FirmataParser &parser_
+    )
+{
+    //the parser keeps its own plain totals on the input thread, mirror them where other threads can read them
+    _unknown_bytes_skipped.store( parser_.unknownBytesSkipped(), std::memory_order_relaxed );
+    _messages_timed_out.store( parser_.messagesTimedOut(), std::memory_order_relaxed );
+    _messages_aborted.store( parser_.messagesAborted(), std::memory_order_relaxed );
+}
+
+void
+ConnectionMetrics::snapshot(
+    Snapshot &snapshot_
+    ) const
+{
+    snapshot_.bytes_received = _bytes_received.load( std::memory_order_relaxed );
+    snapshot_.unknown_bytes_skipped = _unknown_bytes_skipped.load( std::memory_order_relaxed );
+    snapshot_.messages_timed_out = _messages_timed_out.load( std::memory_order_relaxed );
+    snapshot_.messages_aborted = _messages_aborted.load( std::memory_order_relaxed );
+    snapshot_.input_busy_ns = _input_busy_ns.load( std::memory_order_relaxed );
+    snapshot_.input_idle_ns = _input_idle_ns.load( std::memory_order_relaxed );
+    snapshot_.input_errors = _input_errors.load( std::memory_order_relaxed );
+    snapshot_.bytes_sent = _bytes_sent.load( std::memory_order_relaxed );
+    snapshot_.writes = _writes.load( std::memory_order_relaxed );
+    snapshot_.lock_acquisitions = 0;
+    snapshot_.lock_contentions = 0;
+    snapshot_.lock_wait_ns = 0;
+
+    snapshot_.messages_received = 0;
+    for( size_t i = 0; i < snapshot_.messages_by_command.size(); ++i )
+    {
+        snapshot_.messages_by_command[i] = _messages_by_command[i].load( std::memory_order_relaxed );
+        snapshot_.messages_received += snapshot_.messages_by_command[i];
+    }
+    for( size_t i = 0; i < snapshot_.messages_by_sysex_command.size(); ++i )
+    {
+        snapshot_.messages_by_sysex_command[i] = _messages_by_sysex_command[i].load( std::memory_order_relaxed );
+    }
+    for( size_t i = 0; i < EVENT_COUNT; ++i )
+    {
+        snapshot_.events_raised[i] = _events_raised[i].load( std::memory_order_relaxed );
+    }
+}
+
+std::string
+ConnectionMetrics::Snapshot::toText(
+    void
+    ) const
+{
+    std::string text;
+
+    for( const Field &field : FIELDS )
+    {
+        appendCounter( text, field.name, this->*field.counter, "%-40s %llu\n" );
+    }
+    for( size_t i = 0; i < messages_by_command.size(); ++i )
+    {
+        if( messages_by_command[i] ) { appendCounter( text, "messages." + commandName( COMMAND_NAMES, i ), messages_by_command[i], "%-40s %llu\n" ); }
+    }
+    for( size_t i = 0; i < messages_by_sysex_command.size(); ++i )
+    {
+        if( messages_by_sysex_command[i] ) { appendCounter( text, "sysex_messages." + commandName( SYSEX_COMMAND_NAMES, i ), messages_by_sysex_command[i], "%-40s %llu\n" ); }
+    }
+    for( size_t i = 0; i < EVENT_COUNT; ++i )
+    {
+        appendCounter( text, std::string( "events." ) + EVENT_NAMES[i], events_raised[i], "%-40s %llu\n" );
+    }
+
+    return text;
+}
+
+std::string
+ConnectionMetrics::Snapshot::toJson(
+    void
+    ) const
+{
+    std::string json = "{";
+
+    bool first = true;
+    for( const Field &field : FIELDS )
+    {
+        appendCounter( json, field.name, this->*field.counter, first ? "\"%s\":%llu" : ",\"%s\":%llu" );
+        first = false;
+    }
+
+    appendJsonTable( json, "messages", messages_by_command, COMMAND_NAMES );
+    appendJsonTable( json, "sysex_messages", messages_by_sysex_command, SYSEX_COMMAND_NAMES );
+
+    json += ",\"events\":{";
+    for( size_t i = 0; i < EVENT_COUNT; ++i )
+    {
+        appendCounter( json, EVENT_NAMES[i], events_raised[i], i ? ",\"%s\":%llu" : "\"%s\":%llu" );
+    }
+    json += "}}";
+
+    return json;
+}
@@ -0,0 +1,242 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "FirmataParser.h"
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * ConnectionMetrics counts the traffic and work of one connection. Counters are relaxed atomics grouped by the thread which writes
+ * them, with each group on its own cache lines, so recording never contends with the other threads or with a snapshot being taken.
+ * Counters written by a single thread are updated with a plain load and store rather than an atomic read-modify-write, which is
+ * also why they are never reset; rates are found by comparing two snapshots.
+ */
+class ConnectionMetrics
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    //the events UwpFirmata raises for received messages
+    enum class Event
+    {
+        ANALOG_VALUE_UPDATED,
+        DIGITAL_PORT_VALUE_UPDATED,
+        STRING_MESSAGE_RECEIVED,
+        SYSEX_MESSAGE_RECEIVED,
+        PIN_CAPABILITY_RESPONSE_RECEIVED,
+        I2C_REPLY_RECEIVED,
+    };
+
+    static const size_t EVENT_COUNT = static_cast<size_t>( Event::I2C_REPLY_RECEIVED ) + 1;
+
+    /*
+     * A copy of the counters. Each counter is read atomically, but the snapshot as a whole is not taken at a single instant.
+     * The lock fields are filled in by the owner of the lock, see TimedMutex.
+     */
+    struct Snapshot
+    {
+        uint64_t bytes_received;
+        uint64_t messages_received;
+        uint64_t unknown_bytes_skipped;
+        uint64_t messages_timed_out;
+        uint64_t messages_aborted;
+        uint64_t input_busy_ns;
+        uint64_t input_idle_ns;
+        uint64_t input_errors;
+
+        uint64_t bytes_sent;
+        uint64_t writes;
+
+        uint64_t lock_acquisitions;
+        uint64_t lock_contentions;
+        uint64_t lock_wait_ns;
+
+        //channel messages by command with the channel nibble cleared, e.g. every ANALOG_MESSAGE is counted under 0xE0
+        std::array<uint64_t, 0x100> messages_by_command;
+        std::array<uint64_t, 0x80> messages_by_sysex_command;
+        std::array<uint64_t, EVENT_COUNT> events_raised;
+
+        ///<summary>
+        ///Formats the snapshot as human-readable lines of "name value"; per-command counters are only listed when non-zero.
+        ///</summary>
+        std::string
+        toText(
+            void
+        ) const;
+
+        ///<summary>
+        ///Formats the snapshot as a single JSON object.
+        ///</summary>
+        std::string
+        toJson(
+            void
+        ) const;
+    };
+
+    ConnectionMetrics(
+        void
+    );
+
+    //input thread
+
+    inline
+    void
+    recordReceived(
+        size_t length_
+    )
+    {
+        add( _bytes_received, length_ );
+    }
+
+    inline
+    void
+    recordMessage(
+        const FirmataMessage &message_
+    )
+    {
+        add( _messages_by_command[( message_.command < 0xF0 ) ? ( message_.command & 0xF0 ) : message_.command], 1 );
+        if( message_.command == START_SYSEX ) { add( _messages_by_sysex_command[message_.sysex_command & 0x7F], 1 ); }
+    }
+
+    void
+    recordParserTotals(
+        const FirmataParser &parser_
+    );
+
+    inline
+    void
+    recordInputBusy(
+        clock::duration busy_
+    )
+    {
+        add( _input_busy_ns, nanoseconds( busy_ ) );
+    }
+
+    inline
+    void
+    recordInputIdle(
+        clock::duration idle_
+    )
+    {
+        add( _input_idle_ns, nanoseconds( idle_ ) );
+    }
+
+    inline
+    void
+    recordInputError(
+        void
+    )
+    {
+        add( _input_errors, 1 );
+    }
+
+    //event raising, which may happen on several dispatcher threads at once
+
+    inline
+    void
+    recordEvent(
+        Event event_
+    )
+    {
+        _events_raised[static_cast<size_t>( event_ )].fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    //the thread holding the transmit role
+
+    inline
+    void
+    recordSent(
+        size_t length_
+    )
+    {
+        add( _bytes_sent, length_ );
+        add( _writes, 1 );
+    }
+
+    void
+    snapshot(
+        Snapshot &snapshot_
+    ) const;
+
+private:
+    static const size_t CACHE_LINE_SIZE = 64;
+    static const uint8_t START_SYSEX = 0xF0;
+
+    //written by the input thread
+    std::atomic<uint64_t> _bytes_received;
+    std::atomic<uint64_t> _unknown_bytes_skipped;
+    std::atomic<uint64_t> _messages_timed_out;
+    std::atomic<uint64_t> _messages_aborted;
+    std::atomic<uint64_t> _input_busy_ns;
+    std::atomic<uint64_t> _input_idle_ns;
+    std::atomic<uint64_t> _input_errors;
+    std::array<std::atomic<uint64_t>, 0x100> _messages_by_command;
+    std::array<std::atomic<uint64_t>, 0x80> _messages_by_sysex_command;
+    char _padding0[CACHE_LINE_SIZE];
+
+    //written by whichever threads raise events
+    std::array<std::atomic<uint64_t>, EVENT_COUNT> _events_raised;
+    char _padding1[CACHE_LINE_SIZE];
+
+    //written by the thread holding the transmit role
+    std::atomic<uint64_t> _bytes_sent;
+    std::atomic<uint64_t> _writes;
+    char _padding2[CACHE_LINE_SIZE];
+
+    //only ever called by the single writer of the counter
+    static
+    inline
+    void
+    add(
+        std::atomic<uint64_t> &counter_,
+        uint64_t amount_
+    )
+    {
+        counter_.store( counter_.load( std::memory_order_relaxed ) + amount_, std::memory_order_relaxed );
+    }
+
+    static
+    inline
+    uint64_t
+    nanoseconds(
+        clock::duration duration_
+    )
+    {
+        return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( duration_ ).count() );
+    }
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,243 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "FirmataParser.h"
+
+using namespace Microsoft::Maker::Firmata;
+
+namespace {
+    //the timeout for an incomplete message, measured from the last byte received
+    const std::chrono::milliseconds DEFAULT_MESSAGE_TIMEOUT( 500 );
+
+    //initial sysex capacity, large enough for the typical capability response of an UNO-class board
+    const size_t INITIAL_SYSEX_CAPACITY = 256;
+}
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+FirmataParser::FirmataParser(
+    size_t max_sysex_length_
+    ) :
+    _max_sysex_length( max_sysex_length_ ),
+    _message_timeout( DEFAULT_MESSAGE_TIMEOUT ),
+    _last_byte_time(),
+    _state( State::IDLE ),
+    _bytes_remaining( 0 ),
+    _message(),
+    _sysex_inline( nullptr ),
+    _chunk_end( nullptr ),
+    _messages_parsed( 0 ),
+    _messages_aborted( 0 ),
+    _messages_timed_out( 0 ),
+    _unknown_bytes_skipped( 0 )
+{
+    _sysex_data.reserve( INITIAL_SYSEX_CAPACITY );
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+bool
+FirmataParser::expire(
+    clock::time_point now_
+    )
+{
+    if( _state == State::IDLE || ( now_ - _last_byte_time ) <= _message_timeout )
+    {
+        return false;
+    }
+
+    reset();
+    ++_messages_timed_out;
+    return true;
+}
+
+void
+FirmataParser::reset(
+    void
+    )
+{
+    _state = State::IDLE;
+    _bytes_remaining = 0;
+    _sysex_inline = nullptr;
+
+    //clear() keeps the capacity, so the buffer is reused for the next message
+    _sysex_data.clear();
+}
+
+void
+FirmataParser::setMessageTimeout(
+    clock::duration timeout_
+    )
+{
+    _message_timeout = timeout_;
+}
+
+//******************************************************************************
+//* Private Methods
+//******************************************************************************
+
+bool
+FirmataParser::beginMessage(
+    uint8_t *position_
+    )
+{
+    const uint8_t byte_ = *position_;
+
+    /*
+     * the relevant bits in the command depends on the value of the data byte. If it is less than 0xF0 (start sysex), only the upper nibble identifies the command
+     * while the lower nibble contains additional data
+     */
+    const uint8_t command = ( byte_ < START_SYSEX ) ? ( byte_ & 0xF0 ) : byte_;
+
+    _message.command = command;
+    _message.channel = ( byte_ < START_SYSEX ) ? ( byte_ & 0x0F ) : 0;
+    _message.sysex_command = 0;
+    _message.data = _channel_data;
+    _message.length = 0;
+
+    switch( command )
+    {
+        //commands that require 2 additional bytes
+    case DIGITAL_MESSAGE:
+    case ANALOG_MESSAGE:
+    case SET_PIN_MODE:
+    case PROTOCOL_VERSION:
+        _bytes_remaining = 2;
+        _state = State::CHANNEL_DATA;
+        return false;
+
+        //commands that require 1 additional byte
+    case REPORT_ANALOG_PIN:
+    case REPORT_DIGITAL_PIN:
+        _bytes_remaining = 1;
+        _state = State::CHANNEL_DATA;
+        return false;
+
+        //commands that do not require additional bytes are complete immediately
+    case SYSTEM_RESET:
+        ++_messages_parsed;
+        return true;
+
+    case START_SYSEX:
+        //this is a special case with no set number of bytes remaining
+        _sysex_data.clear();
+        _sysex_inline = position_ + 1;
+        _state = State::SYSEX_DATA;
+        return false;
+
+    default: //command not understood, or a data byte received outside of a message
+    case END_SYSEX:
+        ++_unknown_bytes_skipped;
+        return false;
+    }
+}
+
+bool
+FirmataParser::consume(
+    uint8_t *position_
+    )
+{
+    const uint8_t byte_ = *position_;
+
+    if( _state == State::IDLE )
+    {
+        return beginMessage( position_ );
+    }
+
+    //only command bytes have the MSB set, so a command byte inside a message either ends a sysex message or means the current message was truncated
+    if( byte_ & 0x80 )
+    {
+        if( _state == State::SYSEX_DATA && byte_ == END_SYSEX )
+        {
+            uint8_t *sysex = _sysex_inline ? _sysex_inline : _sysex_data.data();
+            size_t length = _sysex_inline ? static_cast<size_t>( position_ - _sysex_inline ) : _sysex_data.size();
+
+            _state = State::IDLE;
+            _sysex_inline = nullptr;
+
+            //a sysex message must include at least one extended-command byte
+            if( !length )
+            {
+                ++_messages_aborted;
+                return false;
+            }
+
+            _message.sysex_command = sysex[0];
+            _message.data = sysex + 1;
+            _message.length = length - 1;
+            ++_messages_parsed;
+            return true;
+        }
+
+        ++_messages_aborted;
+        reset();
+        return beginMessage( position_ );
+    }
+
+    if( _state == State::SYSEX_DATA )
+    {
+        size_t length = _sysex_inline ? static_cast<size_t>( position_ - _sysex_inline ) : _sysex_data.size();
+        if( length >= _max_sysex_length )
+        {
+            //the message can never be delivered, drop it and skip the remaining bytes
+            ++_messages_aborted;
+            reset();
+            return false;
+        }
+
+        //bytes of an in-place message are already where they need to be
+        if( !_sysex_inline )
+        {
+            _sysex_data.push_back( byte_ );
+        }
+        return false;
+    }
+
+    _channel_data[_message.length++] = byte_;
+    if( --_bytes_remaining )
+    {
+        return false;
+    }
+
+    _state = State::IDLE;
+    ++_messages_parsed;
+    return true;
+}
+
+void
+FirmataParser::spill(
+    void
+    )
+{
+    if( _sysex_inline == nullptr ) return;
+
+    //clear() keeps the capacity, so this only allocates when a message is larger than any seen before
+    _sysex_data.assign( _sysex_inline, _chunk_end );
+    _sysex_inline = nullptr;
+}
@@ -0,0 +1,203 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * A single decoded Firmata message. For channel messages (analog, digital, report) the channel holds the pin or port number carried
+ * in the lower nibble of the command byte. For sysex messages the command is START_SYSEX, sysex_command holds the extended command byte
+ * and data points at the payload between the extended command byte and END_SYSEX.
+ * The data pointer refers either to the chunk given to FirmataParser::feed() or to memory owned by the parser, and is only valid for the
+ * duration of the handler invocation. Handlers may modify the payload in place (e.g. to condense two 7-bit bytes back into one) since
+ * the parser never reads it again.
+ */
+struct FirmataMessage
+{
+    uint8_t command;
+    uint8_t channel;
+    uint8_t sysex_command;
+    uint8_t *data;
+    size_t length;
+};
+
+/*
+ * FirmataParser is a resumable, byte-fed state machine which decodes a Firmata byte stream into messages. Partial messages are kept
+ * between calls to feed(), so bytes may be supplied in arbitrarily sized chunks from bulk reads, recorded traces or synthetic workloads.
+ * The parser never blocks and never allocates once its sysex buffer has grown to the size of the largest message seen. A sysex message
+ * which is received entirely within one chunk is delivered in place without being copied; only a message split across chunks is
+ * gathered into the parser's own buffer.
+ */
+class FirmataParser
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    static const size_t DEFAULT_MAX_SYSEX_LENGTH = 0x10000;
+
+    FirmataParser(
+        size_t max_sysex_length_ = DEFAULT_MAX_SYSEX_LENGTH
+    );
+
+    ///<summary>
+    ///Feeds a chunk of received bytes to the parser, invoking handler_( const FirmataMessage & ) once for each message completed by this chunk.
+    ///<para>An incomplete message which has not received a byte within the message timeout is discarded before the chunk is consumed.</para>
+    ///<returns>the number of messages completed</returns>
+    ///</summary>
+    template <typename Handler>
+    size_t
+    feed(
+        uint8_t *data_,
+        size_t length_,
+        clock::time_point now_,
+        Handler &&handler_
+    )
+    {
+        size_t completed = 0;
+
+        expire( now_ );
+        if( !length_ ) return 0;
+
+        _last_byte_time = now_;
+        _chunk_end = data_ + length_;
+
+        for( uint8_t *position = data_; position < _chunk_end; ++position )
+        {
+            if( consume( position ) )
+            {
+                handler_( static_cast<const FirmataMessage &>( _message ) );
+                ++completed;
+            }
+        }
+
+        //the chunk belongs to the caller, so a sysex message still in progress must be gathered before returning
+        spill();
+        return completed;
+    }
+
+    ///<summary>
+    ///Discards an incomplete message if no byte has been received for longer than the message timeout.
+    ///<returns>true if a partial message was discarded</returns>
+    ///</summary>
+    bool
+    expire(
+        clock::time_point now_
+    );
+
+    ///<summary>
+    ///Returns true if the parser is holding part of a message.
+    ///</summary>
+    inline
+    bool
+    inMessage(
+        void
+    ) const
+    {
+        return _state != State::IDLE;
+    }
+
+    ///<summary>
+    ///Discards any partial message and returns the parser to its idle state.
+    ///</summary>
+    void
+    reset(
+        void
+    );
+
+    void
+    setMessageTimeout(
+        clock::duration timeout_
+    );
+
+    //running totals, useful for diagnostics and benchmarks
+    inline uint64_t messagesParsed( void ) const { return _messages_parsed; }
+    inline uint64_t messagesAborted( void ) const { return _messages_aborted; }
+    inline uint64_t messagesTimedOut( void ) const { return _messages_timed_out; }
+    inline uint64_t unknownBytesSkipped( void ) const { return _unknown_bytes_skipped; }
+
+private:
+    enum class State
+    {
+        IDLE,
+        CHANNEL_DATA,
+        SYSEX_DATA,
+    };
+
+    //command values are repeated here because the parser must not depend on WinRT types
+    static const uint8_t ANALOG_MESSAGE = 0xE0;
+    static const uint8_t DIGITAL_MESSAGE = 0x90;
+    static const uint8_t REPORT_ANALOG_PIN = 0xC0;
+    static const uint8_t REPORT_DIGITAL_PIN = 0xD0;
+    static const uint8_t SET_PIN_MODE = 0xF4;
+    static const uint8_t START_SYSEX = 0xF0;
+    static const uint8_t END_SYSEX = 0xF7;
+    static const uint8_t PROTOCOL_VERSION = 0xF9;
+    static const uint8_t SYSTEM_RESET = 0xFF;
+
+    const size_t _max_sysex_length;
+    clock::duration _message_timeout;
+    clock::time_point _last_byte_time;
+
+    State _state;
+    size_t _bytes_remaining;
+    uint8_t _channel_data[2];
+    FirmataMessage _message;
+
+    //a sysex message is tracked in place within the current chunk until the chunk ends, then gathered into _sysex_data
+    uint8_t *_sysex_inline;
+    uint8_t *_chunk_end;
+    std::vector<uint8_t> _sysex_data;
+
+    uint64_t _messages_parsed;
+    uint64_t _messages_aborted;
+    uint64_t _messages_timed_out;
+    uint64_t _unknown_bytes_skipped;
+
+    bool
+    beginMessage(
+        uint8_t *position_
+    );
+
+    bool
+    consume(
+        uint8_t *position_
+    );
+
+    void
+    spill(
+        void
+    );
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,87 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * FirmataTransport is the bulk transport contract used by the Firmata layer. Bytes are moved in contiguous runs rather than one call
+ * per byte, so a complete outbound frame is handed to the transport in a single write and inbound bytes are read straight into the
+ * caller's buffer.
+ * UwpFirmata calls read() from its input thread (or the reactor thread) while write() and flush() are called from whichever thread is
+ * draining the transmit ring, so a read may run concurrently with a write or flush. Each direction is serialized on its own: no two
+ * reads overlap, and no two writes or flushes overlap. Implementations must therefore keep any state shared by both directions safe
+ * for concurrent use.
+ */
+class FirmataTransport
+{
+public:
+    virtual
+    ~FirmataTransport(
+        void
+    )
+    {
+    }
+
+    ///<summary>
+    ///Reads up to length_ bytes into buffer_ without waiting for more data to arrive.
+    ///<returns>the number of bytes read, which is zero if no data was available</returns>
+    ///</summary>
+    virtual
+    size_t
+    read(
+        uint8_t *buffer_,
+        size_t length_
+    ) = 0;
+
+    ///<summary>
+    ///Writes a complete contiguous frame to the outbound queue of the transport.
+    ///<returns>the number of bytes accepted</returns>
+    ///</summary>
+    virtual
+    size_t
+    write(
+        const uint8_t *buffer_,
+        size_t length_
+    ) = 0;
+
+    ///<summary>
+    ///Sends any data waiting in the outbound queue of the transport.
+    ///</summary>
+    virtual
+    void
+    flush(
+        void
+    ) = 0;
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,271 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "InputReactor.h"
+
+#include <algorithm>
+
+using namespace Microsoft::Maker::Firmata;
+
+struct InputReactor::Source
+{
+    enum class State
+    {
+        IDLE,
+        QUEUED,
+        RUNNING,
+        //notified while being polled; it is queued again once the poll returns
+        RUNNING_NOTIFIED,
+    };
+
+    PollFunction poll;
+    State state;
+    bool removed;
+
+    //the thread polling the source while it is RUNNING or RUNNING_NOTIFIED
+    std::thread::id poller;
+};
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+InputReactor::InputReactor(
+    size_t thread_count_,
+    std::chrono::microseconds sweep_interval_
+    ) :
+    _sweep_interval( sweep_interval_ ),
+    _next_sweep( clock::now() + sweep_interval_ ),
+    _should_exit( false ),
+    _polls( 0 ),
+    _bytes( 0 ),
+    _sweeps( 0 )
+{
+    size_t thread_count = ( std::max )( static_cast<size_t>( 1 ), thread_count_ );
+    for( size_t i = 0; i < thread_count; ++i )
+    {
+        _threads.emplace_back( [ this ]() -> void { workerThread(); } );
+    }
+}
+
+InputReactor::~InputReactor()
+{
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        _should_exit = true;
+    }
+
+    _ready_condition.notify_all();
+    for( std::thread &thread : _threads )
+    {
+        if( thread.joinable() ) { thread.join(); }
+    }
+
+    //connections still registered are owned by the reactor and released with it
+    for( Source *source : _sources )
+    {
+        delete source;
+    }
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+InputReactor::Source *
+InputReactor::add(
+    PollFunction poll_
+    )
+{
+    Source *source = new Source;
+    source->poll = std::move( poll_ );
+    source->state = Source::State::IDLE;
+    source->removed = false;
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        _sources.insert( source );
+
+        //read whatever arrived before the connection was registered
+        schedule( *source );
+    }
+
+    return source;
+}
+
+bool
+InputReactor::isPolling(
+    Source *source_
+    ) const
+{
+    std::lock_guard<std::mutex> lock( _mutex );
+
+    if( !_sources.count( source_ ) ) return false;
+    return ( source_->state == Source::State::RUNNING || source_->state == Source::State::RUNNING_NOTIFIED ) && source_->poller == std::this_thread::get_id();
+}
+
+void
+InputReactor::notify(
+    Source *source_
+    )
+{
+    std::lock_guard<std::mutex> lock( _mutex );
+
+    //the pointer is only dereferenced while it is known to be registered
+    if( _sources.count( source_ ) ) { schedule( *source_ ); }
+}
+
+void
+InputReactor::remove(
+    Source *source_
+    )
+{
+    std::unique_lock<std::mutex> lock( _mutex );
+    if( !_sources.erase( source_ ) ) return;
+
+    source_->removed = true;
+    if( source_->state == Source::State::QUEUED )
+    {
+        _ready.erase( std::find( _ready.begin(), _ready.end(), source_ ), _ready.end() );
+        source_->state = Source::State::IDLE;
+    }
+
+    //a thread polling the source releases it when the poll returns
+    _idle_condition.wait( lock, [ source_ ]() -> bool { return source_->state == Source::State::IDLE; } );
+    lock.unlock();
+
+    delete source_;
+}
+
+InputReactor::Statistics
+InputReactor::statistics(
+    void
+    ) const
+{
+    std::lock_guard<std::mutex> lock( _mutex );
+
+    Statistics statistics;
+    statistics.thread_count = _threads.size();
+    statistics.source_count = _sources.size();
+    statistics.ready_depth = _ready.size();
+    statistics.polls = _polls;
+    statistics.bytes = _bytes;
+    statistics.sweeps = _sweeps;
+    return statistics;
+}
+
+//******************************************************************************
+//* Private Methods
+//******************************************************************************
+
+void
+InputReactor::schedule(
+    Source &source_
+    )
+{
+    switch( source_.state )
+    {
+    case Source::State::IDLE:
+        source_.state = Source::State::QUEUED;
+        _ready.push_back( &source_ );
+        _ready_condition.notify_one();
+        break;
+
+    case Source::State::RUNNING:
+        source_.state = Source::State::RUNNING_NOTIFIED;
+        break;
+
+    default:
+        break;
+    }
+}
+
+void
+InputReactor::workerThread(
+    void
+    )
+{
+    std::unique_lock<std::mutex> lock( _mutex );
+
+    while( !_should_exit )
+    {
+        //whichever thread notices the sweep is due schedules every connection, so streams which never signal are still read
+        clock::time_point now = clock::now();
+        if( now >= _next_sweep )
+        {
+            for( Source *source : _sources ) { schedule( *source ); }
+            _next_sweep = now + _sweep_interval;
+            ++_sweeps;
+        }
+
+        if( _ready.empty() )
+        {
+            _ready_condition.wait_until( lock, _next_sweep );
+            continue;
+        }
+
+        Source *source = _ready.front();
+        _ready.pop_front();
+        source->state = Source::State::RUNNING;
+        source->poller = std::this_thread::get_id();
+        lock.unlock();
+
+        size_t polls = 0;
+        size_t bytes = 0;
+        bool drained = false;
+        while( polls < POLL_BUDGET )
+        {
+            size_t length = 0;
+            try
+            {
+                length = source->poll();
+            }
+            catch( ... )
+            {
+                //the poll function reports its own errors; a throwing connection must not take a reactor thread down with it
+            }
+
+            ++polls;
+            bytes += length;
+            if( !length ) { drained = true; break; }
+        }
+
+        lock.lock();
+        _polls += polls;
+        _bytes += bytes;
+
+        //a connection which still had data, or was signalled while it was being polled, goes to the back of the queue
+        if( !source->removed && ( !drained || source->state == Source::State::RUNNING_NOTIFIED ) )
+        {
+            source->state = Source::State::QUEUED;
+            _ready.push_back( source );
+        }
+        else
+        {
+            source->state = Source::State::IDLE;
+            if( source->removed ) { _idle_condition.notify_all(); }
+        }
+    }
+}
@@ -0,0 +1,148 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * InputReactor services the input of many connections from a fixed pool of threads, instead of one input thread per connection.
+ * Each connection registers a poll function, which reads whatever its transport has ready and returns the number of bytes consumed.
+ * A connection is scheduled when its stream signals that data has arrived (see notify), and every connection is also scheduled once per
+ * sweep interval so streams which never signal are still read. A scheduled connection is polled by exactly one thread at a time, until it
+ * runs dry or uses up its poll budget, after which it goes to the back of the ready queue so a busy connection cannot starve the others.
+ */
+class InputReactor
+{
+public:
+    typedef std::chrono::steady_clock clock;
+    typedef std::function<size_t( void )> PollFunction;
+
+    //opaque handle to a registered connection
+    struct Source;
+
+    struct Statistics
+    {
+        size_t thread_count;
+        size_t source_count;
+        size_t ready_depth;
+        uint64_t polls;
+        uint64_t bytes;
+        uint64_t sweeps;
+    };
+
+    ///<summary>
+    ///Starts thread_count_ (at least 1) threads; registered connections are swept for input every sweep_interval_.
+    ///</summary>
+    InputReactor(
+        size_t thread_count_,
+        std::chrono::microseconds sweep_interval_
+    );
+
+    ~InputReactor();
+
+    ///<summary>
+    ///Registers a connection; poll_ is called on the reactor threads, never on two threads at once, until the source is removed.
+    ///</summary>
+    Source *
+    add(
+        PollFunction poll_
+    );
+
+    ///<summary>
+    ///Returns true if called from within the source's own poll.
+    ///</summary>
+    bool
+    isPolling(
+        Source *source_
+    ) const;
+
+    ///<summary>
+    ///Schedules the source to be polled as soon as a thread is free. May be called from any thread; does nothing once the source
+    ///has been removed.
+    ///</summary>
+    void
+    notify(
+        Source *source_
+    );
+
+    ///<summary>
+    ///Unregisters and frees the source, waiting for a poll in progress to return. Must not be called from within the source's own poll.
+    ///</summary>
+    void
+    remove(
+        Source *source_
+    );
+
+    Statistics
+    statistics(
+        void
+    ) const;
+
+private:
+    //consecutive polls given to a connection which keeps returning data before the next connection is serviced
+    static const size_t POLL_BUDGET = 8;
+
+    std::vector<std::thread> _threads;
+    clock::duration _sweep_interval;
+
+    //everything below is guarded by _mutex
+    mutable std::mutex _mutex;
+    std::condition_variable _ready_condition;
+    std::condition_variable _idle_condition;
+    std::unordered_set<Source *> _sources;
+    std::deque<Source *> _ready;
+    clock::time_point _next_sweep;
+    bool _should_exit;
+    uint64_t _polls;
+    uint64_t _bytes;
+    uint64_t _sweeps;
+
+    void
+    schedule(
+        Source &source_
+    );
+
+    void
+    workerThread(
+        void
+    );
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
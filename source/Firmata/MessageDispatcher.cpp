@@ -0,0 +1,302 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "MessageDispatcher.h"
+
+#include <algorithm>
+
+using namespace Microsoft::Maker::Firmata;
+
+namespace {
+    const uint8_t ANALOG_MESSAGE = 0xE0;
+    const uint8_t DIGITAL_MESSAGE = 0x90;
+    const uint8_t START_SYSEX = 0xF0;
+
+    template <typename T>
+    void
+    storeMax(
+        std::atomic<T> &target_,
+        T value_
+    )
+    {
+        T current = target_.load( std::memory_order_relaxed );
+        while( current < value_ && !target_.compare_exchange_weak( current, value_, std::memory_order_relaxed ) );
+    }
+}
+
+const std::chrono::milliseconds MessageDispatcher::MAX_PARK_TIME( 100 );
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+MessageDispatcher::MessageDispatcher(
+    Handler handler_,
+    size_t thread_count_,
+    size_t queue_capacity_
+    ) :
+    _handler( std::move( handler_ ) ),
+    _should_exit( false ),
+    _destroy_on_exit( false ),
+    _messages_posted( 0 ),
+    _messages_dispatched( 0 ),
+    _messages_dropped( 0 ),
+    _max_queue_depth( 0 ),
+    _last_lag_ns( 0 ),
+    _max_lag_ns( 0 )
+{
+    for( size_t lane = 0; lane < LANE_COUNT; ++lane )
+    {
+        _lanes.emplace_back( new MessageQueue( queue_capacity_ ) );
+    }
+
+    size_t thread_count = ( std::max )( static_cast<size_t>( 1 ), ( std::min )( thread_count_, static_cast<size_t>( LANE_COUNT ) ) );
+    for( size_t worker = 0; worker < thread_count; ++worker )
+    {
+        _workers.emplace_back( new Worker );
+        _workers.back()->parked.store( false );
+    }
+
+    for( size_t worker = 0; worker < thread_count; ++worker )
+    {
+        _workers[worker]->thread = std::thread( [this, worker]() -> void { workerThread( worker ); } );
+    }
+}
+
+MessageDispatcher::~MessageDispatcher()
+{
+    stop();
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+bool
+MessageDispatcher::isDispatcherThread(
+    void
+    ) const
+{
+    //the workers are created by the constructor and never change, so they may be read from any thread
+    std::thread::id current = std::this_thread::get_id();
+    for( const auto &worker : _workers )
+    {
+        if( worker->thread.get_id() == current ) return true;
+    }
+
+    return false;
+}
+
+void
+MessageDispatcher::destroy(
+    std::unique_ptr<MessageDispatcher> dispatcher_
+    )
+{
+    if( !dispatcher_ ) return;
+
+    //from any other thread the destructor joins every dispatcher thread
+    if( !dispatcher_->isDispatcherThread() )
+    {
+        dispatcher_.reset();
+        return;
+    }
+
+    //the calling worker still has the dispatcher on its stack, so it deletes it on its way out rather than now
+    dispatcher_->stop();
+    dispatcher_->_destroy_on_exit = true;
+    dispatcher_.release();
+}
+
+MessageDispatcher::Lane
+MessageDispatcher::laneFor(
+    const FirmataMessage &message_
+    )
+{
+    switch( message_.command )
+    {
+    case ANALOG_MESSAGE:
+        return ANALOG_LANE;
+    case DIGITAL_MESSAGE:
+        return DIGITAL_LANE;
+    case START_SYSEX:
+        return SYSEX_LANE;
+    default:
+        return LANE_COUNT;
+    }
+}
+
+bool
+MessageDispatcher::post(
+    const FirmataMessage &message_,
+    const std::atomic<bool> *abandon_
+    )
+{
+    Lane lane = laneFor( message_ );
+    if( lane == LANE_COUNT ) return true;
+
+    MessageQueue &queue = *_lanes[lane];
+    while( !queue.push( message_, clock::now() ) )
+    {
+        //a newer report supersedes a dropped analog or digital one, but sysex replies are awaited (the capability response, I2C
+        //replies), so for those the caller waits for the lane's thread to make room rather than lose one
+        if( lane != SYSEX_LANE || _should_exit || ( abandon_ && *abandon_ ) )
+        {
+            _messages_dropped.fetch_add( 1, std::memory_order_relaxed );
+            return false;
+        }
+
+        std::this_thread::yield();
+    }
+
+    _messages_posted.fetch_add( 1, std::memory_order_relaxed );
+    storeMax( _max_queue_depth, queue.depth() );
+
+    //pairs with the fence in workerThread, either the worker sees the message or we see it parked
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    Worker &worker = *_workers[lane % _workers.size()];
+    if( worker.parked.load( std::memory_order_relaxed ) )
+    {
+        std::lock_guard<std::mutex> lock( worker.mutex );
+        worker.condition.notify_one();
+    }
+
+    return true;
+}
+
+MessageDispatcher::Statistics
+MessageDispatcher::statistics(
+    void
+    ) const
+{
+    Statistics statistics;
+    statistics.messages_posted = _messages_posted.load( std::memory_order_relaxed );
+    statistics.messages_dispatched = _messages_dispatched.load( std::memory_order_relaxed );
+    statistics.messages_dropped = _messages_dropped.load( std::memory_order_relaxed );
+    statistics.queue_depth = 0;
+    for( const auto &lane : _lanes )
+    {
+        statistics.queue_depth += lane->depth();
+    }
+    statistics.max_queue_depth = _max_queue_depth.load( std::memory_order_relaxed );
+    statistics.last_lag = std::chrono::nanoseconds( _last_lag_ns.load( std::memory_order_relaxed ) );
+    statistics.max_lag = std::chrono::nanoseconds( _max_lag_ns.load( std::memory_order_relaxed ) );
+    return statistics;
+}
+
+void
+MessageDispatcher::stop(
+    void
+    )
+{
+    _should_exit = true;
+
+    for( auto &worker : _workers )
+    {
+        {   //critical section
+            std::lock_guard<std::mutex> lock( worker->mutex );
+            worker->condition.notify_one();
+        }
+
+        //a handler stopping its own dispatcher cannot join the thread it is running on, which exits once the handler returns
+        if( worker->thread.get_id() == std::this_thread::get_id() ) { worker->thread.detach(); }
+        else if( worker->thread.joinable() ) { worker->thread.join(); }
+    }
+}
+
+//******************************************************************************
+//* Private Methods
+//******************************************************************************
+
+size_t
+MessageDispatcher::drainLane(
+    size_t lane_
+    )
+{
+    MessageQueue &queue = *_lanes[lane_];
+    size_t dispatched = 0;
+
+    //bound the batch so one busy lane cannot starve the others on this thread
+    while( dispatched < DISPATCH_BATCH_SIZE && !_should_exit )
+    {
+        bool popped = queue.pop( [this]( const FirmataMessage &message_, clock::time_point enqueued_ ) -> void
+        {
+            int64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - enqueued_ ).count();
+            _last_lag_ns.store( lag, std::memory_order_relaxed );
+            storeMax( _max_lag_ns, lag );
+
+            _handler( message_ );
+        } );
+
+        if( !popped ) break;
+        ++dispatched;
+    }
+
+    _messages_dispatched.fetch_add( dispatched, std::memory_order_relaxed );
+    return dispatched;
+}
+
+bool
+MessageDispatcher::hasPending(
+    size_t worker_
+    ) const
+{
+    for( size_t lane = worker_; lane < LANE_COUNT; lane += _workers.size() )
+    {
+        if( _lanes[lane]->depth() ) return true;
+    }
+    return false;
+}
+
+void
+MessageDispatcher::workerThread(
+    size_t worker_
+    )
+{
+    Worker &worker = *_workers[worker_];
+
+    while( !_should_exit )
+    {
+        size_t dispatched = 0;
+        for( size_t lane = worker_; lane < LANE_COUNT; lane += _workers.size() )
+        {
+            dispatched += drainLane( lane );
+        }
+        if( dispatched ) continue;
+
+        std::unique_lock<std::mutex> lock( worker.mutex );
+        worker.parked.store( true, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+
+        //the timeout is only a backstop, post() wakes us as soon as a message arrives
+        if( !_should_exit && !hasPending( worker_ ) )
+        {
+            worker.condition.wait_for( lock, MAX_PARK_TIME );
+        }
+        worker.parked.store( false, std::memory_order_relaxed );
+    }
+
+    //only set on the detached worker which called destroy(), the others have been joined
+    if( _destroy_on_exit ) { delete this; }
+}
@@ -0,0 +1,184 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FirmataParser.h"
+#include "MessageQueue.h"
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * MessageDispatcher hands decoded messages from the input thread to a small pool of dispatcher threads, so slow application handlers
+ * never hold up reading and parsing. Messages are sorted into lanes by event type (analog, digital, sysex); each lane has its own queue
+ * and is always serviced by the same thread, so events of one type are delivered in the order they arrived while different types may be
+ * delivered concurrently. When the analog or digital lane is full the report is dropped and counted rather than stalling the input
+ * thread, since a newer one will follow; when the sysex lane is full the input thread waits for room, since sysex replies are awaited.
+ */
+class MessageDispatcher
+{
+public:
+    typedef FirmataParser::clock clock;
+    typedef std::function<void( const FirmataMessage & )> Handler;
+
+    enum Lane : size_t
+    {
+        ANALOG_LANE = 0,
+        DIGITAL_LANE,
+        SYSEX_LANE,
+        LANE_COUNT,
+    };
+
+    struct Statistics
+    {
+        uint64_t messages_posted;
+        uint64_t messages_dispatched;
+        uint64_t messages_dropped;
+        size_t queue_depth;
+        size_t max_queue_depth;
+        clock::duration last_lag;
+        clock::duration max_lag;
+    };
+
+    ///<summary>
+    ///Starts thread_count_ dispatcher threads (clamped to 1..LANE_COUNT), each lane buffering up to queue_capacity_ messages.
+    ///</summary>
+    MessageDispatcher(
+        Handler handler_,
+        size_t thread_count_,
+        size_t queue_capacity_
+    );
+
+    ~MessageDispatcher();
+
+    ///<summary>
+    ///Returns true if called from one of the dispatcher threads, i.e. from within the handler.
+    ///</summary>
+    bool
+    isDispatcherThread(
+        void
+    ) const;
+
+    ///<summary>
+    ///Stops and destroys the dispatcher, from any thread. Called from within the handler, the other threads are joined and the calling
+    ///thread destroys the dispatcher once the handler returns.
+    ///</summary>
+    static
+    void
+    destroy(
+        std::unique_ptr<MessageDispatcher> dispatcher_
+    );
+
+    ///<summary>
+    ///Returns the lane a message is delivered on, or LANE_COUNT if it does not raise an event and need not be dispatched.
+    ///</summary>
+    static
+    Lane
+    laneFor(
+        const FirmataMessage &message_
+    );
+
+    ///<summary>
+    ///Copies the message into its lane and wakes the thread servicing it. May be called from any thread but the dispatcher threads.
+    ///<para>If the sysex lane is full this waits until its thread has made room, or until abandon_ is set by a caller which is being
+    ///stopped while the lane's thread may be waiting on it.</para>
+    ///<returns>false if the message was dropped</returns>
+    ///</summary>
+    bool
+    post(
+        const FirmataMessage &message_,
+        const std::atomic<bool> *abandon_ = nullptr
+    );
+
+    Statistics
+    statistics(
+        void
+    ) const;
+
+    ///<summary>
+    ///Stops the dispatcher threads. Messages still queued are discarded. Called from within the handler, the calling thread is detached
+    ///rather than joined and the dispatcher must outlive it; see destroy().
+    ///</summary>
+    void
+    stop(
+        void
+    );
+
+private:
+    static const size_t DISPATCH_BATCH_SIZE = 64;
+    static const std::chrono::milliseconds MAX_PARK_TIME;
+
+    struct Worker
+    {
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> parked;
+    };
+
+    Handler _handler;
+    std::vector<std::unique_ptr<MessageQueue>> _lanes;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic<bool> _should_exit;
+
+    //set by destroy() when called from a dispatcher thread, which then deletes the dispatcher as it exits
+    bool _destroy_on_exit;
+
+    std::atomic<uint64_t> _messages_posted;
+    std::atomic<uint64_t> _messages_dispatched;
+    std::atomic<uint64_t> _messages_dropped;
+    std::atomic<size_t> _max_queue_depth;
+    std::atomic<int64_t> _last_lag_ns;
+    std::atomic<int64_t> _max_lag_ns;
+
+    size_t
+    drainLane(
+        size_t lane_
+    );
+
+    bool
+    hasPending(
+        size_t worker_
+    ) const;
+
+    void
+    workerThread(
+        size_t worker_
+    );
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,107 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "MessageQueue.h"
+
+using namespace Microsoft::Maker::Firmata;
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+MessageQueue::MessageQueue(
+    size_t capacity_
+    ) :
+    _enqueue_position( 0 ),
+    _dequeue_position( 0 )
+{
+    size_t capacity = 2;
+    while( capacity < capacity_ )
+    {
+        capacity <<= 1;
+    }
+
+    _slots.reset( new Slot[capacity] );
+    _mask = capacity - 1;
+
+    for( size_t i = 0; i < capacity; ++i )
+    {
+        _slots[i].sequence.store( i, std::memory_order_relaxed );
+    }
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+size_t
+MessageQueue::depth(
+    void
+    ) const
+{
+    size_t enqueued = _enqueue_position.load( std::memory_order_relaxed );
+    size_t dequeued = _dequeue_position.load( std::memory_order_relaxed );
+    return ( enqueued > dequeued ) ? ( enqueued - dequeued ) : 0;
+}
+
+bool
+MessageQueue::push(
+    const FirmataMessage &message_,
+    clock::time_point now_
+    )
+{
+    size_t position = _enqueue_position.load( std::memory_order_relaxed );
+    Slot *slot;
+
+    for( ;; )
+    {
+        slot = &_slots[position & _mask];
+        size_t sequence = slot->sequence.load( std::memory_order_acquire );
+        intptr_t difference = static_cast<intptr_t>( sequence ) - static_cast<intptr_t>( position );
+
+        if( difference == 0 )
+        {
+            if( _enqueue_position.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) ) break;
+        }
+        else if( difference < 0 )
+        {
+            //the consumer has not released this slot yet, the queue is full
+            return false;
+        }
+        else
+        {
+            position = _enqueue_position.load( std::memory_order_relaxed );
+        }
+    }
+
+    //the payload must be copied, the caller's memory is reused as soon as this returns
+    slot->payload.assign( message_.data, message_.data + message_.length );
+    slot->message = message_;
+    slot->message.data = slot->payload.data();
+    slot->enqueued = now_;
+
+    slot->sequence.store( position + 1, std::memory_order_release );
+    return true;
+}
@@ -0,0 +1,153 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "FirmataParser.h"
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * MessageQueue is a bounded, lock-free queue of decoded Firmata messages which any number of threads may push to. Each slot owns a
+ * payload buffer which is reused from message to message, so once every slot has carried a message of a given size, pushing does not
+ * allocate. The queue is an implementation of Dmitry Vyukov's bounded MPMC queue, used here with a single consumer per queue.
+ */
+class MessageQueue
+{
+public:
+    typedef FirmataParser::clock clock;
+
+    ///<summary>
+    ///Creates a queue holding at least capacity_ messages. The capacity is rounded up to a power of two.
+    ///</summary>
+    MessageQueue(
+        size_t capacity_
+    );
+
+    ///<summary>
+    ///Copies the given message into the queue.
+    ///<returns>false if the queue is full and the message was not queued</returns>
+    ///</summary>
+    bool
+    push(
+        const FirmataMessage &message_,
+        clock::time_point now_
+    );
+
+    ///<summary>
+    ///Removes the oldest message and invokes handler_( const FirmataMessage &, clock::time_point enqueued ) with it. The message payload
+    ///belongs to the queue and is only valid for the duration of the handler invocation, but may be modified in place. If the handler
+    ///throws, the message is still removed and the exception propagates to the caller.
+    ///<returns>false if the queue was empty</returns>
+    ///</summary>
+    template <typename Handler>
+    bool
+    pop(
+        Handler &&handler_
+    )
+    {
+        size_t position = _dequeue_position.load( std::memory_order_relaxed );
+        Slot *slot;
+
+        for( ;; )
+        {
+            slot = &_slots[position & _mask];
+            size_t sequence = slot->sequence.load( std::memory_order_acquire );
+            intptr_t difference = static_cast<intptr_t>( sequence ) - static_cast<intptr_t>( position + 1 );
+
+            if( difference == 0 )
+            {
+                if( _dequeue_position.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) ) break;
+            }
+            else if( difference < 0 )
+            {
+                return false;
+            }
+            else
+            {
+                position = _dequeue_position.load( std::memory_order_relaxed );
+            }
+        }
+
+        //hand the slot back to producers, one lap ahead, once the handler is done with it, even if it throws
+        struct Release
+        {
+            Slot *slot;
+            size_t sequence;
+            ~Release() { slot->sequence.store( sequence, std::memory_order_release ); }
+        } release = { slot, position + _mask + 1 };
+
+        handler_( static_cast<const FirmataMessage &>( slot->message ), slot->enqueued );
+        return true;
+    }
+
+    inline
+    size_t
+    capacity(
+        void
+    ) const
+    {
+        return _mask + 1;
+    }
+
+    ///<summary>
+    ///Returns the number of messages waiting in the queue. The value is approximate while other threads are pushing or popping.
+    ///</summary>
+    size_t
+    depth(
+        void
+    ) const;
+
+private:
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        FirmataMessage message;
+        std::vector<uint8_t> payload;
+        clock::time_point enqueued;
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+
+    //producers and the consumer each write their own position, keep them on separate cache lines
+    char _padding0[CACHE_LINE_SIZE];
+    std::atomic<size_t> _enqueue_position;
+    char _padding1[CACHE_LINE_SIZE - sizeof( std::atomic<size_t> )];
+    std::atomic<size_t> _dequeue_position;
+    char _padding2[CACHE_LINE_SIZE - sizeof( std::atomic<size_t> )];
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,117 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "NativeBuffer.h"
+
+using namespace Microsoft::Maker::Firmata;
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+NativeBuffer::NativeBuffer(
+    void
+    ) :
+    _data( nullptr ),
+    _capacity( 0 ),
+    _length( 0 )
+{
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+Windows::Storage::Streams::IBuffer ^
+NativeBuffer::create(
+    NativeBuffer **native_buffer_
+    )
+{
+    Microsoft::WRL::ComPtr<NativeBuffer> buffer = Microsoft::WRL::Make<NativeBuffer>();
+    if( !buffer )
+    {
+        throw ref new Platform::OutOfMemoryException();
+    }
+
+    //the cast itself does not add a reference, assigning it to a handle does. The handle keeps the object (and the raw pointer) alive
+    Windows::Storage::Streams::IBuffer ^view = reinterpret_cast<Windows::Storage::Streams::IBuffer ^>( static_cast<ABI::Windows::Storage::Streams::IBuffer *>( buffer.Get() ) );
+    *native_buffer_ = buffer.Get();
+    return view;
+}
+
+void
+NativeBuffer::setView(
+    uint8_t *data_,
+    size_t length_
+    )
+{
+    _data = data_;
+    _capacity = static_cast<UINT32>( length_ );
+    _length = static_cast<UINT32>( length_ );
+}
+
+HRESULT
+STDMETHODCALLTYPE
+NativeBuffer::get_Capacity(
+    UINT32 *value_
+    )
+{
+    if( value_ == nullptr ) return E_POINTER;
+    *value_ = _capacity;
+    return S_OK;
+}
+
+HRESULT
+STDMETHODCALLTYPE
+NativeBuffer::get_Length(
+    UINT32 *value_
+    )
+{
+    if( value_ == nullptr ) return E_POINTER;
+    *value_ = _length;
+    return S_OK;
+}
+
+HRESULT
+STDMETHODCALLTYPE
+NativeBuffer::put_Length(
+    UINT32 value_
+    )
+{
+    if( value_ > _capacity ) return E_INVALIDARG;
+    _length = value_;
+    return S_OK;
+}
+
+HRESULT
+STDMETHODCALLTYPE
+NativeBuffer::Buffer(
+    byte **value_
+    )
+{
+    if( value_ == nullptr ) return E_POINTER;
+    *value_ = _data;
+    return S_OK;
+}
@@ -0,0 +1,87 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <robuffer.h>
+#include <windows.storage.streams.h>
+#include <wrl.h>
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * NativeBuffer is an IBuffer which exposes memory it does not own. It is re-pointed at each received message, allowing message payloads
+ * to be handed to event subscribers without being copied into a DataWriter. Whatever the buffer points at is only valid for the duration
+ * of the event which delivered it.
+ */
+class NativeBuffer : public Microsoft::WRL::RuntimeClass<
+    Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::RuntimeClassType::WinRtClassicComMix>,
+    ABI::Windows::Storage::Streams::IBuffer,
+    Windows::Storage::Streams::IBufferByteAccess >
+{
+    InspectableClass( L"Microsoft.Maker.Firmata.NativeBuffer", BaseTrust )
+
+public:
+    NativeBuffer(
+        void
+    );
+
+    ///<summary>
+    ///Creates a NativeBuffer and returns it as a WinRT IBuffer, along with the native pointer used to re-point it.
+    ///</summary>
+    static
+    Windows::Storage::Streams::IBuffer ^
+    create(
+        NativeBuffer **native_buffer_
+    );
+
+    ///<summary>
+    ///Points the buffer at the given memory. Capacity and length both become length_.
+    ///</summary>
+    void
+    setView(
+        uint8_t *data_,
+        size_t length_
+    );
+
+    //IBuffer
+    virtual HRESULT STDMETHODCALLTYPE get_Capacity( UINT32 *value_ ) override;
+    virtual HRESULT STDMETHODCALLTYPE get_Length( UINT32 *value_ ) override;
+    virtual HRESULT STDMETHODCALLTYPE put_Length( UINT32 value_ ) override;
+
+    //IBufferByteAccess
+    virtual HRESULT STDMETHODCALLTYPE Buffer( byte **value_ ) override;
+
+private:
+    uint8_t *_data;
+    UINT32 _capacity;
+    UINT32 _length;
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,139 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "OutboundRing.h"
+
+#include <cstring>
+
+using namespace Microsoft::Maker::Firmata;
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+OutboundRing::OutboundRing(
+    size_t capacity_
+    ) :
+    _head( 0 ),
+    _tail( 0 )
+{
+    static_assert( sizeof( Header ) == HEADER_SIZE, "frame headers must keep frames 8-byte aligned" );
+
+    size_t capacity = HEADER_SIZE * 2;
+    while( capacity < capacity_ )
+    {
+        capacity <<= 1;
+    }
+
+    _words.reset( new uint64_t[capacity / sizeof( uint64_t )]() );
+    _storage = reinterpret_cast<uint8_t *>( _words.get() );
+    _mask = capacity - 1;
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+void
+OutboundRing::abandon(
+    uint8_t *frame_
+    )
+{
+    reinterpret_cast<Header *>( frame_ - HEADER_SIZE )->state.store( ABANDONED, std::memory_order_seq_cst );
+}
+
+void
+OutboundRing::commit(
+    uint8_t *frame_
+    )
+{
+    reinterpret_cast<Header *>( frame_ - HEADER_SIZE )->state.store( COMMITTED, std::memory_order_seq_cst );
+}
+
+bool
+OutboundRing::hasCommitted(
+    void
+    ) const
+{
+    return headerAt( _tail.load( std::memory_order_acquire ) ).state.load( std::memory_order_seq_cst ) != PENDING;
+}
+
+size_t
+OutboundRing::pending(
+    void
+    ) const
+{
+    size_t head = _head.load( std::memory_order_relaxed );
+    size_t tail = _tail.load( std::memory_order_relaxed );
+    return ( head > tail ) ? ( head - tail ) : 0;
+}
+
+uint8_t *
+OutboundRing::tryReserve(
+    size_t length_
+    )
+{
+    if( !length_ || length_ > maxFrameLength() ) return nullptr;
+
+    const size_t capacity = _mask + 1;
+    size_t record = recordLength( length_ );
+    size_t head = _head.load( std::memory_order_relaxed );
+    size_t padding;
+
+    for( ;; )
+    {
+        //a frame never wraps; if it does not fit before the end of the storage, the remainder is skipped
+        size_t offset = head & _mask;
+        padding = ( offset + record > capacity ) ? ( capacity - offset ) : 0;
+
+        if( head + padding + record - _tail.load( std::memory_order_acquire ) > capacity ) return nullptr;
+        if( _head.compare_exchange_weak( head, head + padding + record, std::memory_order_relaxed ) ) break;
+    }
+
+    if( padding )
+    {
+        Header &filler = headerAt( head );
+        filler.length = static_cast<uint32_t>( padding - HEADER_SIZE );
+        filler.state.store( ABANDONED, std::memory_order_release );
+        head += padding;
+    }
+
+    Header &header = headerAt( head );
+    header.length = static_cast<uint32_t>( length_ );
+    return reinterpret_cast<uint8_t *>( &header + 1 );
+}
+
+//******************************************************************************
+//* Private Methods
+//******************************************************************************
+
+void
+OutboundRing::clear(
+    size_t position_,
+    size_t length_
+    )
+{
+    std::memset( _storage + ( position_ & _mask ), 0, length_ );
+}
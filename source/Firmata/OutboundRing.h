@@ -0,0 +1,210 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * OutboundRing is a lock-free ring of variable-length frames which any number of threads may write while a single thread drains it.
+ * A producer reserves contiguous space for a whole frame, encodes the frame in place and commits it; the consumer takes committed frames
+ * strictly in reservation order, so frames are never split or interleaved. Each frame is preceded by an 8-byte aligned header holding
+ * its state (zero while it is being written) and its length.
+ */
+class OutboundRing
+{
+public:
+    ///<summary>
+    ///Creates a ring of at least capacity_ bytes. The capacity is rounded up to a power of two.
+    ///</summary>
+    OutboundRing(
+        size_t capacity_
+    );
+
+    ///<summary>
+    ///Reserves length_ contiguous bytes for a frame. Every successful reservation must be followed by commit() or abandon().
+    ///<returns>a pointer to the frame, or nullptr if the ring does not currently have room for it</returns>
+    ///</summary>
+    uint8_t *
+    tryReserve(
+        size_t length_
+    );
+
+    ///<summary>
+    ///Makes a frame returned by tryReserve() visible to the consumer.
+    ///</summary>
+    void
+    commit(
+        uint8_t *frame_
+    );
+
+    ///<summary>
+    ///Releases a frame returned by tryReserve() without sending it.
+    ///</summary>
+    void
+    abandon(
+        uint8_t *frame_
+    );
+
+    ///<summary>
+    ///Hands each committed frame to handler_( const uint8_t *, size_t ) in order, stopping at the first frame which is still being
+    ///written. Must only be called by one thread at a time.
+    ///<returns>the number of frame bytes consumed</returns>
+    ///</summary>
+    template <typename Handler>
+    size_t
+    drain(
+        Handler &&handler_
+    )
+    {
+        size_t consumed = 0;
+        size_t tail = _tail.load( std::memory_order_relaxed );
+
+        for( ;; )
+        {
+            Header &header = headerAt( tail );
+            uint32_t state = header.state.load( std::memory_order_seq_cst );
+            if( state == PENDING ) break;
+
+            size_t record = recordLength( header.length );
+            if( state == COMMITTED )
+            {
+                handler_( reinterpret_cast<const uint8_t *>( &header + 1 ), header.length );
+                consumed += header.length;
+            }
+
+            //headers of the next lap may fall anywhere in this record, so it is cleared before producers may reuse it
+            clear( tail, record );
+            tail += record;
+            _tail.store( tail, std::memory_order_release );
+        }
+
+        return consumed;
+    }
+
+    ///<summary>
+    ///Returns true if the oldest frame in the ring has been committed and is ready to drain.
+    ///</summary>
+    bool
+    hasCommitted(
+        void
+    ) const;
+
+    ///<summary>
+    ///Returns the largest frame which can ever be reserved.
+    ///</summary>
+    inline
+    size_t
+    maxFrameLength(
+        void
+    ) const
+    {
+        return ( ( _mask + 1 ) / 2 ) - HEADER_SIZE;
+    }
+
+    ///<summary>
+    ///Returns true if the given pointer was returned by tryReserve().
+    ///</summary>
+    inline
+    bool
+    owns(
+        const uint8_t *frame_
+    ) const
+    {
+        return frame_ >= _storage && frame_ < _storage + _mask + 1;
+    }
+
+    ///<summary>
+    ///Returns the number of bytes reserved and not yet drained, including headers and padding. Approximate while other threads are active.
+    ///</summary>
+    size_t
+    pending(
+        void
+    ) const;
+
+private:
+    static const size_t HEADER_SIZE = 8;
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    enum : uint32_t
+    {
+        PENDING = 0,
+        COMMITTED,
+        ABANDONED,
+    };
+
+    struct Header
+    {
+        std::atomic<uint32_t> state;
+        uint32_t length;
+    };
+
+    //storage is allocated as 64-bit words so every header is naturally aligned
+    std::unique_ptr<uint64_t[]> _words;
+    uint8_t *_storage;
+    size_t _mask;
+
+    char _padding0[CACHE_LINE_SIZE];
+    std::atomic<size_t> _head;
+    char _padding1[CACHE_LINE_SIZE - sizeof( std::atomic<size_t> )];
+    std::atomic<size_t> _tail;
+    char _padding2[CACHE_LINE_SIZE - sizeof( std::atomic<size_t> )];
+
+    void
+    clear(
+        size_t position_,
+        size_t length_
+    );
+
+    inline
+    Header &
+    headerAt(
+        size_t position_
+    ) const
+    {
+        return *reinterpret_cast<Header *>( _storage + ( position_ & _mask ) );
+    }
+
+    //the space taken by a frame and its header, rounded up so the next header is aligned
+    static
+    inline
+    size_t
+    recordLength(
+        size_t length_
+    )
+    {
+        return ( HEADER_SIZE + length_ + HEADER_SIZE - 1 ) & ~( HEADER_SIZE - 1 );
+    }
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
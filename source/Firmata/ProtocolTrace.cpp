@@ -0,0 +1,250 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "ProtocolTrace.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace Microsoft::Maker::Firmata;
+
+//******************************************************************************
+//* TraceWriter
+//******************************************************************************
+
+TraceWriter::TraceWriter(
+    void
+    ) :
+    _file( nullptr )
+{
+}
+
+TraceWriter::~TraceWriter(
+    void
+    )
+{
+    close();
+}
+
+bool
+TraceWriter::open(
+    const char *path_
+    )
+{
+    std::lock_guard<std::mutex> lock( _mutex );
+    if( _file ) return false;
+
+#ifdef _MSC_VER
+    if( fopen_s( &_file, path_, "wb" ) ) _file = nullptr;
+#else
+    _file = std::fopen( path_, "wb" );
+#endif
+
+    return writeHeader();
+}
+
+#ifdef _WIN32
+bool
+TraceWriter::open(
+    const wchar_t *path_
+    )
+{
+    std::lock_guard<std::mutex> lock( _mutex );
+    if( _file ) return false;
+    if( _wfopen_s( &_file, path_, L"wb" ) ) _file = nullptr;
+
+    return writeHeader();
+}
+#endif
+
+void
+TraceWriter::append(
+    ProtocolTrace::Direction direction_,
+    const uint8_t *data_,
+    size_t length_
+    )
+{
+    static const uint8_t padding[8] = { 0 };
+    if( !length_ ) return;
+
+    ProtocolTrace::RecordHeader header = {};
+    header.direction = direction_;
+    header.length = static_cast<uint32_t>( length_ );
+
+    std::lock_guard<std::mutex> lock( _mutex );
+    if( !_file ) return;
+
+    //taken under the lock so timestamps never run backwards in the file
+    header.timestamp_ns = static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - _start ).count() );
+
+    std::fwrite( &header, sizeof( header ), 1, _file );
+    std::fwrite( data_, 1, length_, _file );
+    std::fwrite( padding, 1, ProtocolTrace::recordSize( length_ ) - sizeof( header ) - length_, _file );
+}
+
+void
+TraceWriter::close(
+    void
+    )
+{
+    std::lock_guard<std::mutex> lock( _mutex );
+    if( !_file ) return;
+
+    std::fclose( _file );
+    _file = nullptr;
+}
+
+bool
+TraceWriter::writeHeader(
+    void
+    )
+{
+    if( !_file ) return false;
+
+    //records are buffered so tracing does not add a system call to every transport call
+    std::setvbuf( _file, nullptr, _IOFBF, FILE_BUFFER_SIZE );
+
+    ProtocolTrace::FileHeader header = {};
+    std::memcpy( header.magic, ProtocolTrace::MAGIC, sizeof( header.magic ) );
+    header.version = ProtocolTrace::VERSION;
+    header.header_size = sizeof( header );
+    header.start_time_ns = static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::system_clock::now().time_since_epoch() ).count() );
+
+    _start = std::chrono::steady_clock::now();
+    if( std::fwrite( &header, sizeof( header ), 1, _file ) != 1 )
+    {
+        std::fclose( _file );
+        _file = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+//******************************************************************************
+//* TraceReader
+//******************************************************************************
+
+TraceReader::TraceReader(
+    void
+    ) :
+    _position( 0 )
+{
+}
+
+bool
+TraceReader::load(
+    const char *path_
+    )
+{
+    std::FILE *file = nullptr;
+#ifdef _MSC_VER
+    if( fopen_s( &file, path_, "rb" ) ) return false;
+#else
+    file = std::fopen( path_, "rb" );
+#endif
+    return load( file );
+}
+
+#ifdef _WIN32
+bool
+TraceReader::load(
+    const wchar_t *path_
+    )
+{
+    std::FILE *file = nullptr;
+    if( _wfopen_s( &file, path_, L"rb" ) ) return false;
+    return load( file );
+}
+#endif
+
+bool
+TraceReader::load(
+    const uint8_t *data_,
+    size_t length_
+    )
+{
+    ProtocolTrace::FileHeader header;
+    if( length_ < sizeof( header ) ) return false;
+
+    std::memcpy( &header, data_, sizeof( header ) );
+    if( std::memcmp( header.magic, ProtocolTrace::MAGIC, sizeof( header.magic ) ) || header.version != ProtocolTrace::VERSION || header.header_size < sizeof( header ) || header.header_size > length_ ) return false;
+
+    _contents.assign( data_, data_ + length_ );
+    _position = header.header_size;
+    return true;
+}
+
+bool
+TraceReader::next(
+    ProtocolTrace::Record &record_
+    )
+{
+    ProtocolTrace::RecordHeader header;
+    if( _contents.size() - _position < sizeof( header ) ) return false;
+
+    std::memcpy( &header, _contents.data() + _position, sizeof( header ) );
+    if( _contents.size() - _position - sizeof( header ) < header.length ) return false;
+
+    record_.timestamp_ns = header.timestamp_ns;
+    record_.direction = static_cast<ProtocolTrace::Direction>( header.direction );
+    record_.data = _contents.data() + _position + sizeof( header );
+    record_.length = header.length;
+
+    //the final record's padding may be missing if the trace was cut short
+    _position = ( std::min )( _position + ProtocolTrace::recordSize( header.length ), _contents.size() );
+    return true;
+}
+
+void
+TraceReader::rewind(
+    void
+    )
+{
+    if( _contents.empty() ) return;
+
+    ProtocolTrace::FileHeader header;
+    std::memcpy( &header, _contents.data(), sizeof( header ) );
+    _position = header.header_size;
+}
+
+bool
+TraceReader::load(
+    std::FILE *file_
+    )
+{
+    if( !file_ ) return false;
+
+    std::vector<uint8_t> contents;
+    uint8_t chunk[4096];
+    size_t length;
+    while( ( length = std::fread( chunk, 1, sizeof( chunk ), file_ ) ) > 0 )
+    {
+        contents.insert( contents.end(), chunk, chunk + length );
+    }
+    std::fclose( file_ );
+
+    return load( contents.data(), contents.size() );
+}
@@ -0,0 +1,217 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * A protocol trace is a 32-byte file header followed by one record per transport call, each a 16-byte record header and the bytes
+ * moved, padded to a multiple of 8 bytes. All fields are little-endian and naturally aligned, so a trace may be memory-mapped and
+ * walked in place. Timestamps are monotonic nanoseconds since the trace was opened.
+ */
+namespace ProtocolTrace {
+
+const char MAGIC[8] = { 'F', 'M', 'T', 'R', 'A', 'C', 'E', '1' };
+const uint32_t VERSION = 1;
+
+enum Direction : uint8_t
+{
+    //bytes read from the device
+    INBOUND = 0,
+    //bytes written to the device
+    OUTBOUND = 1,
+};
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    //wall-clock time the trace was opened, in nanoseconds since the UNIX epoch, for reference only
+    uint64_t start_time_ns;
+    uint64_t reserved;
+};
+
+struct RecordHeader
+{
+    uint64_t timestamp_ns;
+    uint32_t length;
+    uint8_t direction;
+    uint8_t reserved[3];
+};
+
+struct Record
+{
+    uint64_t timestamp_ns;
+    Direction direction;
+    const uint8_t *data;
+    size_t length;
+};
+
+static_assert( sizeof( FileHeader ) == 32, "the trace file header layout is fixed" );
+static_assert( sizeof( RecordHeader ) == 16, "the trace record header layout is fixed" );
+
+//the space taken by a record header and its payload in the file
+inline
+size_t
+recordSize(
+    size_t length_
+)
+{
+    return sizeof( RecordHeader ) + ( ( length_ + 7 ) & ~static_cast<size_t>( 7 ) );
+}
+
+} // namespace ProtocolTrace
+
+/*
+ * TraceWriter appends records to a trace file. Appends are serialized internally, so the input thread and the transmit path may
+ * record concurrently.
+ */
+class TraceWriter
+{
+public:
+    TraceWriter(
+        void
+    );
+
+    ~TraceWriter(
+        void
+    );
+
+    ///<summary>
+    ///Creates or truncates the given file and writes the trace header. Timestamps are measured from this call.
+    ///</summary>
+    bool
+    open(
+        const char *path_
+    );
+
+#ifdef _WIN32
+    bool
+    open(
+        const wchar_t *path_
+    );
+#endif
+
+    void
+    append(
+        ProtocolTrace::Direction direction_,
+        const uint8_t *data_,
+        size_t length_
+    );
+
+    void
+    close(
+        void
+    );
+
+    inline
+    bool
+    isOpen(
+        void
+    ) const
+    {
+        return _file != nullptr;
+    }
+
+private:
+    static const size_t FILE_BUFFER_SIZE = 64 * 1024;
+
+    std::mutex _mutex;
+    std::FILE *_file;
+    std::chrono::steady_clock::time_point _start;
+
+    bool
+    writeHeader(
+        void
+    );
+};
+
+/*
+ * TraceReader loads a trace file and walks its records in order.
+ */
+class TraceReader
+{
+public:
+    TraceReader(
+        void
+    );
+
+    bool
+    load(
+        const char *path_
+    );
+
+#ifdef _WIN32
+    bool
+    load(
+        const wchar_t *path_
+    );
+#endif
+
+    ///<summary>
+    ///Loads a trace which is already in memory, such as a mapped file. The contents are copied.
+    ///</summary>
+    bool
+    load(
+        const uint8_t *data_,
+        size_t length_
+    );
+
+    ///<summary>
+    ///Returns the next record, or false at the end of the trace or at a truncated record.
+    ///</summary>
+    bool
+    next(
+        ProtocolTrace::Record &record_
+    );
+
+    void
+    rewind(
+        void
+    );
+
+private:
+    std::vector<uint8_t> _contents;
+    size_t _position;
+
+    bool
+    load(
+        std::FILE *file_
+    );
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
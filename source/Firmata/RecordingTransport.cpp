@@ -0,0 +1,84 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "RecordingTransport.h"
+
+using namespace Microsoft::Maker::Firmata;
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+RecordingTransport::RecordingTransport(
+    std::unique_ptr<FirmataTransport> transport_,
+    std::unique_ptr<TraceWriter> writer_
+    ) :
+    _transport( std::move( transport_ ) ),
+    _writer( std::move( writer_ ) )
+{
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+std::unique_ptr<FirmataTransport>
+RecordingTransport::detach(
+    void
+    )
+{
+    _writer->close();
+    return std::move( _transport );
+}
+
+void
+RecordingTransport::flush(
+    void
+    )
+{
+    _transport->flush();
+}
+
+size_t
+RecordingTransport::read(
+    uint8_t *buffer_,
+    size_t length_
+    )
+{
+    size_t length = _transport->read( buffer_, length_ );
+    _writer->append( ProtocolTrace::INBOUND, buffer_, length );
+    return length;
+}
+
+size_t
+RecordingTransport::write(
+    const uint8_t *buffer_,
+    size_t length_
+    )
+{
+    size_t length = _transport->write( buffer_, length_ );
+    _writer->append( ProtocolTrace::OUTBOUND, buffer_, length );
+    return length;
+}
@@ -0,0 +1,82 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <memory>
+#include "FirmataTransport.h"
+#include "ProtocolTrace.h"
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * RecordingTransport passes every call through to another transport and records the bytes actually moved, in both directions,
+ * to a TraceWriter.
+ */
+class RecordingTransport : public FirmataTransport
+{
+public:
+    RecordingTransport(
+        std::unique_ptr<FirmataTransport> transport_,
+        std::unique_ptr<TraceWriter> writer_
+    );
+
+    virtual
+    size_t
+    read(
+        uint8_t *buffer_,
+        size_t length_
+    ) override;
+
+    virtual
+    size_t
+    write(
+        const uint8_t *buffer_,
+        size_t length_
+    ) override;
+
+    virtual
+    void
+    flush(
+        void
+    ) override;
+
+    ///<summary>
+    ///Closes the trace and hands back the wrapped transport.
+    ///</summary>
+    std::unique_ptr<FirmataTransport>
+    detach(
+        void
+    );
+
+private:
+    std::unique_ptr<FirmataTransport> _transport;
+    std::unique_ptr<TraceWriter> _writer;
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,257 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "SevenBitCodec.h"
+
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __SSE2__ )
+#define SEVEN_BIT_CODEC_X86
+#include <immintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#define SEVEN_BIT_CODEC_AVX2_TARGET
+#else
+#define SEVEN_BIT_CODEC_AVX2_TARGET __attribute__(( target( "avx2" ) ))
+#endif
+#endif
+
+using namespace Microsoft::Maker::Firmata;
+
+namespace {
+
+#ifdef SEVEN_BIT_CODEC_X86
+
+    bool
+    detectAvx2(
+        void
+    )
+    {
+#if defined( _MSC_VER )
+        int info[4];
+        __cpuid( info, 0 );
+        if( info[0] < 7 ) return false;
+
+        //the OS must also save the upper halves of the ymm registers
+        __cpuid( info, 1 );
+        bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+        bool avx = ( info[2] & ( 1 << 28 ) ) != 0;
+        if( !osxsave || !avx || ( _xgetbv( 0 ) & 0x6 ) != 0x6 ) return false;
+
+        __cpuidex( info, 7, 0 );
+        return ( info[1] & ( 1 << 5 ) ) != 0;
+#else
+        return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+    }
+
+    const bool HAS_AVX2 = detectAvx2();
+
+    //16 bytes in, 32 bytes out
+    inline
+    void
+    encodeBlockSse2(
+        const uint8_t *source_,
+        uint8_t *destination_
+    )
+    {
+        const __m128i low_mask = _mm_set1_epi8( 0x7F );
+        const __m128i bit_mask = _mm_set1_epi8( 0x01 );
+
+        __m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i *>( source_ ) );
+        __m128i low = _mm_and_si128( bytes, low_mask );
+        __m128i high = _mm_and_si128( _mm_srli_epi16( bytes, 7 ), bit_mask );
+
+        _mm_storeu_si128( reinterpret_cast<__m128i *>( destination_ ), _mm_unpacklo_epi8( low, high ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i *>( destination_ + 16 ), _mm_unpackhi_epi8( low, high ) );
+    }
+
+    //each 16-bit lane holds one pair, low byte first; returns the decoded byte in the low half of each lane
+    inline
+    __m128i
+    decodePairsSse2(
+        __m128i pairs_
+    )
+    {
+        const __m128i low_mask = _mm_set1_epi16( 0x00FF );
+        const __m128i bit_mask = _mm_set1_epi16( 0x0080 );
+        return _mm_or_si128( _mm_and_si128( pairs_, low_mask ), _mm_and_si128( _mm_srli_epi16( pairs_, 1 ), bit_mask ) );
+    }
+
+    //32 bytes in, 16 bytes out
+    inline
+    void
+    decodeBlockSse2(
+        const uint8_t *source_,
+        uint8_t *destination_
+    )
+    {
+        __m128i first = decodePairsSse2( _mm_loadu_si128( reinterpret_cast<const __m128i *>( source_ ) ) );
+        __m128i second = decodePairsSse2( _mm_loadu_si128( reinterpret_cast<const __m128i *>( source_ + 16 ) ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i *>( destination_ ), _mm_packus_epi16( first, second ) );
+    }
+
+    SEVEN_BIT_CODEC_AVX2_TARGET
+    size_t
+    encodeAvx2(
+        const uint8_t *source_,
+        size_t length_,
+        uint8_t *destination_
+    )
+    {
+        const __m256i low_mask = _mm256_set1_epi8( 0x7F );
+        const __m256i bit_mask = _mm256_set1_epi8( 0x01 );
+        size_t i = 0;
+
+        for( ; i + 32 <= length_; i += 32 )
+        {
+            __m256i bytes = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( source_ + i ) );
+            __m256i low = _mm256_and_si256( bytes, low_mask );
+            __m256i high = _mm256_and_si256( _mm256_srli_epi16( bytes, 7 ), bit_mask );
+
+            //unpack works within 128-bit lanes, so the halves are put back in order afterwards
+            __m256i first = _mm256_unpacklo_epi8( low, high );
+            __m256i second = _mm256_unpackhi_epi8( low, high );
+            _mm256_storeu_si256( reinterpret_cast<__m256i *>( destination_ + i * 2 ), _mm256_permute2x128_si256( first, second, 0x20 ) );
+            _mm256_storeu_si256( reinterpret_cast<__m256i *>( destination_ + i * 2 + 32 ), _mm256_permute2x128_si256( first, second, 0x31 ) );
+        }
+
+        return i;
+    }
+
+    SEVEN_BIT_CODEC_AVX2_TARGET
+    size_t
+    decodeAvx2(
+        const uint8_t *source_,
+        size_t count_,
+        uint8_t *destination_
+    )
+    {
+        const __m256i low_mask = _mm256_set1_epi16( 0x00FF );
+        const __m256i bit_mask = _mm256_set1_epi16( 0x0080 );
+        size_t i = 0;
+
+        for( ; i + 32 <= count_; i += 32 )
+        {
+            __m256i first = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( source_ + i * 2 ) );
+            __m256i second = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( source_ + i * 2 + 32 ) );
+            first = _mm256_or_si256( _mm256_and_si256( first, low_mask ), _mm256_and_si256( _mm256_srli_epi16( first, 1 ), bit_mask ) );
+            second = _mm256_or_si256( _mm256_and_si256( second, low_mask ), _mm256_and_si256( _mm256_srli_epi16( second, 1 ), bit_mask ) );
+
+            //pack works within 128-bit lanes, reorder the quadwords to restore byte order
+            __m256i packed = _mm256_permute4x64_epi64( _mm256_packus_epi16( first, second ), 0xD8 );
+            _mm256_storeu_si256( reinterpret_cast<__m256i *>( destination_ + i ), packed );
+        }
+
+        return i;
+    }
+
+#endif
+
+}
+
+//******************************************************************************
+//* Public Functions
+//******************************************************************************
+
+size_t
+SevenBitCodec::encode(
+    const uint8_t *source_,
+    size_t length_,
+    uint8_t *destination_
+    )
+{
+    size_t i = 0;
+
+#ifdef SEVEN_BIT_CODEC_X86
+    if( HAS_AVX2 )
+    {
+        i = encodeAvx2( source_, length_, destination_ );
+    }
+
+    for( ; i + 16 <= length_; i += 16 )
+    {
+        encodeBlockSse2( source_ + i, destination_ + i * 2 );
+    }
+#endif
+
+    encodeScalar( source_ + i, length_ - i, destination_ + i * 2 );
+    return length_ * 2;
+}
+
+size_t
+SevenBitCodec::decode(
+    const uint8_t *source_,
+    size_t length_,
+    uint8_t *destination_
+    )
+{
+    size_t count = length_ / 2;
+    size_t i = 0;
+
+    //every block reads its input before storing output at or below it, so decoding in place is safe
+#ifdef SEVEN_BIT_CODEC_X86
+    if( HAS_AVX2 )
+    {
+        i = decodeAvx2( source_, count, destination_ );
+    }
+
+    for( ; i + 16 <= count; i += 16 )
+    {
+        decodeBlockSse2( source_ + i * 2, destination_ + i );
+    }
+#endif
+
+    decodeScalar( source_ + i * 2, ( count - i ) * 2, destination_ + i );
+    return count;
+}
+
+size_t
+SevenBitCodec::encodeScalar(
+    const uint8_t *source_,
+    size_t length_,
+    uint8_t *destination_
+    )
+{
+    for( size_t i = 0; i < length_; ++i )
+    {
+        destination_[i * 2 + 0] = source_[i] & 0x7F;
+        destination_[i * 2 + 1] = ( source_[i] >> 7 ) & 0x01;
+    }
+    return length_ * 2;
+}
+
+size_t
+SevenBitCodec::decodeScalar(
+    const uint8_t *source_,
+    size_t length_,
+    uint8_t *destination_
+    )
+{
+    size_t count = length_ / 2;
+    for( size_t i = 0; i < count; ++i )
+    {
+        destination_[i] = static_cast<uint8_t>( source_[i * 2 + 0] | ( source_[i * 2 + 1] << 7 ) );
+    }
+    return count;
+}
@@ -0,0 +1,81 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * Whole-buffer kernels for the "two 7-bit bytes" encoding used by STRING_DATA, I2C_REQUEST and I2C_REPLY, where each byte travels as
+ * its low seven bits followed by its most significant bit. The vectorized kernels (SSE2 on x86/x64, AVX2 when the processor supports it)
+ * produce exactly the same output as the scalar ones, which are used on ARM and for buffer tails.
+ */
+namespace SevenBitCodec {
+
+///<summary>
+///Encodes length_ bytes from source_ into 2 * length_ bytes at destination_, which must not overlap source_.
+///<returns>the number of bytes written</returns>
+///</summary>
+size_t
+encode(
+    const uint8_t *source_,
+    size_t length_,
+    uint8_t *destination_
+);
+
+///<summary>
+///Decodes length_ / 2 bytes from the byte pairs at source_ into destination_. destination_ may equal source_ to decode in place.
+///<returns>the number of bytes written</returns>
+///</summary>
+size_t
+decode(
+    const uint8_t *source_,
+    size_t length_,
+    uint8_t *destination_
+);
+
+//reference implementations, exposed for benchmarking and verification
+size_t
+encodeScalar(
+    const uint8_t *source_,
+    size_t length_,
+    uint8_t *destination_
+);
+
+size_t
+decodeScalar(
+    const uint8_t *source_,
+    size_t length_,
+    uint8_t *destination_
+);
+
+} // namespace SevenBitCodec
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
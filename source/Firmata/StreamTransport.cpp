@@ -0,0 +1,104 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "UwpFirmata.h"
+#include "StreamTransport.h"
+#include <algorithm>
+
+using namespace Microsoft::Maker::Firmata;
+
+namespace {
+    //IStream::write reports the number of bytes written as a 16-bit value, so larger frames are handed over in pieces
+    const size_t MAX_WRITE_LENGTH = 0xFFFF;
+}
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+StreamTransport::StreamTransport(
+    Serial::IStream ^stream_
+    ) :
+    _stream( stream_ ),
+    _bulk_stream( dynamic_cast<IBulkStream ^>( stream_ ) )
+{
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+size_t
+StreamTransport::read(
+    uint8_t *buffer_,
+    size_t length_
+    )
+{
+    if( !length_ ) return 0;
+
+    if( _bulk_stream != nullptr )
+    {
+        return _bulk_stream->readBytes( Platform::ArrayReference<uint8_t>( buffer_, static_cast<unsigned int>( length_ ) ) );
+    }
+
+    //byte-at-a-time adapter for streams which only implement IStream
+    size_t bytes_read = 0;
+    while( bytes_read < length_ )
+    {
+        uint16_t data = _stream->read();
+        if( data == static_cast<uint16_t>( -1 ) ) break;
+        buffer_[bytes_read++] = static_cast<uint8_t>( data & 0xFF );
+    }
+
+    return bytes_read;
+}
+
+size_t
+StreamTransport::write(
+    const uint8_t *buffer_,
+    size_t length_
+    )
+{
+    size_t bytes_written = 0;
+    while( bytes_written < length_ )
+    {
+        size_t chunk = ( std::min )( length_ - bytes_written, MAX_WRITE_LENGTH );
+        size_t accepted = _stream->write( Platform::ArrayReference<uint8_t>( const_cast<uint8_t *>( buffer_ + bytes_written ), static_cast<unsigned int>( chunk ) ) );
+
+        //a stream which accepts nothing is not going to accept the rest of the frame either
+        if( !accepted ) break;
+        bytes_written += accepted;
+    }
+
+    return bytes_written;
+}
+
+void
+StreamTransport::flush(
+    void
+    )
+{
+    _stream->flush();
+}
@@ -0,0 +1,76 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "FirmataTransport.h"
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+interface class IBulkStream;
+
+/*
+ * StreamTransport adapts a Serial::IStream to the bulk FirmataTransport contract. Frames are written with a single array write.
+ * Reads use IBulkStream::readBytes when the stream implements it, otherwise the byte-at-a-time IStream::read() is called until the
+ * caller's buffer is full or no more data is available.
+ */
+class StreamTransport : public FirmataTransport
+{
+public:
+    StreamTransport(
+        Serial::IStream ^stream_
+    );
+
+    virtual
+    size_t
+    read(
+        uint8_t *buffer_,
+        size_t length_
+    ) override;
+
+    virtual
+    size_t
+    write(
+        const uint8_t *buffer_,
+        size_t length_
+    ) override;
+
+    virtual
+    void
+    flush(
+        void
+    ) override;
+
+private:
+    Serial::IStream ^_stream;
+
+    //non-null only if the stream supports bulk reads
+    IBulkStream ^_bulk_stream;
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,132 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * TimedMutex wraps a standard mutex type and counts how often it is taken, how often a caller had to wait for it and for how long.
+ * An uncontended lock costs one try_lock; the clock is only read when the mutex is already held. The counters are written only by
+ * the thread holding the mutex, so they need no atomic read-modify-write, and they can be read at any time from any thread.
+ * This header has no dependencies beyond the standard library so that RemoteWiring can use it as well.
+ */
+template <typename Mutex>
+class TimedMutex
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    struct Statistics
+    {
+        uint64_t acquisitions;
+        uint64_t contentions;
+        uint64_t wait_ns;
+    };
+
+    TimedMutex(
+        void
+    ) :
+        _acquisitions( 0 ),
+        _contentions( 0 ),
+        _wait_ns( 0 )
+    {
+    }
+
+    void
+    lock(
+        void
+    )
+    {
+        if( _mutex.try_lock() )
+        {
+            increment( _acquisitions, 1 );
+            return;
+        }
+
+        auto start = clock::now();
+        _mutex.lock();
+        increment( _wait_ns, static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - start ).count() ) );
+        increment( _contentions, 1 );
+        increment( _acquisitions, 1 );
+    }
+
+    bool
+    try_lock(
+        void
+    )
+    {
+        if( !_mutex.try_lock() ) return false;
+        increment( _acquisitions, 1 );
+        return true;
+    }
+
+    void
+    unlock(
+        void
+    )
+    {
+        _mutex.unlock();
+    }
+
+    Statistics
+    statistics(
+        void
+    ) const
+    {
+        Statistics statistics = { _acquisitions.load( std::memory_order_relaxed ), _contentions.load( std::memory_order_relaxed ), _wait_ns.load( std::memory_order_relaxed ) };
+        return statistics;
+    }
+
+private:
+    Mutex _mutex;
+    std::atomic<uint64_t> _acquisitions;
+    std::atomic<uint64_t> _contentions;
+    std::atomic<uint64_t> _wait_ns;
+
+    //only ever called with the mutex held
+    static
+    inline
+    void
+    increment(
+        std::atomic<uint64_t> &counter_,
+        uint64_t amount_
+    )
+    {
+        counter_.store( counter_.load( std::memory_order_relaxed ) + amount_, std::memory_order_relaxed );
+    }
+
+    TimedMutex( const TimedMutex & ) = delete;
+    TimedMutex & operator=( const TimedMutex & ) = delete;
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
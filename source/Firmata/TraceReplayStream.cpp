@@ -0,0 +1,238 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "TraceReplayStream.h"
+#include "TraceReplayer.h"
+#include <algorithm>
+
+using namespace Microsoft::Maker::Firmata;
+
+//******************************************************************************
+//* Constructors / Destructors
+//******************************************************************************
+
+TraceReplayStream::TraceReplayStream(
+    Platform::String ^trace_path_,
+    double speed_
+    ) :
+    _connection_ready( ATOMIC_VAR_INIT( false ) ),
+    _stream_lock( _mutex, std::defer_lock )
+{
+    TraceReader reader;
+    if( trace_path_ != nullptr && reader.load( trace_path_->Data() ) )
+    {
+        _replayer.reset( new TraceReplayer( std::move( reader ), speed_ ) );
+    }
+}
+
+TraceReplayStream::~TraceReplayStream(
+    void
+    )
+{
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+bool
+TraceReplayStream::IsFinished::get(
+    void
+    )
+{
+    return !_replayer || _replayer->finished();
+}
+
+uint16_t
+TraceReplayStream::available(
+    void
+    )
+{
+    if( !_replayer ) return 0;
+    return static_cast<uint16_t>( ( std::min )( _replayer->available( TraceReplayer::clock::now() ), static_cast<size_t>( 0xFFFF ) ) );
+}
+
+void
+TraceReplayStream::begin(
+    uint32_t baud_,
+    Serial::SerialConfig config_
+    )
+{
+    if( !_replayer )
+    {
+        ConnectionFailed( L"The trace could not be loaded." );
+        return;
+    }
+
+    _replayer->start( TraceReplayer::clock::now() );
+    _connection_ready = true;
+    ConnectionEstablished();
+}
+
+bool
+TraceReplayStream::connectionReady(
+    void
+    )
+{
+    return _connection_ready;
+}
+
+void
+TraceReplayStream::end(
+    void
+    )
+{
+    _connection_ready = false;
+}
+
+void
+TraceReplayStream::flush(
+    void
+    )
+{
+}
+
+void
+TraceReplayStream::lock(
+    void
+    )
+{
+    _stream_lock.lock();
+}
+
+uint16_t
+TraceReplayStream::print(
+    uint8_t c_
+    )
+{
+    return write( c_ );
+}
+
+uint16_t
+TraceReplayStream::print(
+    int32_t value_
+    )
+{
+    return 0;
+}
+
+uint16_t
+TraceReplayStream::print(
+    int32_t value_,
+    Serial::Radix base_
+    )
+{
+    return 0;
+}
+
+uint16_t
+TraceReplayStream::print(
+    uint32_t value_
+    )
+{
+    return 0;
+}
+
+uint16_t
+TraceReplayStream::print(
+    uint32_t value_,
+    Serial::Radix base_
+    )
+{
+    return 0;
+}
+
+uint16_t
+TraceReplayStream::print(
+    double value_
+    )
+{
+    return 0;
+}
+
+uint16_t
+TraceReplayStream::print(
+    double value_,
+    int16_t decimal_place_
+    )
+{
+    return 0;
+}
+
+uint16_t
+TraceReplayStream::print(
+    const Platform::Array<uint8_t> ^buffer_
+    )
+{
+    return write( buffer_ );
+}
+
+uint16_t
+TraceReplayStream::read(
+    void
+    )
+{
+    uint8_t byte;
+    if( !_connection_ready || !_replayer || !_replayer->read( &byte, 1, TraceReplayer::clock::now() ) )
+    {
+        //IStream reports an empty stream as -1
+        return static_cast<uint16_t>( -1 );
+    }
+    return byte;
+}
+
+uint32_t
+TraceReplayStream::readBytes(
+    Platform::WriteOnlyArray<uint8_t> ^buffer_
+    )
+{
+    if( !_connection_ready || !_replayer || buffer_ == nullptr ) return 0;
+    return static_cast<uint32_t>( _replayer->read( buffer_->Data, buffer_->Length, TraceReplayer::clock::now() ) );
+}
+
+void
+TraceReplayStream::unlock(
+    void
+    )
+{
+    _stream_lock.unlock();
+}
+
+uint16_t
+TraceReplayStream::write(
+    uint8_t c_
+    )
+{
+    //the recorded device does not react to the host, so outbound data is accepted and dropped
+    return 1;
+}
+
+uint16_t
+TraceReplayStream::write(
+    const Platform::Array<uint8_t> ^buffer_
+    )
+{
+    return ( buffer_ == nullptr ) ? 0 : static_cast<uint16_t>( ( std::min )( buffer_->Length, 0xFFFFu ) );
+}
@@ -0,0 +1,207 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include "UwpFirmata.h"
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+class TraceReplayer;
+
+///<summary>
+///A Serial::IStream which plays back the device side of a trace recorded with UwpFirmata::startTrace(), so a recorded session can be
+///fed through UwpFirmata and RemoteDevice without a board attached. Bytes written by the host are accepted and discarded.
+///</summary>
+public ref class TraceReplayStream sealed : Serial::IStream, IBulkStream
+{
+public:
+    virtual event Serial::IStreamConnectionCallback ^ConnectionEstablished;
+    virtual event Serial::IStreamConnectionCallbackWithMessage ^ConnectionFailed;
+    virtual event Serial::IStreamConnectionCallbackWithMessage ^ConnectionLost;
+
+    ///<summary>
+    ///Loads the given trace. A speed_ of 1.0 replays received data at the pace it was recorded, 2.0 twice as fast, and 0.0 delivers
+    ///everything as fast as it is read. The replay clock starts when begin() is called.
+    ///</summary>
+    TraceReplayStream(
+        Platform::String ^trace_path_,
+        double speed_
+    );
+
+    virtual
+    ~TraceReplayStream(
+        void
+    );
+
+    ///<summary>
+    ///Returns true once all recorded device data has been read.
+    ///</summary>
+    property bool IsFinished { bool get(); }
+
+    virtual
+    uint16_t
+    available(
+        void
+    );
+
+    ///<summary>
+    ///Starts the replay. The baud rate and configuration are ignored; ConnectionEstablished is raised if the trace was loaded, and
+    ///ConnectionFailed otherwise.
+    ///</summary>
+    virtual
+    void
+    begin(
+        uint32_t baud_,
+        Serial::SerialConfig config_
+    );
+
+    virtual
+    bool
+    connectionReady(
+        void
+    );
+
+    virtual
+    void
+    end(
+        void
+    );
+
+    virtual
+    void
+    flush(
+        void
+    );
+
+    virtual
+    void
+    lock(
+        void
+    );
+
+    [Windows::Foundation::Metadata::DefaultOverload]
+    virtual
+    uint16_t
+    print(
+        uint8_t c_
+    );
+
+    virtual
+    uint16_t
+    print(
+        int32_t value_
+    );
+
+    [Windows::Foundation::Metadata::DefaultOverload]
+    virtual
+    uint16_t
+    print(
+        int32_t value_,
+        Serial::Radix base_
+    );
+
+    virtual
+    uint16_t
+    print(
+        uint32_t value_
+    );
+
+    virtual
+    uint16_t
+    print(
+        uint32_t value_,
+        Serial::Radix base_
+    );
+
+    virtual
+    uint16_t
+    print(
+        double value_
+    );
+
+    virtual
+    uint16_t
+    print(
+        double value_,
+        int16_t decimal_place_
+    );
+
+    virtual
+    uint16_t
+    print(
+        const Platform::Array<uint8_t> ^buffer_
+    );
+
+    virtual
+    uint16_t
+    read(
+        void
+    );
+
+    ///<summary>
+    ///Reads up to buffer_->Length recorded bytes which are due, without waiting for more to become due.
+    ///</summary>
+    virtual
+    uint32_t
+    readBytes(
+        Platform::WriteOnlyArray<uint8_t> ^buffer_
+    );
+
+    virtual
+    void
+    unlock(
+        void
+    );
+
+    [Windows::Foundation::Metadata::DefaultOverload]
+    virtual
+    uint16_t
+    write(
+        uint8_t c_
+    );
+
+    virtual
+    uint16_t
+    write(
+        const Platform::Array<uint8_t> ^buffer_
+    );
+
+private:
+    //null if the trace could not be loaded
+    std::unique_ptr<TraceReplayer> _replayer;
+    std::atomic_bool _connection_ready;
+
+    //thread-safe mechanisms for lock() and unlock()
+    std::mutex _mutex;
+    std::unique_lock<std::mutex> _stream_lock;
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
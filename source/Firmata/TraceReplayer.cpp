@@ -0,0 +1,131 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "TraceReplayer.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace Microsoft::Maker::Firmata;
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+TraceReplayer::TraceReplayer(
+    TraceReader reader_,
+    double speed_
+    ) :
+    _reader( std::move( reader_ ) ),
+    _speed( ( std::max )( speed_, 0.0 ) ),
+    _offset( 0 ),
+    _finished( false )
+{
+    start( clock::now() );
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+size_t
+TraceReplayer::available(
+    clock::time_point now_
+    ) const
+{
+    if( _finished || nextDue() > now_ ) return 0;
+    return _record.length - _offset;
+}
+
+bool
+TraceReplayer::finished(
+    void
+    ) const
+{
+    return _finished;
+}
+
+TraceReplayer::clock::time_point
+TraceReplayer::nextDue(
+    void
+    ) const
+{
+    if( _finished ) return clock::time_point::max();
+    if( _speed <= 0.0 ) return _start;
+
+    return _start + std::chrono::duration_cast<clock::duration>( std::chrono::duration<double, std::nano>( _record.timestamp_ns / _speed ) );
+}
+
+size_t
+TraceReplayer::read(
+    uint8_t *buffer_,
+    size_t length_,
+    clock::time_point now_
+    )
+{
+    size_t copied = 0;
+
+    while( copied < length_ && !_finished && nextDue() <= now_ )
+    {
+        size_t length = ( std::min )( length_ - copied, _record.length - _offset );
+        std::memcpy( buffer_ + copied, _record.data + _offset, length );
+        copied += length;
+        _offset += length;
+
+        if( _offset == _record.length ) advance();
+    }
+
+    return copied;
+}
+
+void
+TraceReplayer::start(
+    clock::time_point start_
+    )
+{
+    _start = start_;
+    _finished = false;
+    _reader.rewind();
+    advance();
+}
+
+//******************************************************************************
+//* Private Methods
+//******************************************************************************
+
+void
+TraceReplayer::advance(
+    void
+    )
+{
+    _offset = 0;
+
+    while( _reader.next( _record ) )
+    {
+        if( _record.direction == ProtocolTrace::INBOUND && _record.length ) return;
+    }
+
+    _finished = true;
+}
@@ -0,0 +1,116 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "ProtocolTrace.h"
+
+namespace Microsoft {
+namespace Maker {
+namespace Firmata {
+
+/*
+ * TraceReplayer plays back the inbound side of a recorded trace, releasing each record's bytes once the time at which they were
+ * originally received has elapsed, scaled by the replay speed. Outbound records are skipped; the replayed session does not react to
+ * what the host sends. The caller supplies the current time, so a replay can be driven from a real clock or a simulated one.
+ */
+class TraceReplayer
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    ///<summary>
+    ///Takes ownership of a loaded trace. A speed_ of 1.0 replays at the original pace, 2.0 twice as fast, and 0.0 releases every
+    ///record immediately.
+    ///</summary>
+    TraceReplayer(
+        TraceReader reader_,
+        double speed_
+    );
+
+    ///<summary>
+    ///Returns the number of inbound bytes which can be read without crossing into a record that is not yet due.
+    ///</summary>
+    size_t
+    available(
+        clock::time_point now_
+    ) const;
+
+    ///<summary>
+    ///Returns true once every inbound byte has been read.
+    ///</summary>
+    bool
+    finished(
+        void
+    ) const;
+
+    ///<summary>
+    ///Returns the time at which the next inbound byte becomes available, or clock::time_point::max() if the replay has finished.
+    ///</summary>
+    clock::time_point
+    nextDue(
+        void
+    ) const;
+
+    ///<summary>
+    ///Copies up to length_ inbound bytes which are due by now_ into buffer_.
+    ///<returns>the number of bytes copied</returns>
+    ///</summary>
+    size_t
+    read(
+        uint8_t *buffer_,
+        size_t length_,
+        clock::time_point now_
+    );
+
+    ///<summary>
+    ///Restarts the replay from the beginning of the trace, with timestamps measured from start_.
+    ///</summary>
+    void
+    start(
+        clock::time_point start_
+    );
+
+private:
+    TraceReader _reader;
+    double _speed;
+    clock::time_point _start;
+
+    //the inbound record being replayed and how much of it has been read
+    ProtocolTrace::Record _record;
+    size_t _offset;
+    bool _finished;
+
+    void
+    advance(
+        void
+    );
+};
+
+} // namespace Firmata
+} // namespace Maker
+} // namespace Microsoft
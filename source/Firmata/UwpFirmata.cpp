@@ -25,13 +25,40 @@
 
 #include "pch.h"
 #include "UwpFirmata.h"
+#include "NativeBuffer.h"
+#include "SevenBitCodec.h"
+#include "StreamTransport.h"
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
+#include <cstring>
 
 using namespace Microsoft::Maker::Serial;
 using namespace Microsoft::Maker::Firmata;
 using namespace std::placeholders;
 
+namespace {
+    //write() collects into a reused buffer and drained frames are gathered into another, this is enough for common messages without growing
+    const size_t INITIAL_FRAME_CAPACITY = 64;
+
+    //one full-speed USB packet; held frames are written as soon as they would fill it
+    const size_t DEFAULT_TRANSMIT_THRESHOLD = 64;
+
+    //long enough to cover the gap between bytes of one message at 115200 baud, so a message in flight is collected without sleeping
+    const int64_t DEFAULT_INPUT_SPIN_MICROS = 200;
+
+    inline
+    void
+    appendValueAsTwo7bitBytes(
+        std::vector<uint8_t> &frame_,
+        uint16_t value_
+        )
+    {
+        frame_.push_back( value_ & 0x7F );
+        frame_.push_back( ( value_ >> 7 ) & 0x7F );
+    }
+}
+
 
 
 
@@ -48,9 +75,31 @@ UwpFirmata::UwpFirmata(
     _firmata_stream(nullptr),
     _connection_ready(ATOMIC_VAR_INIT(false)),
     _input_thread_should_exit(ATOMIC_VAR_INIT(false)),
+    _input_wait_policy(InputWaitPolicy::SPIN_THEN_PARK),
+    _input_spin_micros(DEFAULT_INPUT_SPIN_MICROS),
+    _input_signalled(false),
+    _reactor(nullptr),
+    _reactor_source(nullptr),
+    _rx_buffer(new uint8_t[RECEIVE_BUFFER_SIZE]),
+    _sysex_delivery_mode(SysexDeliveryMode::COPY),
+    _view_buffer(nullptr),
+    _tx_ring(new OutboundRing(TRANSMIT_RING_SIZE)),
+    _tx_draining(ATOMIC_VAR_INIT(false)),
+    _tx_latency_micros(0),
+    _tx_flush_threshold(DEFAULT_TRANSMIT_THRESHOLD),
+    _tx_deadline_armed(ATOMIC_VAR_INIT(false)),
+    _tx_thread_should_exit(ATOMIC_VAR_INIT(false)),
+    _trace_transport(nullptr),
     firmwareVersionMajor(0),
     firmwareVersionMinor(0)
 {
+    _view_buffer_handle = NativeBuffer::create( &_view_buffer );
+    _sysex_view_args = ref new SysexCallbackEventArgs( 0, _view_buffer_handle );
+    _i2c_view_args = ref new I2cCallbackEventArgs( 0, 0, _view_buffer_handle );
+
+    _tx_buffer.reserve( INITIAL_FRAME_CAPACITY );
+    _tx_queue.reserve( INITIAL_FRAME_CAPACITY );
+    _parser.setMessageTimeout( std::chrono::duration_cast<FirmataParser::clock::duration>( std::chrono::duration<double, std::milli>( MESSAGE_TIMEOUT_MILLIS ) ) );
 }
 
 
@@ -87,21 +136,27 @@ UwpFirmata::begin(
     if( s_ == nullptr ) return;
 
     _firmata_stream = s_;
+    _transport.reset( new StreamTransport( s_ ) );
 
     //lock the IStream object to guarantee its state won't change while we check if it is already connected.
     _firmata_stream->lock();
 
     try
     {
+        //a stream which is already connected may still be re-opened after losing its connection, so we always listen for these status changes
+        _firmata_stream->ConnectionEstablished += ref new Microsoft::Maker::Serial::IStreamConnectionCallback( this, &Microsoft::Maker::Firmata::UwpFirmata::onConnectionEstablished );
+        _firmata_stream->ConnectionFailed += ref new Microsoft::Maker::Serial::IStreamConnectionCallbackWithMessage( this, &Microsoft::Maker::Firmata::UwpFirmata::onConnectionFailed );
+
         if( _firmata_stream->connectionReady() )
         {
             onConnectionEstablished();
         }
-        else
+
+        //streams which can tell us when data arrives let the input thread sleep while the connection is idle
+        INotifyDataReceived ^notifier = dynamic_cast<INotifyDataReceived ^>( _firmata_stream );
+        if( notifier != nullptr )
         {
-            //we only care about these status changes if the connection is not already established
-            _firmata_stream->ConnectionEstablished += ref new Microsoft::Maker::Serial::IStreamConnectionCallback( this, &Microsoft::Maker::Firmata::UwpFirmata::onConnectionEstablished );
-            _firmata_stream->ConnectionFailed += ref new Microsoft::Maker::Serial::IStreamConnectionCallbackWithMessage( this, &Microsoft::Maker::Firmata::UwpFirmata::onConnectionFailed );
+            notifier->DataReceived += ref new StreamDataReceivedCallback( this, &Microsoft::Maker::Firmata::UwpFirmata::notifyDataAvailable );
         }
 
         //we always care about the connection being lost
@@ -128,9 +183,26 @@ UwpFirmata::finish(
     void
     )
 {
+    //the transmit thread drains the ring, so it is stopped before the transport is torn down
+    stopTransmitThread();
+
     {   //critical section
-        std::lock_guard<std::mutex> lock( _firmutex );
+        std::lock_guard<TimedMutex<std::mutex>> lock( _firmutex );
         stopThreads();
+        _reactor = nullptr;
+
+        //send anything still held back by the transmit policy before the transport is released
+        try
+        {
+            drainTransmitRing( true );
+        }
+        catch( Platform::Exception ^e )
+        {
+            OutputDebugString( e->Message->Begin() );
+        }
+
+        //take the writer role so no sender can be using the transport while it is released
+        while( _tx_draining.exchange( true ) ) { std::this_thread::yield(); }
 
         _connection_ready = false;
         _firmata_stream = nullptr;
@@ -142,7 +214,17 @@ UwpFirmata::finish(
             _firmata_stream->end();
         }
         _firmata_stream = nullptr;
+        _trace_transport = nullptr;
+        _transport.reset();
+        _tx_buffer.clear();
+        _tx_deadline_armed = false;
+        _tx_draining = false;
     }
+
+    //the dispatcher threads may be blocked on _firmutex inside an event handler, so they are stopped outside of it. Unlike
+    //stopEventDispatcher() this may run inside a handler, even from the destructor, so it never throws: a dispatcher thread calling
+    //it is detached rather than joined and exits once its handler returns
+    MessageDispatcher::destroy( std::move( _dispatcher ) );
 }
 
 void
@@ -150,7 +232,50 @@ UwpFirmata::flush(
     void
     )
 {
-    return _firmata_stream->flush();
+    //hand everything collected by write() to the transport as a single frame, behind any frames held back by the transmit policy
+    if( !_tx_buffer.empty() )
+    {
+        //a frame which could not be sent is dropped, so it is never prepended to the next message
+        try
+        {
+            sendFrame( _tx_buffer.data(), _tx_buffer.size() );
+        }
+        catch( ... )
+        {
+            _tx_buffer.clear();
+            throw;
+        }
+
+        _tx_buffer.clear();
+    }
+
+    //wait for any thread already writing, so everything committed so far has reached the transport when this returns
+    drainTransmitRing( true );
+}
+
+DispatchStatistics ^
+UwpFirmata::getDispatchStatistics(
+    void
+    )
+{
+    if( !_dispatcher ) return nullptr;
+    return ref new DispatchStatistics( _dispatcher->statistics() );
+}
+
+FirmataMetrics ^
+UwpFirmata::getMetrics(
+    void
+    )
+{
+    std::unique_ptr<ConnectionMetrics::Snapshot> snapshot( new ConnectionMetrics::Snapshot() );
+    _metrics.snapshot( *snapshot );
+
+    TimedMutex<std::mutex>::Statistics lock_statistics = _firmutex.statistics();
+    snapshot->lock_acquisitions = lock_statistics.acquisitions;
+    snapshot->lock_contentions = lock_statistics.contentions;
+    snapshot->lock_wait_ns = lock_statistics.wait_ns;
+
+    return ref new FirmataMetrics( *snapshot );
 }
 
 void
@@ -166,11 +291,13 @@ UwpFirmata::printVersion(
     void
     )
 {
-    std::lock_guard<std::mutex> lock(_firmutex);
-    _firmata_stream->write( static_cast<uint8_t>( Command::PROTOCOL_VERSION ) );
-    _firmata_stream->write( FIRMATA_PROTOCOL_MAJOR_VERSION );
-    _firmata_stream->write( FIRMATA_PROTOCOL_MINOR_VERSION );
-    _firmata_stream->flush();
+    const uint8_t frame[] = {
+        static_cast<uint8_t>( Command::PROTOCOL_VERSION ),
+        FIRMATA_PROTOCOL_MAJOR_VERSION,
+        FIRMATA_PROTOCOL_MINOR_VERSION,
+    };
+
+    sendFrame( frame, sizeof( frame ) );
 }
 
 void
@@ -178,206 +305,95 @@ UwpFirmata::printFirmwareVersion(
     void
     )
 {
-    std::lock_guard<std::mutex> lock(_firmutex);
+    //the lock only protects the name and version from setFirmwareNameAndVersion
+    std::lock_guard<TimedMutex<std::mutex>> lock( _firmutex );
     if( firmwareName )
     {
-        _firmata_stream->write( static_cast<uint8_t>( Command::START_SYSEX ) );
-        _firmata_stream->write( static_cast<uint8_t>( SysexCommand::REPORT_FIRMWARE ) );
-        _firmata_stream->write( firmwareVersionMajor );
-        _firmata_stream->write( firmwareVersionMinor );
+        size_t length = firmwareName->length() * 2 + 5;
+        uint8_t *frame = beginFrame( length );
 
-        for( size_t i = 0; i < firmwareName->length(); ++i )
-        {
-            sendValueAsTwo7bitBytes( firmwareName->at( i ) );
-        }
+        frame[0] = static_cast<uint8_t>( Command::START_SYSEX );
+        frame[1] = static_cast<uint8_t>( SysexCommand::REPORT_FIRMWARE );
+        frame[2] = firmwareVersionMajor;
+        frame[3] = firmwareVersionMinor;
+        SevenBitCodec::encode( reinterpret_cast<const uint8_t *>( firmwareName->data() ), firmwareName->length(), frame + 4 );
+        frame[length - 1] = static_cast<uint8_t>( Command::END_SYSEX );
 
-        _firmata_stream->write( static_cast<uint8_t>( Command::END_SYSEX ) );
-        _firmata_stream->flush();
+        endFrame( frame, length );
     }
 }
 
 void
-UwpFirmata::processInput(
+UwpFirmata::notifyDataAvailable(
     void
     )
 {
-    uint16_t data = _firmata_stream->read();
-    if( data == static_cast<uint16_t>( -1 ) ) return;
-    
-    uint8_t byte = data & 0x00FF;
-    uint8_t upper_nibble = data & 0xF0;
-    uint8_t lower_nibble = data & 0x0F;
-
-    /*
-     * the relevant bits in the command depends on the value of the data byte. If it is less than 0xF0 (start sysex), only the upper nibble identifies the command
-     * while the lower nibble contains additional data
-     */
-    Command command = static_cast<Command>( ( data < static_cast<uint16_t>( Command::START_SYSEX ) ? upper_nibble : byte ) );
-
-    //determine the number of bytes remaining in the message
-    size_t bytes_remaining = 0;
-    bool isMessageSysex = false;
-    switch( command )
-    {
-    default: //command not understood
-    case Command::END_SYSEX: //should never happen
-        return;
-
-        //commands that require 2 additional bytes
-    case Command::DIGITAL_MESSAGE:
-    case Command::ANALOG_MESSAGE:
-    case Command::SET_PIN_MODE:
-    case Command::PROTOCOL_VERSION:
-        bytes_remaining = 2;
-        break;
-
-        //commands that require 1 additional byte
-    case Command::REPORT_ANALOG_PIN:
-    case Command::REPORT_DIGITAL_PIN:
-        bytes_remaining = 1;
-        break;
-
-        //commands that do not require additional bytes
-    case Command::SYSTEM_RESET:
-        //do nothing, as there is nothing to reset
-        return;
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _input_wait_mutex );
+        _input_signalled = true;
 
-    case Command::START_SYSEX:
-        //this is a special case with no set number of bytes remaining
-        isMessageSysex = true;
-        break;
+        //the source is only released after it is cleared under this mutex, so it is never notified after being removed
+        if( _reactor_source ) { _reactor->reactor().notify( _reactor_source ); }
     }
 
-    //read the remaining message while keeping track of elapsed time to timeout in case of incomplete message
-    std::vector<uint8_t> message;
-    size_t bytes_read = 0;
-    auto timeout_start = std::chrono::high_resolution_clock::now();
-    while( bytes_remaining || isMessageSysex )
-    {
-        data = _firmata_stream->read();
-
-        //if no data was available, check for timeout
-        if( data == static_cast<uint16_t>( -1 ) )
-        {
-            //get elapsed seconds, given as a double with resolution in nanoseconds
-            std::chrono::duration<double> elapsed_sec = std::chrono::high_resolution_clock::now() - timeout_start;
-
-            const double MILLIS_PER_SECOND = 1000.0;
-            if( ( elapsed_sec.count() * MILLIS_PER_SECOND ) > MESSAGE_TIMEOUT_MILLIS ) return;
-            else continue;
-        }
-
-        timeout_start = std::chrono::high_resolution_clock::now();
-
-        //if we're parsing sysex and we've just read the END_SYSEX command, we're done.
-        if( isMessageSysex && ( data == static_cast<uint16_t>( Command::END_SYSEX ) ) ) break;
+    _input_wait_condition.notify_one();
+}
 
-        message.push_back( static_cast<uint8_t>( data & 0xFF ) );
-        ++bytes_read;
-        --bytes_remaining;
-    }
+void
+UwpFirmata::processInput(
+    void
+    )
+{
+    pollInput();
+}
 
-    //process the message
-    switch( command )
+void
+UwpFirmata::sendAnalog(
+    uint8_t pin_,
+    uint16_t value_
+    )
+{
+    //the compact form only has room for a 4-bit pin number and a 14-bit value
+    if( pin_ > 0x0F || value_ > 0x3FFF )
     {
-        //ignore these message types
-    default:
-    case Command::REPORT_ANALOG_PIN:
-    case Command::REPORT_DIGITAL_PIN:
-    case Command::SET_PIN_MODE:
-    case Command::END_SYSEX:
-    case Command::SYSTEM_RESET:
-    case Command::PROTOCOL_VERSION:
+        sendExtendedAnalog( pin_, value_ );
         return;
-
-    case Command::ANALOG_MESSAGE:
-        //report analog commands store the pin number in the lower nibble of the command byte, the value is split over two 7-bit bytes
-        AnalogValueUpdated( this, ref new CallbackEventArgs( lower_nibble, message.at( 0 ) | ( message.at( 1 ) << 7 ) ) );
-        break;
-
-    case Command::DIGITAL_MESSAGE:
-        //digital messages store the port number in the lower nibble of the command byte, the port value is split over two 7-bit bytes
-        DigitalPortValueUpdated( this, ref new CallbackEventArgs( lower_nibble, message.at( 0 ) | ( message.at( 1 ) << 7 ) ) );
-        break;
-
-    case Command::START_SYSEX:
-        //a sysex message must include at least one extended-command byte
-        if( bytes_read < 1 ) return;
-
-        //retrieve the raw data array & extract the extended-command byte
-        uint8_t *raw_data = message.data();
-        SysexCommand sysCommand = static_cast<SysexCommand>( raw_data[0] );
-        ++raw_data;
-        --bytes_read;
-
-        DataWriter ^writer = ref new DataWriter();
-        switch( sysCommand )
-        {
-        case SysexCommand::STRING_DATA:
-
-            //condense back into 1-byte data
-            reassembleByteString( raw_data, bytes_read );
-
-            StringMessageReceived( this, ref new StringCallbackEventArgs( createStringFromMbs( raw_data, bytes_read / 2 ) ) );
-
-        break;
-
-        case SysexCommand::CAPABILITY_RESPONSE:
-
-            //Firmata does not handle capability responses in the typical way (separating bytes), so we write them directly to the DataWriter
-            for( size_t i = 0; i < bytes_read; ++i )
-            {
-                writer->WriteByte( raw_data[i] );
-            }
-            PinCapabilityResponseReceived( this, ref new SysexCallbackEventArgs( static_cast<uint8_t>( sysCommand ), writer->DetachBuffer() ) );
-
-            break;
-
-        case SysexCommand::I2C_REPLY:
-
-            //condense back into 1-byte data
-            reassembleByteString( raw_data, bytes_read );
-
-            //if we're receiving an I2C reply, the first two bytes in our reply are the address and register
-            for( size_t i = 2; i < bytes_read / 2; ++i )
-            {
-                writer->WriteByte( raw_data[i] );
-            }
-
-            I2cReplyReceived( this, ref new I2cCallbackEventArgs( raw_data[0], raw_data[1], writer->DetachBuffer() ) );
-            break;
-
-        default:
-
-            //we pass the data forward as-is for any other type of sysex command
-            for( size_t i = 0; i < bytes_read; ++i )
-            {
-                writer->WriteByte( raw_data[i] );
-            }
-
-            SysexMessageReceived( this, ref new SysexCallbackEventArgs( static_cast<uint8_t>( sysCommand ), writer->DetachBuffer() ) );
-
-        }
-
-        break;
     }
 
-    //this library does not support digital write, but we need to consume the rest of the message
+    const uint8_t frame[] = {
+        static_cast<uint8_t>( static_cast<uint8_t>( Command::ANALOG_MESSAGE ) | pin_ ),
+        static_cast<uint8_t>( value_ & 0x007F ),
+        static_cast<uint8_t>( ( value_ >> 7 ) & 0x007F ),
+    };
+
+    sendFrame( frame, sizeof( frame ) );
 }
 
+
 void
-UwpFirmata::sendAnalog(
+UwpFirmata::sendExtendedAnalog(
     uint8_t pin_,
-    uint16_t value_
+    uint32_t value_
     )
 {
-    std::lock_guard<std::mutex> lock(_firmutex);
-    _firmata_stream->write( static_cast<uint8_t>( Command::ANALOG_MESSAGE ) | ( pin_ & 0x0F ) );
-    _firmata_stream->write( static_cast<uint8_t>( value_ & 0x007F ) );
-    _firmata_stream->write( static_cast<uint8_t>( ( value_ >> 7 ) & 0x007F ) );
-    _firmata_stream->flush();
-}
+    //START_SYSEX, EXTENDED_ANALOG, pin, up to five 7-bit value bytes and END_SYSEX
+    uint8_t frame[9];
+    size_t length = 0;
+
+    frame[length++] = static_cast<uint8_t>( Command::START_SYSEX );
+    frame[length++] = static_cast<uint8_t>( SysexCommand::EXTENDED_ANALOG );
+    frame[length++] = pin_ & 0x7F;
 
+    //least significant bits first; Firmata expects at least two value bytes
+    do
+    {
+        frame[length++] = value_ & 0x7F;
+        value_ >>= 7;
+    } while( value_ || length < 5 );
+
+    frame[length++] = static_cast<uint8_t>( Command::END_SYSEX );
+    sendFrame( frame, length );
+}
 
 void
 UwpFirmata::sendDigitalPort(
@@ -385,11 +401,13 @@ UwpFirmata::sendDigitalPort(
     uint8_t port_data_
     )
 {
-    std::lock_guard<std::mutex> lock(_firmutex);
-    _firmata_stream->write( static_cast<uint8_t>( Command::DIGITAL_MESSAGE ) | ( port_number_ & 0x0F ) );
-    _firmata_stream->write( port_data_ & 0x007F );
-    _firmata_stream->write( port_data_ >> 7 );
-    _firmata_stream->flush();
+    const uint8_t frame[] = {
+        static_cast<uint8_t>( static_cast<uint8_t>( Command::DIGITAL_MESSAGE ) | ( port_number_ & 0x0F ) ),
+        static_cast<uint8_t>( port_data_ & 0x007F ),
+        static_cast<uint8_t>( port_data_ >> 7 ),
+    };
+
+    sendFrame( frame, sizeof( frame ) );
 }
 
 
@@ -411,20 +429,16 @@ UwpFirmata::sendString(
     std::wstring stringW = string_->ToString()->Begin();
     std::string stringA( stringW.begin(), stringW.end() );
 
-    {   //critical section
-        std::lock_guard<std::mutex> lock( _firmutex );
-
-        _firmata_stream->write( static_cast<uint8_t>( Command::START_SYSEX ) );
-        _firmata_stream->write( command_ & 0x7F );
+    //the string is encoded straight into the outbound ring, no lock is needed as the frame is private until it is committed
+    size_t length = stringA.length() * 2 + 3;
+    uint8_t *frame = beginFrame( length );
 
-        for( size_t i = 0; i < stringA.length(); ++i )
-        {
-            sendValueAsTwo7bitBytes( stringA.at( i ) );
-        }
+    frame[0] = static_cast<uint8_t>( Command::START_SYSEX );
+    frame[1] = command_ & 0x7F;
+    SevenBitCodec::encode( reinterpret_cast<const uint8_t *>( stringA.data() ), stringA.length(), frame + 2 );
+    frame[length - 1] = static_cast<uint8_t>( Command::END_SYSEX );
 
-        _firmata_stream->write( static_cast<uint8_t>( Command::END_SYSEX ) );
-        _firmata_stream->flush();
-    }
+    endFrame( frame, length );
 }
 
 void
@@ -442,20 +456,47 @@ UwpFirmata::sendSysex(
     IBuffer ^buffer_
     )
 {
-    //critical section equivalent to function scope
-    std::lock_guard<std::mutex> lock( _firmutex );
+    unsigned int length = ( buffer_ == nullptr ) ? 0 : buffer_->Length;
 
-    _firmata_stream->write( static_cast<uint8_t>( Command::START_SYSEX ) );
-    _firmata_stream->write( command_ );
+    uint8_t *frame = beginFrame( length + 3 );
+    frame[0] = static_cast<uint8_t>( Command::START_SYSEX );
+    frame[1] = command_;
 
-    DataReader ^reader = DataReader::FromBuffer( buffer_ );
-    while( reader->UnconsumedBufferLength )
+    //copy the whole payload in one call, then clear the MSB of each byte so it is not misinterpreted as a command
+    if( length )
     {
-        _firmata_stream->write( reader->ReadByte() & 0x7F );
+        try
+        {
+            DataReader ^reader = DataReader::FromBuffer( buffer_ );
+            reader->ReadBytes( Platform::ArrayReference<uint8_t>( frame + 2, length ) );
+        }
+        catch( ... )
+        {
+            //a reserved frame must always be released, or the ring would stall behind it
+            abandonFrame( frame );
+            throw;
+        }
+
+        for( size_t i = 2; i < length + 2; ++i )
+        {
+            frame[i] &= 0x7F;
+        }
     }
 
-    _firmata_stream->write( static_cast<uint8_t>( Command::END_SYSEX ) );
-    _firmata_stream->flush();
+    frame[length + 2] = static_cast<uint8_t>( Command::END_SYSEX );
+    endFrame( frame, length + 3 );
+}
+
+void
+UwpFirmata::sendBytesAsTwo7bitBytes(
+    const Platform::Array<uint8_t> ^bytes_
+    )
+{
+    if( bytes_ == nullptr || !bytes_->Length ) return;
+
+    size_t offset = _tx_buffer.size();
+    _tx_buffer.resize( offset + bytes_->Length * 2 );
+    SevenBitCodec::encode( bytes_->Data, bytes_->Length, _tx_buffer.data() + offset );
 }
 
 void
@@ -463,8 +504,47 @@ UwpFirmata::sendValueAsTwo7bitBytes(
     uint16_t value_
     )
 {
-    _firmata_stream->write( value_ & 0x7F );
-    _firmata_stream->write( ( value_ >> 7 ) & 0x7F );
+    appendValueAsTwo7bitBytes( _tx_buffer, value_ );
+}
+
+void
+UwpFirmata::setInputWaitPolicy(
+    InputWaitPolicy policy_,
+    uint32_t spin_micros_
+    )
+{
+    _input_spin_micros = spin_micros_;
+    _input_wait_policy = policy_;
+
+    //a thread parked under the previous policy should pick up the new one immediately
+    notifyDataAvailable();
+}
+
+void
+UwpFirmata::setTransmitPolicy(
+    uint32_t latency_micros_,
+    uint32_t flush_threshold_
+    )
+{
+    _tx_flush_threshold = flush_threshold_ ? flush_threshold_ : DEFAULT_TRANSMIT_THRESHOLD;
+    _tx_latency_micros = latency_micros_;
+
+    //frames held under the previous policy are not held any longer than the new one allows
+    if( !latency_micros_ ) { drainTransmitRing( true ); }
+
+    if( latency_micros_ && !_tx_thread.joinable() )
+    {
+        _tx_thread_should_exit = false;
+        _tx_thread = std::thread( [ this ]() -> void { transmitThread(); } );
+    }
+}
+
+void
+UwpFirmata::setSysexDeliveryMode(
+    SysexDeliveryMode mode_
+    )
+{
+    _sysex_delivery_mode = mode_;
 }
 
 void
@@ -477,7 +557,7 @@ UwpFirmata::setFirmwareNameAndVersion(
     std::wstring nameW = name_->ToString()->Begin();
 
     {   //critical section
-        std::lock_guard<std::mutex> lock( _firmutex );
+        std::lock_guard<TimedMutex<std::mutex>> lock( _firmutex );
         if( firmwareName )
         {
             free( firmwareName );
@@ -489,13 +569,59 @@ UwpFirmata::setFirmwareNameAndVersion(
     }
 }
 
+void
+UwpFirmata::startEventDispatcher(
+    uint32_t thread_count_,
+    uint32_t queue_capacity_
+    )
+{
+    //an event handler would be joining the very thread it is running on
+    if( isServicingThread() ) { throw ref new Platform::Exception( E_ILLEGAL_METHOD_CALL, L"startEventDispatcher() cannot be called from an event handler." ); }
+
+    //the input thread reads _dispatcher without synchronization, so it is paused while the dispatcher is swapped
+    bool was_listening = isListening();
+    stopThreads();
+
+    _dispatcher.reset();
+    _dispatcher.reset( new MessageDispatcher( [ this ]( const FirmataMessage &message_ ) -> void
+    {
+        //as on the input thread, a handler which throws loses its event but not the connection; nothing above a dispatcher thread
+        //could catch it
+        try
+        {
+            dispatchMessage( message_ );
+        }
+        catch( Platform::Exception ^e )
+        {
+            _metrics.recordInputError();
+            OutputDebugString( e->Message->Begin() );
+        }
+        catch( ... )
+        {
+            _metrics.recordInputError();
+        }
+    }, thread_count_, queue_capacity_ ) );
+
+    if( was_listening ) { startListening(); }
+}
+
 void
 UwpFirmata::startListening(
     void
     )
 {
-    //is a thread currently running?
-    if( _input_thread.joinable() ) { return; }
+    //is a thread or reactor currently servicing the connection?
+    if( isListening() ) { return; }
+
+    //a connection paused while attached to a reactor resumes on it
+    if( _reactor != nullptr )
+    {
+        InputReactor::Source *source = _reactor->reactor().add( [ this ]() -> size_t { return pollReactorInput(); } );
+
+        std::lock_guard<std::mutex> lock( _input_wait_mutex );
+        _reactor_source = source;
+        return;
+    }
 
     //prepare communications
     _input_thread_should_exit = false;
@@ -504,6 +630,74 @@ UwpFirmata::startListening(
     _input_thread = std::thread( [ this ]() -> void { inputThread(); } );
 }
 
+void
+UwpFirmata::startListening(
+    FirmataReactor ^reactor_
+    )
+{
+    if( isListening() ) { return; }
+
+    _reactor = reactor_;
+    startListening();
+}
+
+bool
+UwpFirmata::startTrace(
+    String ^path_
+    )
+{
+    if( path_ == nullptr ) return false;
+    if( isServicingThread() ) { throw ref new Platform::Exception( E_ILLEGAL_METHOD_CALL, L"startTrace() cannot be called from an event handler." ); }
+
+    std::unique_ptr<TraceWriter> writer( new TraceWriter() );
+    if( !writer->open( path_->Data() ) ) return false;
+
+    bool started = false;
+    replaceTransport( [ & ]() -> void
+    {
+        if( !_transport || _trace_transport != nullptr ) return;
+
+        _trace_transport = new RecordingTransport( std::move( _transport ), std::move( writer ) );
+        _transport.reset( _trace_transport );
+        started = true;
+    } );
+
+    return started;
+}
+
+void
+UwpFirmata::stopEventDispatcher(
+    void
+    )
+{
+    if( !_dispatcher ) return;
+    if( isServicingThread() ) { throw ref new Platform::Exception( E_ILLEGAL_METHOD_CALL, L"stopEventDispatcher() cannot be called from an event handler." ); }
+
+    bool was_listening = isListening();
+    stopThreads();
+
+    //joins the dispatcher threads, releasing their references to this instance
+    _dispatcher.reset();
+
+    if( was_listening ) { startListening(); }
+}
+
+void
+UwpFirmata::stopTrace(
+    void
+    )
+{
+    if( isServicingThread() ) { throw ref new Platform::Exception( E_ILLEGAL_METHOD_CALL, L"stopTrace() cannot be called from an event handler." ); }
+
+    replaceTransport( [ this ]() -> void
+    {
+        if( _trace_transport == nullptr ) return;
+
+        _transport = _trace_transport->detach();
+        _trace_transport = nullptr;
+    } );
+}
+
 void
 UwpFirmata::unlock(
     void
@@ -517,7 +711,7 @@ UwpFirmata::write(
     uint8_t c_
     )
 {
-    _firmata_stream->write( c_ );
+    _tx_buffer.push_back( c_ );
 }
 
 
@@ -525,6 +719,144 @@ UwpFirmata::write(
 //* Private Methods
 //******************************************************************************
 
+void
+UwpFirmata::abandonFrame(
+    uint8_t *frame_
+    )
+{
+    if( _tx_ring->owns( frame_ ) )
+    {
+        _tx_ring->abandon( frame_ );
+    }
+    else
+    {
+        delete[] frame_;
+    }
+}
+
+uint8_t *
+UwpFirmata::beginFrame(
+    size_t length_
+    )
+{
+    //frames too large for the ring are encoded on the heap and written directly by endFrame
+    if( length_ > _tx_ring->maxFrameLength() ) return new uint8_t[length_];
+
+    uint8_t *frame;
+    while( !( frame = _tx_ring->tryReserve( length_ ) ) )
+    {
+        //the ring is full, help whichever thread is writing instead of waiting on it
+        drainTransmitRing( true );
+        std::this_thread::yield();
+    }
+
+    return frame;
+}
+
+void
+UwpFirmata::drainTransmitRing(
+    bool wait_,
+    const uint8_t *oversized_frame_,
+    size_t oversized_length_
+    )
+{
+    //only one thread writes to the transport at a time; the others leave their frames for it
+    while( _tx_draining.exchange( true ) )
+    {
+        if( !wait_ ) return;
+        std::this_thread::yield();
+    }
+
+    do
+    {
+        try
+        {
+            _tx_deadline_armed = false;
+            _tx_queue.clear();
+            _tx_ring->drain( [ this ]( const uint8_t *frame_, size_t length_ ) -> void { _tx_queue.insert( _tx_queue.end(), frame_, frame_ + length_ ); } );
+
+            if( _transport && ( !_tx_queue.empty() || oversized_frame_ ) )
+            {
+                if( !_tx_queue.empty() ) { _metrics.recordSent( _transport->write( _tx_queue.data(), _tx_queue.size() ) ); }
+                if( oversized_frame_ ) { _metrics.recordSent( _transport->write( oversized_frame_, oversized_length_ ) ); }
+                _transport->flush();
+            }
+            oversized_frame_ = nullptr;
+        }
+        catch( ... )
+        {
+            _tx_draining = false;
+            throw;
+        }
+
+        _tx_draining = false;
+
+        //a frame committed while we were writing saw the flag set and left itself for us
+    } while( _tx_ring->hasCommitted() && !_tx_draining.exchange( true ) );
+}
+
+void
+UwpFirmata::endFrame(
+    uint8_t *frame_,
+    size_t length_
+    )
+{
+    if( !_tx_ring->owns( frame_ ) )
+    {
+        //oversized frames go out immediately, behind everything already committed
+        std::unique_ptr<uint8_t[]> oversized( frame_ );
+        drainTransmitRing( true, oversized.get(), length_ );
+        return;
+    }
+
+    _tx_ring->commit( frame_ );
+
+    int64_t latency_micros = _tx_latency_micros;
+    if( !latency_micros || _tx_ring->pending() >= _tx_flush_threshold )
+    {
+        drainTransmitRing( false );
+    }
+    else if( !_tx_deadline_armed.exchange( true ) )
+    {
+        //the budget runs from the oldest held frame, later frames only ride along
+        {   //critical section
+            std::lock_guard<std::mutex> lock( _tx_mutex );
+            _tx_deadline = std::chrono::steady_clock::now() + std::chrono::microseconds( latency_micros );
+        }
+        _tx_condition.notify_one();
+    }
+}
+
+
+IBuffer ^
+UwpFirmata::copyToBuffer(
+    const uint8_t *data_,
+    size_t length_
+    )
+{
+    DataWriter ^writer = ref new DataWriter();
+    writer->WriteBytes( Platform::ArrayReference<uint8_t>( const_cast<uint8_t *>( data_ ), static_cast<unsigned int>( length_ ) ) );
+    return writer->DetachBuffer();
+}
+
+SysexCallbackEventArgs ^
+UwpFirmata::createSysexEventArgs(
+    uint8_t command_,
+    uint8_t *data_,
+    size_t length_,
+    bool view_
+    )
+{
+    if( !view_ )
+    {
+        return ref new SysexCallbackEventArgs( command_, copyToBuffer( data_, length_ ) );
+    }
+
+    //point the shared buffer at the payload in place, it is re-pointed for the next message once this event has been raised
+    _view_buffer->setView( data_, length_ );
+    _sysex_view_args->setView( command_, _view_buffer_handle );
+    return _sysex_view_args;
+}
 
 String ^
 UwpFirmata::createStringFromMbs(
@@ -540,32 +872,263 @@ UwpFirmata::createStringFromMbs(
     return str;
 }
 
+void
+UwpFirmata::dispatchMessage(
+    const FirmataMessage &message_
+    )
+{
+    //process the message
+    switch( static_cast<Command>( message_.command ) )
+    {
+        //ignore these message types
+    default:
+    case Command::REPORT_ANALOG_PIN:
+    case Command::REPORT_DIGITAL_PIN:
+    case Command::SET_PIN_MODE:
+    case Command::END_SYSEX:
+    case Command::SYSTEM_RESET:
+    case Command::PROTOCOL_VERSION:
+        return;
+
+    case Command::ANALOG_MESSAGE:
+        //report analog commands store the pin number in the lower nibble of the command byte, the value is split over two 7-bit bytes
+        _metrics.recordEvent( ConnectionMetrics::Event::ANALOG_VALUE_UPDATED );
+        AnalogValueUpdated( this, ref new CallbackEventArgs( message_.channel, message_.data[0] | ( message_.data[1] << 7 ) ) );
+        break;
+
+    case Command::DIGITAL_MESSAGE:
+        //digital messages store the port number in the lower nibble of the command byte, the port value is split over two 7-bit bytes
+        _metrics.recordEvent( ConnectionMetrics::Event::DIGITAL_PORT_VALUE_UPDATED );
+        DigitalPortValueUpdated( this, ref new CallbackEventArgs( message_.channel, message_.data[0] | ( message_.data[1] << 7 ) ) );
+        break;
+
+    case Command::START_SYSEX:
+        //the parser has already separated the extended-command byte from the payload
+        uint8_t *raw_data = message_.data;
+        size_t bytes_read = message_.length;
+        SysexCommand sysCommand = static_cast<SysexCommand>( message_.sysex_command );
+        bool deliver_view = ( _sysex_delivery_mode.load() == SysexDeliveryMode::VIEW );
+
+        switch( sysCommand )
+        {
+        case SysexCommand::STRING_DATA:
+
+            //an empty string has nothing to condense
+            if( bytes_read < 2 )
+            {
+                _metrics.recordEvent( ConnectionMetrics::Event::STRING_MESSAGE_RECEIVED );
+                StringMessageReceived( this, ref new StringCallbackEventArgs( L"" ) );
+                break;
+            }
+
+            //condense back into 1-byte data
+            reassembleByteString( raw_data, bytes_read );
+
+            _metrics.recordEvent( ConnectionMetrics::Event::STRING_MESSAGE_RECEIVED );
+            StringMessageReceived( this, ref new StringCallbackEventArgs( createStringFromMbs( raw_data, bytes_read / 2 ) ) );
+
+        break;
+
+        case SysexCommand::CAPABILITY_RESPONSE:
+
+            //Firmata does not handle capability responses in the typical way (separating bytes), so the payload is delivered as-is
+            _metrics.recordEvent( ConnectionMetrics::Event::PIN_CAPABILITY_RESPONSE_RECEIVED );
+            PinCapabilityResponseReceived( this, createSysexEventArgs( static_cast<uint8_t>( sysCommand ), raw_data, bytes_read, deliver_view ) );
+
+            break;
+
+        case SysexCommand::I2C_REPLY:
+
+            //an I2C reply must contain at least the address and register, each sent as two 7-bit bytes
+            if( bytes_read < 4 ) break;
+
+            //condense back into 1-byte data
+            reassembleByteString( raw_data, bytes_read );
+
+            //if we're receiving an I2C reply, the first two bytes in our reply are the address and register
+            _metrics.recordEvent( ConnectionMetrics::Event::I2C_REPLY_RECEIVED );
+            if( deliver_view )
+            {
+                _view_buffer->setView( raw_data + 2, ( bytes_read / 2 ) - 2 );
+                _i2c_view_args->setView( raw_data[0], raw_data[1], _view_buffer_handle );
+                I2cReplyReceived( this, _i2c_view_args );
+            }
+            else
+            {
+                I2cReplyReceived( this, ref new I2cCallbackEventArgs( raw_data[0], raw_data[1], copyToBuffer( raw_data + 2, ( bytes_read / 2 ) - 2 ) ) );
+            }
+            break;
+
+        default:
+
+            //we pass the data forward as-is for any other type of sysex command
+            _metrics.recordEvent( ConnectionMetrics::Event::SYSEX_MESSAGE_RECEIVED );
+            SysexMessageReceived( this, createSysexEventArgs( static_cast<uint8_t>( sysCommand ), raw_data, bytes_read, deliver_view ) );
+
+        }
+
+        break;
+    }
+}
+
 void
 UwpFirmata::inputThread(
     void
     )
 {
+    auto last_data_time = std::chrono::steady_clock::now();
+    std::chrono::microseconds park_timeout = MIN_PARK_MICROS;
+
     //set state-tracking member variables and begin processing input
     while( !_input_thread_should_exit )
     {
+        //a poll which finds data counts as busy time, everything else as idle time
+        auto poll_start = std::chrono::steady_clock::now();
+
         try
         {
-            processInput();
+            if( pollInput() )
+            {
+                last_data_time = std::chrono::steady_clock::now();
+                park_timeout = MIN_PARK_MICROS;
+                _metrics.recordInputBusy( last_data_time - poll_start );
+                continue;
+            }
         }
         catch( Platform::Exception ^e )
         {
+            _metrics.recordInputError();
             OutputDebugString( e->Message->Begin() );
         }
+
+        //the connection is idle, wait according to the current policy
+        switch( _input_wait_policy.load() )
+        {
+        default:
+        case InputWaitPolicy::SPIN:
+            std::this_thread::yield();
+            break;
+
+        case InputWaitPolicy::SPIN_THEN_PARK:
+            if( ( std::chrono::steady_clock::now() - last_data_time ) < std::chrono::microseconds( _input_spin_micros.load() ) )
+            {
+                std::this_thread::yield();
+                break;
+            }
+
+            //sleep for increasing intervals so a stream which never signals still has its data picked up within MAX_PARK_MICROS
+            parkInputThread( park_timeout );
+            park_timeout = ( std::min )( park_timeout * 2, MAX_PARK_MICROS );
+            break;
+
+        case InputWaitPolicy::BLOCKING:
+            parkInputThread( BLOCKING_PARK_MILLIS );
+            break;
+        }
+
+        _metrics.recordInputIdle( std::chrono::steady_clock::now() - poll_start );
     }
 }
 
+bool
+UwpFirmata::isListening(
+    void
+    )
+{
+    //_reactor_source is only written by the thread controlling the connection, so it may be read here without the lock
+    return _input_thread.joinable() || _reactor_source != nullptr;
+}
+
+bool
+UwpFirmata::isServicingThread(
+    void
+    )
+{
+    //events are raised on the input thread or the reactor thread polling this connection, or on the dispatcher threads once
+    //startEventDispatcher() has been called
+    if( _input_thread.get_id() == std::this_thread::get_id() ) return true;
+    if( _dispatcher && _dispatcher->isDispatcherThread() ) return true;
+
+    std::lock_guard<std::mutex> lock( _input_wait_mutex );
+    return _reactor_source && _reactor->reactor().isPolling( _reactor_source );
+}
+
+void
+UwpFirmata::parkInputThread(
+    std::chrono::microseconds timeout_
+    )
+{
+    std::unique_lock<std::mutex> lock( _input_wait_mutex );
+
+    //the flag is set under the mutex, so data signalled between the last poll and this wait is never missed
+    _input_wait_condition.wait_for( lock, timeout_, [ this ]() -> bool { return _input_signalled || _input_thread_should_exit; } );
+    _input_signalled = false;
+}
+
+size_t
+UwpFirmata::pollInput(
+    void
+    )
+{
+    uint8_t *buffer = _rx_buffer.get();
+
+    //drain whatever the transport has ready without waiting for the rest of a message; the parser keeps partial state between calls
+    size_t length = _transport->read( buffer, RECEIVE_BUFFER_SIZE );
+
+    auto now = FirmataParser::clock::now();
+    if( !length )
+    {
+        //no data was available, discard any partial message which has timed out
+        if( _parser.expire( now ) ) { _metrics.recordParserTotals( _parser ); }
+        return 0;
+    }
+
+    _metrics.recordReceived( length );
+
+    MessageDispatcher *dispatcher = _dispatcher.get();
+    if( dispatcher )
+    {
+        //messages are copied into the dispatcher's queues, so views handed to subscribers point there rather than at _rx_buffer
+        _parser.feed( buffer, length, now, [ this, dispatcher ]( const FirmataMessage &message_ ) -> void { _metrics.recordMessage( message_ ); dispatcher->post( message_, &_input_thread_should_exit ); } );
+    }
+    else
+    {
+        _parser.feed( buffer, length, now, [ this ]( const FirmataMessage &message_ ) -> void { _metrics.recordMessage( message_ ); dispatchMessage( message_ ); } );
+    }
+
+    _metrics.recordParserTotals( _parser );
+    return length;
+}
+
+size_t
+UwpFirmata::pollReactorInput(
+    void
+    )
+{
+    auto poll_start = std::chrono::steady_clock::now();
+
+    try
+    {
+        size_t length = pollInput();
+        if( length ) { _metrics.recordInputBusy( std::chrono::steady_clock::now() - poll_start ); }
+        return length;
+    }
+    catch( Platform::Exception ^e )
+    {
+        _metrics.recordInputError();
+        OutputDebugString( e->Message->Begin() );
+    }
+
+    return 0;
+}
+
 void
 UwpFirmata::onConnectionEstablished(
     void
     )
 {
     {   //critical section guarantees state is only changed when it is not being modified elsewhere
-        std::lock_guard<std::mutex> lock( _firmutex );
+        std::lock_guard<TimedMutex<std::mutex>> lock( _firmutex );
         _connection_ready = true;
     }
 
@@ -596,20 +1159,103 @@ UwpFirmata::reassembleByteString(
     )
 {
     //each char must be reassembled from the two 7-bit bytes received, therefore length should always be an even number.
-    size_t i;
-    for( i = 0; i < length_ / 2; ++i )
-    {
-        byte_string_[i] = byte_string_[i * 2 + 0] | ( byte_string_[i * 2 + 1] << 7 );
-    }
+    size_t i = SevenBitCodec::decode( byte_string_, length_, byte_string_ );
     byte_string_[i] = 0;
 }
 
+void
+UwpFirmata::sendFrame(
+    const uint8_t *frame_,
+    size_t length_
+    )
+{
+    uint8_t *frame = beginFrame( length_ );
+    std::memcpy( frame, frame_, length_ );
+    endFrame( frame, length_ );
+}
+
+void
+UwpFirmata::replaceTransport(
+    std::function<void( void )> replace_
+    )
+{
+    //the input thread reads from the transport and the thread holding _tx_draining writes to it, so both are excluded while it is swapped
+    bool was_listening = isListening();
+    stopThreads();
+    while( _tx_draining.exchange( true ) ) { std::this_thread::yield(); }
+
+    replace_();
+
+    _tx_draining = false;
+    if( was_listening ) { startListening(); }
+}
+
 void
 UwpFirmata::stopThreads(
     void
     )
 {
+    //the flag also releases a poll waiting for room in the dispatcher's sysex lane, whose handler may be waiting on our caller, so it
+    //stays set until the reactor has been left as well
     _input_thread_should_exit = true;
+    notifyDataAvailable();
     if( _input_thread.joinable() ) { _input_thread.join(); }
+
+    //detach from the reactor; remove() waits for a poll in progress on another thread to return
+    InputReactor::Source *source = nullptr;
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _input_wait_mutex );
+        source = _reactor_source;
+        _reactor_source = nullptr;
+    }
+
+    if( source ) { _reactor->reactor().remove( source ); }
     _input_thread_should_exit = false;
 }
+
+void
+UwpFirmata::stopTransmitThread(
+    void
+    )
+{
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _tx_mutex );
+        _tx_thread_should_exit = true;
+        _tx_condition.notify_one();
+    }
+
+    if( _tx_thread.joinable() ) { _tx_thread.join(); }
+    _tx_thread_should_exit = false;
+}
+
+void
+UwpFirmata::transmitThread(
+    void
+    )
+{
+    std::unique_lock<std::mutex> lock( _tx_mutex );
+
+    while( !_tx_thread_should_exit )
+    {
+        if( !_tx_deadline_armed )
+        {
+            _tx_condition.wait( lock );
+            continue;
+        }
+
+        //the deadline may be cleared by a drain while we wait, so it is re-checked on every wake
+        _tx_condition.wait_until( lock, _tx_deadline );
+        if( !_tx_deadline_armed || _tx_thread_should_exit || std::chrono::steady_clock::now() < _tx_deadline ) continue;
+
+        lock.unlock();
+        try
+        {
+            drainTransmitRing( true );
+        }
+        catch( Platform::Exception ^e )
+        {
+            OutputDebugString( e->Message->Begin() );
+        }
+        lock.lock();
+    }
+}
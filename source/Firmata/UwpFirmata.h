@@ -25,10 +25,23 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
+#include "ConnectionMetrics.h"
+#include "FirmataParser.h"
+#include "FirmataTransport.h"
+#include "InputReactor.h"
+#include "MessageDispatcher.h"
+#include "OutboundRing.h"
+#include "RecordingTransport.h"
+#include "TimedMutex.h"
 
 using namespace Platform;
 using namespace Concurrency;
@@ -39,6 +52,24 @@ namespace Maker {
 namespace Firmata {
 
 ref class UwpFirmata;
+class NativeBuffer;
+
+//returns a copy of the given buffer which does not share memory with it
+inline
+IBuffer ^
+copyBuffer(
+    IBuffer ^buffer_
+)
+{
+    if( buffer_ == nullptr ) return nullptr;
+
+    auto bytes = ref new Platform::Array<uint8_t>( buffer_->Length );
+    DataReader::FromBuffer( buffer_ )->ReadBytes( bytes );
+
+    DataWriter ^writer = ref new DataWriter();
+    writer->WriteBytes( bytes );
+    return writer->DetachBuffer();
+}
 
 public ref class CallbackEventArgs sealed
 {
@@ -83,17 +114,42 @@ public:
         IBuffer ^sysex_string_
         ) :
         _command( command_ ),
-        _sysex_string( sysex_string_ )
+        _sysex_string( sysex_string_ ),
+        _is_view( false )
     {
     }
 
     inline uint8_t getCommand( void ) { return _command; }
 
+    ///<summary>
+    ///Returns the message payload. If the message was delivered with SysexDeliveryMode.VIEW, the buffer refers to the receive buffer of
+    ///the connection and is only valid until the event handler returns; use retainDataBuffer() to keep the payload beyond that point.
+    ///</summary>
     inline IBuffer ^ getDataBuffer( void ) { return _sysex_string; }
 
+    ///<summary>
+    ///Returns a buffer holding the message payload which remains valid after the event handler returns.
+    ///</summary>
+    inline IBuffer ^ retainDataBuffer( void ) { return _is_view ? copyBuffer( _sysex_string ) : _sysex_string; }
+
+internal:
+    //re-targets a reused instance at the next message, see SysexDeliveryMode.VIEW
+    inline
+    void
+    setView(
+        uint8_t command_,
+        IBuffer ^sysex_string_
+    )
+    {
+        _command = command_;
+        _sysex_string = sysex_string_;
+        _is_view = true;
+    }
+
 private:
     uint8_t _command;
     IBuffer ^_sysex_string;
+    bool _is_view;
 };
 
 public ref class I2cCallbackEventArgs sealed
@@ -106,7 +162,8 @@ public:
         ) :
         _address( address_ ),
         _reg( reg_ ),
-        _response( response_ )
+        _response( response_ ),
+        _is_view( false )
     {
     }
 
@@ -114,12 +171,126 @@ public:
 
     inline uint8_t getRegister( void ) { return _reg; }
 
+    ///<summary>
+    ///Returns the reply payload. If the reply was delivered with SysexDeliveryMode.VIEW, the buffer refers to the receive buffer of
+    ///the connection and is only valid until the event handler returns; use retainDataBuffer() to keep the payload beyond that point.
+    ///</summary>
     inline IBuffer ^ getDataBuffer( void ) { return _response; }
 
+    ///<summary>
+    ///Returns a buffer holding the reply payload which remains valid after the event handler returns.
+    ///</summary>
+    inline IBuffer ^ retainDataBuffer( void ) { return _is_view ? copyBuffer( _response ) : _response; }
+
+internal:
+    //re-targets a reused instance at the next reply, see SysexDeliveryMode.VIEW
+    inline
+    void
+    setView(
+        uint8_t address_,
+        uint8_t reg_,
+        IBuffer ^response_
+    )
+    {
+        _address = address_;
+        _reg = reg_;
+        _response = response_;
+        _is_view = true;
+    }
+
 private:
     uint8_t _address;
     uint8_t _reg;
     IBuffer ^_response;
+    bool _is_view;
+};
+
+///<summary>
+///A snapshot of the counters kept by the event dispatcher, see UwpFirmata::startEventDispatcher().
+///</summary>
+public ref class DispatchStatistics sealed
+{
+public:
+    //messages handed to the dispatcher threads
+    property uint64_t MessagesPosted { uint64_t get() { return _statistics.messages_posted; } }
+
+    //messages whose events have been raised
+    property uint64_t MessagesDispatched { uint64_t get() { return _statistics.messages_dispatched; } }
+
+    //messages discarded because their queue was full
+    property uint64_t MessagesDropped { uint64_t get() { return _statistics.messages_dropped; } }
+
+    //messages waiting to be dispatched when the snapshot was taken
+    property uint32_t QueueDepth { uint32_t get() { return static_cast<uint32_t>( _statistics.queue_depth ); } }
+
+    //the largest number of messages seen waiting in one queue
+    property uint32_t MaxQueueDepth { uint32_t get() { return static_cast<uint32_t>( _statistics.max_queue_depth ); } }
+
+    //time between a message being parsed and its event being raised, for the most recent message and the worst seen
+    property uint64_t LastLagMicroseconds { uint64_t get() { return toMicroseconds( _statistics.last_lag ); } }
+    property uint64_t MaxLagMicroseconds { uint64_t get() { return toMicroseconds( _statistics.max_lag ); } }
+
+internal:
+    DispatchStatistics(
+        const MessageDispatcher::Statistics &statistics_
+    ) :
+        _statistics( statistics_ )
+    {
+    }
+
+private:
+    MessageDispatcher::Statistics _statistics;
+
+    static
+    uint64_t
+    toMicroseconds(
+        MessageDispatcher::clock::duration duration_
+    )
+    {
+        return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::microseconds>( duration_ ).count() );
+    }
+};
+
+///<summary>
+///A fixed pool of threads reading and parsing input for many connections, see UwpFirmata::startListening( FirmataReactor ).
+///</summary>
+public ref class FirmataReactor sealed
+{
+public:
+    ///<summary>
+    ///Starts thread_count_ input threads. Connections whose stream does not signal incoming data are polled every sweep_micros_.
+    ///</summary>
+    FirmataReactor(
+        uint32_t thread_count_,
+        uint32_t sweep_micros_
+    ) :
+        _reactor( new InputReactor( thread_count_, std::chrono::microseconds( sweep_micros_ ? sweep_micros_ : static_cast<uint32_t>( DEFAULT_SWEEP_MICROS ) ) ) )
+    {
+    }
+
+    //threads servicing the connections
+    property uint32_t ThreadCount { uint32_t get() { return static_cast<uint32_t>( _reactor->statistics().thread_count ); } }
+
+    //connections currently listening on this reactor
+    property uint32_t ConnectionCount { uint32_t get() { return static_cast<uint32_t>( _reactor->statistics().source_count ); } }
+
+    //polls made and bytes read across all connections
+    property uint64_t Polls { uint64_t get() { return _reactor->statistics().polls; } }
+    property uint64_t BytesRead { uint64_t get() { return _reactor->statistics().bytes; } }
+
+internal:
+    InputReactor &
+    reactor(
+        void
+    )
+    {
+        return *_reactor;
+    }
+
+private:
+    static const uint32_t DEFAULT_SWEEP_MICROS = 1000;
+
+    std::unique_ptr<InputReactor> _reactor;
 };
 
 public ref class SystemResetCallbackEventArgs sealed {
@@ -165,6 +336,172 @@ public enum class SysexCommand {
 };
 
 
+///<summary>
+///A snapshot of the counters UwpFirmata keeps for its connection. Counters only ever increase; rates are found by comparing two
+///snapshots taken some time apart.
+///</summary>
+public ref class FirmataMetrics sealed
+{
+public:
+    property uint64_t BytesReceived { uint64_t get() { return _snapshot.bytes_received; } }
+    property uint64_t MessagesReceived { uint64_t get() { return _snapshot.messages_received; } }
+
+    //bytes which did not belong to any message, partial messages discarded by the message timeout and partial messages cut short
+    //by the start of another message
+    property uint64_t UnknownBytesSkipped { uint64_t get() { return _snapshot.unknown_bytes_skipped; } }
+    property uint64_t MessagesTimedOut { uint64_t get() { return _snapshot.messages_timed_out; } }
+    property uint64_t MessagesAborted { uint64_t get() { return _snapshot.messages_aborted; } }
+
+    //time the input thread spent reading and dispatching, time it spent polling an idle connection or waiting, and exceptions it caught
+    property uint64_t InputBusyMicroseconds { uint64_t get() { return _snapshot.input_busy_ns / 1000; } }
+    property uint64_t InputIdleMicroseconds { uint64_t get() { return _snapshot.input_idle_ns / 1000; } }
+    property uint64_t InputErrors { uint64_t get() { return _snapshot.input_errors; } }
+
+    //bytes handed to the transport and the number of writes they took
+    property uint64_t BytesSent { uint64_t get() { return _snapshot.bytes_sent; } }
+    property uint64_t Writes { uint64_t get() { return _snapshot.writes; } }
+
+    //use of the lock taken by lock() and unlock()
+    property uint64_t LockAcquisitions { uint64_t get() { return _snapshot.lock_acquisitions; } }
+    property uint64_t LockContentions { uint64_t get() { return _snapshot.lock_contentions; } }
+    property uint64_t LockWaitMicroseconds { uint64_t get() { return _snapshot.lock_wait_ns / 1000; } }
+
+    //events raised for received messages
+    property uint64_t AnalogValueEvents { uint64_t get() { return eventCount( ConnectionMetrics::Event::ANALOG_VALUE_UPDATED ); } }
+    property uint64_t DigitalPortValueEvents { uint64_t get() { return eventCount( ConnectionMetrics::Event::DIGITAL_PORT_VALUE_UPDATED ); } }
+    property uint64_t StringMessageEvents { uint64_t get() { return eventCount( ConnectionMetrics::Event::STRING_MESSAGE_RECEIVED ); } }
+    property uint64_t SysexMessageEvents { uint64_t get() { return eventCount( ConnectionMetrics::Event::SYSEX_MESSAGE_RECEIVED ); } }
+    property uint64_t PinCapabilityResponseEvents { uint64_t get() { return eventCount( ConnectionMetrics::Event::PIN_CAPABILITY_RESPONSE_RECEIVED ); } }
+    property uint64_t I2cReplyEvents { uint64_t get() { return eventCount( ConnectionMetrics::Event::I2C_REPLY_RECEIVED ); } }
+
+    ///<summary>
+    ///Returns the number of messages received with the given command. Channel messages are counted without their channel, so every
+    ///analog report is counted under Command.ANALOG_MESSAGE.
+    ///</summary>
+    uint64_t
+    getMessageCount(
+        Command command_
+    )
+    {
+        return _snapshot.messages_by_command[static_cast<uint8_t>( command_ )];
+    }
+
+    ///<summary>
+    ///Returns the number of sysex messages received with the given command byte.
+    ///</summary>
+    uint64_t
+    getSysexMessageCount(
+        uint8_t command_
+    )
+    {
+        return _snapshot.messages_by_sysex_command[command_ & 0x7F];
+    }
+
+    ///<summary>
+    ///Formats every counter as a line of text.
+    ///</summary>
+    Platform::String ^
+    toText(
+        void
+    )
+    {
+        return toString( _snapshot.toText() );
+    }
+
+    ///<summary>
+    ///Formats every counter as a JSON object, for collection by monitoring tools.
+    ///</summary>
+    Platform::String ^
+    toJson(
+        void
+    )
+    {
+        return toString( _snapshot.toJson() );
+    }
+
+internal:
+    FirmataMetrics(
+        const ConnectionMetrics::Snapshot &snapshot_
+    ) :
+        _snapshot( snapshot_ )
+    {
+    }
+
+private:
+    ConnectionMetrics::Snapshot _snapshot;
+
+    uint64_t
+    eventCount(
+        ConnectionMetrics::Event event_
+    )
+    {
+        return _snapshot.events_raised[static_cast<size_t>( event_ )];
+    }
+
+    static
+    Platform::String ^
+    toString(
+        const std::string &text_
+    )
+    {
+        std::wstring wide( text_.begin(), text_.end() );
+        return ref new Platform::String( wide.c_str(), static_cast<unsigned int>( wide.size() ) );
+    }
+};
+
+
+///<summary>
+///An optional interface which a Serial::IStream implementation may also implement to let UwpFirmata read many bytes in a single call
+///instead of calling IStream::read() once per byte.
+///</summary>
+public interface class IBulkStream
+{
+    ///<summary>
+    ///Reads up to buffer_->Length bytes into the given buffer without waiting for more data to arrive.
+    ///<returns>the number of bytes read, which is zero if no data was available</returns>
+    ///</summary>
+    uint32_t
+    readBytes(
+        Platform::WriteOnlyArray<uint8_t> ^buffer_
+    );
+};
+
+
+public delegate void StreamDataReceivedCallback();
+
+///<summary>
+///An optional interface which a Serial::IStream implementation may also implement to tell UwpFirmata when new data has arrived.
+///<para>Streams which raise this event allow an idle input thread to sleep until data arrives instead of polling the stream.</para>
+///</summary>
+public interface class INotifyDataReceived
+{
+    event StreamDataReceivedCallback ^ DataReceived;
+};
+
+///<summary>
+///Determines how sysex, capability and I2C reply payloads are handed to event subscribers.
+///</summary>
+public enum class SysexDeliveryMode {
+    //each event receives its own event arguments and a copy of the payload which it may keep indefinitely
+    COPY,
+    //event arguments and the payload buffer are reused for every message and refer directly to the receive buffer of the connection.
+    //They are only valid until the event handler returns; call retainDataBuffer() on the event arguments to keep a payload.
+    VIEW,
+};
+
+///<summary>
+///Determines what the input thread does while the connection is idle.
+///</summary>
+public enum class InputWaitPolicy {
+    //poll the stream continuously; lowest latency, but each connection occupies a full core
+    SPIN,
+    //poll for a short period after the last byte received, then sleep until data is signalled or a short timeout elapses
+    SPIN_THEN_PARK,
+    //sleep until data is signalled through notifyDataAvailable() or INotifyDataReceived
+    BLOCKING,
+};
+
+
 public delegate void CallbackFunction( UwpFirmata ^caller, CallbackEventArgs ^argv );
 public delegate void StringCallbackFunction(UwpFirmata ^caller, StringCallbackEventArgs ^argv);
 public delegate void SysexCallbackFunction(UwpFirmata ^caller, SysexCallbackEventArgs ^argv);
@@ -222,6 +559,8 @@ public:
 
     ///<summary>
     ///Finishes the usage of this UwpFirmata instance. Any existing connections will be closed.
+    ///<para>May be called from an event handler raised by the event dispatcher; the dispatcher thread running it exits once the
+    ///handler returns.</para>
     ///</summary>
     void
     finish(
@@ -231,15 +570,35 @@ public:
     ///<summary>
     ///Flushes any awaiting data from the outbound queue. This function must be called before any data
     ///is sent across an active connection
+    ///<para>Bytes given to write() are collected and handed to the transport as a single frame by this function, together with any
+    ///messages held back by setTransmitPolicy().</para>
     ///</summary>
     void
     flush(
         void
     );
 
+    ///<summary>
+    ///Returns the counters kept by the event dispatcher, or nullptr if events are raised on the input thread.
+    ///</summary>
+    DispatchStatistics ^
+    getDispatchStatistics(
+        void
+    );
+
+    ///<summary>
+    ///Returns the traffic, parsing, locking and input thread counters for this connection.
+    ///</summary>
+    FirmataMetrics ^
+    getMetrics(
+        void
+    );
+
     ///<summary>
     ///Locks this instance of the UwpFirmata object, allowing for thread safety and guaranteeing that messages do not interfere with each other.
     ///<para>when explicitly invoking this method, unlock() must be called when the lock is no longer needed.</para>
+    ///<para>The lock serializes sequences built with write() and flush(); each such sequence is sent as a single frame, so messages
+    ///sent concurrently through the send functions, which do not take the lock, can never be interleaved with it.</para>
     ///</summary>
     void
     lock(
@@ -254,6 +613,16 @@ public:
         void
     );
 
+    ///<summary>
+    ///Wakes the input thread if it is waiting for data.
+    ///<para>Call this function when the underlying transport receives data if the stream does not implement INotifyDataReceived
+    ///and the input wait policy is anything other than InputWaitPolicy.SPIN.</para>
+    ///</summary>
+    void
+    notifyDataAvailable(
+        void
+    );
+
     ///<summary>
     ///Prints the Firmata version.
     ///</summary>
@@ -263,8 +632,8 @@ public:
     );
 
     ///<summary>
-    ///Allows one byte to be read from an active connection and messages to be parsed. This function will need to be called multiple times
-    ///before a single multi-byte message can be completed and the appropriate action taken.
+    ///Reads the bytes currently available from an active connection and feeds them to the message parser, raising the appropriate event for
+    ///each message completed. Partial messages are retained between calls, so this function never waits for the remainder of a message.
     ///</summary>
     void
     processInput(
@@ -273,6 +642,8 @@ public:
 
     ///<summary>
     ///Sends an analog value for a given pin across an active connection
+    ///<para>Pins 0-15 with values below 16384 are sent as a compact ANALOG_MESSAGE; any other pin or value is sent with
+    ///sendExtendedAnalog.</para>
     ///</summary>
     void
     sendAnalog(
@@ -280,6 +651,16 @@ public:
         uint16_t value
     );
 
+    ///<summary>
+    ///Sends an analog value for a given pin using the EXTENDED_ANALOG sysex command, which addresses pins 0-127 and carries values
+    ///of any width, seven bits per byte.
+    ///</summary>
+    void
+    sendExtendedAnalog(
+        uint8_t pin_,
+        uint32_t value_
+    );
+
     ///<summary>
     ///Sends an digital value for a given port across an active connection
     ///</summary>
@@ -329,6 +710,15 @@ public:
         IBuffer ^buffer_
     );
 
+    ///<summary>
+    ///Sends each of the given bytes as two seven-bit bytes, as used by STRING_DATA and I2C_REQUEST payloads
+    ///<para>The encoded bytes are held in the outbound queue until flush() is called, like those given to write().</para>
+    ///</summary>
+    void
+    sendBytesAsTwo7bitBytes(
+        const Platform::Array<uint8_t> ^bytes_
+    );
+
     ///<summary>
     ///Sends a given byte value as two seven-bit bytes
     ///</summary>
@@ -337,6 +727,39 @@ public:
         uint16_t value_
     );
 
+    ///<summary>
+    ///Sets the behavior of the input thread while the connection is idle.
+    ///<para>With InputWaitPolicy.SPIN_THEN_PARK, the input thread polls for spin_micros_ microseconds after the last byte received before
+    ///it begins to sleep. The default policy is SPIN_THEN_PARK with a 200 microsecond spin.</para>
+    ///</summary>
+    void
+    setInputWaitPolicy(
+        InputWaitPolicy policy_,
+        uint32_t spin_micros_
+    );
+
+    ///<summary>
+    ///Holds outbound messages back so that bursts of small messages reach the transport as one write.
+    ///<para>Messages are held for at most latency_micros_ microseconds, or until flush_threshold_ bytes are waiting, or until flush()
+    ///is called, whichever comes first. A flush_threshold_ of zero selects a 64 byte threshold. A latency_micros_ of zero sends
+    ///every message as soon as it is complete, which is the default.</para>
+    ///</summary>
+    void
+    setTransmitPolicy(
+        uint32_t latency_micros_,
+        uint32_t flush_threshold_
+    );
+
+    ///<summary>
+    ///Sets how sysex, capability and I2C reply payloads are handed to event subscribers. The default is SysexDeliveryMode.COPY.
+    ///<para>SysexDeliveryMode.VIEW delivers every message without allocating or copying, at the cost of the payload only being valid
+    ///for the duration of the event handler.</para>
+    ///</summary>
+    void
+    setSysexDeliveryMode(
+        SysexDeliveryMode mode_
+    );
+
     ///<summary>
     ///Sets the firmware name and version
     ///</summary>
@@ -347,6 +770,21 @@ public:
         uint8_t minor_
     );
 
+    ///<summary>
+    ///Raises message events from a pool of thread_count_ dispatcher threads instead of the input thread, so slow event handlers no longer
+    ///delay reading and parsing. Events of the same type (analog, digital, sysex) are always raised in the order they arrived; events of
+    ///different types may be raised concurrently. Each type buffers up to queue_capacity_ messages; beyond that analog and digital reports
+    ///are dropped, as a newer report follows, while reading pauses until sysex handlers have made room.
+    ///<para>By default events are raised synchronously on the input thread.</para>
+    ///<para>Input is paused while the dispatcher is replaced, so this must not be called from an event handler of this instance,
+    ///whether it runs on the input thread, a reactor thread or a dispatcher thread; doing so throws E_ILLEGAL_METHOD_CALL.</para>
+    ///</summary>
+    void
+    startEventDispatcher(
+        uint32_t thread_count_,
+        uint32_t queue_capacity_
+    );
+
     ///<summary>
     ///Spins up a thread which will listen for and process input.
     ///<para>This function must be called before any inputs can be processed and corresponding events can be raised.</para>
@@ -356,6 +794,46 @@ public:
         void
     );
 
+    ///<summary>
+    ///Listens for and processes input on the given reactor's threads rather than a thread of its own, so the number of input threads stays
+    ///fixed however many connections share the reactor. The input wait policy does not apply; a reactor thread reads the connection when
+    ///its stream signals data (INotifyDataReceived or notifyDataAvailable()) and on every sweep. A null reactor starts a dedicated thread.
+    ///</summary>
+    void
+    startListening(
+        FirmataReactor ^reactor_
+    );
+
+    ///<summary>
+    ///Records every byte sent and received on the current connection, with a timestamp, to the file at path_ until stopTrace() is called.
+    ///<para>The trace can be played back with TraceReplayStream. Returns false if no connection has been attached or the file
+    ///cannot be created.</para>
+    ///<para>Input is paused while the trace is attached, so this must not be called from an event handler of this instance; doing so
+    ///throws E_ILLEGAL_METHOD_CALL.</para>
+    ///</summary>
+    bool
+    startTrace(
+        String ^path_
+    );
+
+    ///<summary>
+    ///Stops the dispatcher threads started by startEventDispatcher(); events are raised on the input thread again.
+    ///<para>Must not be called from an event handler of this instance; doing so throws E_ILLEGAL_METHOD_CALL.</para>
+    ///</summary>
+    void
+    stopEventDispatcher(
+        void
+    );
+
+    ///<summary>
+    ///Stops and closes the trace started by startTrace().
+    ///<para>Must not be called from an event handler of this instance; doing so throws E_ILLEGAL_METHOD_CALL.</para>
+    ///</summary>
+    void
+    stopTrace(
+        void
+    );
+
     ///<summary>
     ///Unlocks this instance of the UwpFirmata object, allowing other threads or actions to use it.
     ///<para>This function must be explicitly invoked after each invocation of the lock() method, when the lock is no longer needed.</para>
@@ -367,6 +845,7 @@ public:
 
     ///<summary>
     ///Writes a single byte using an active connection
+    ///<para>The byte is held in the outbound queue until flush() is called, so a sequence of writes is sent as one frame.</para>
     ///</summary>
     void
     write(
@@ -378,6 +857,14 @@ public:
     const uint8_t FIRMATA_PROTOCOL_MINOR_VERSION = 3;
     const double MESSAGE_TIMEOUT_MILLIS = 500.0;
 
+    //maximum number of bytes consumed from the transport by a single call to processInput
+    static const size_t RECEIVE_BUFFER_SIZE = 1024;
+
+    //bounds on how long an idle input thread sleeps before polling the stream again, when nothing signals that data has arrived
+    const std::chrono::microseconds MIN_PARK_MICROS = std::chrono::microseconds( 100 );
+    const std::chrono::microseconds MAX_PARK_MICROS = std::chrono::microseconds( 1000 );
+    const std::chrono::milliseconds BLOCKING_PARK_MILLIS = std::chrono::milliseconds( 100 );
+
     //version number and name array used with set/printFirmwareVersion
     uint8_t firmwareVersionMajor;
     uint8_t firmwareVersionMinor;
@@ -389,29 +876,132 @@ public:
 
     //member variables to hold the current input thread & communications
     Serial::IStream ^_firmata_stream;
+    std::unique_ptr<FirmataTransport> _transport;
+
+    //the recorder wrapping _transport while a trace is running, owned by _transport
+    RecordingTransport *_trace_transport;
+
+    //bytes given to write() which will be sent as one frame on the next flush()
+    std::vector<uint8_t> _tx_buffer;
+
+    //complete outbound frames; senders encode into it concurrently and whichever thread holds _tx_draining writes it to the transport
+    static const size_t TRANSMIT_RING_SIZE = 16384;
+    std::unique_ptr<OutboundRing> _tx_ring;
+    std::atomic_bool _tx_draining;
+
+    //frames drained from the ring are gathered here so they reach the transport in one write, owned by the draining thread
+    std::vector<uint8_t> _tx_queue;
+
+    //transmit policy, see setTransmitPolicy
+    std::atomic<int64_t> _tx_latency_micros;
+    std::atomic<size_t> _tx_flush_threshold;
+    std::atomic_bool _tx_deadline_armed;
+
+    //writes out held frames once their latency budget expires
+    std::thread _tx_thread;
+    std::atomic_bool _tx_thread_should_exit;
+    std::mutex _tx_mutex;
+    std::condition_variable _tx_condition;
+    std::chrono::steady_clock::time_point _tx_deadline;
+
+    //resumable parser holding any partially received message between calls to processInput
+    FirmataParser _parser;
+
+    //per-connection receive buffer; messages received whole within one read are delivered straight out of it
+    std::unique_ptr<uint8_t[]> _rx_buffer;
+
+    //reused event arguments and payload buffer for SysexDeliveryMode::VIEW
+    std::atomic<SysexDeliveryMode> _sysex_delivery_mode;
+    NativeBuffer *_view_buffer;
+    IBuffer ^_view_buffer_handle;
+    SysexCallbackEventArgs ^_sysex_view_args;
+    I2cCallbackEventArgs ^_i2c_view_args;
+
+    //raises message events away from the input thread when enabled, see startEventDispatcher
+    std::unique_ptr<MessageDispatcher> _dispatcher;
 
     //stores the state of the connection
     std::atomic_bool _connection_ready;
 
     //thread-safe mechanisms. std::unique_lock used to manage the lifecycle of std::mutex
-    std::mutex _firmutex;
-    std::unique_lock<std::mutex> _firmata_lock;
+    TimedMutex<std::mutex> _firmutex;
+    std::unique_lock<TimedMutex<std::mutex>> _firmata_lock;
+
+    //counters for this connection, see getMetrics
+    ConnectionMetrics _metrics;
 
     //input thread & behavior mechanisms
     std::thread _input_thread;
     std::atomic_bool _input_thread_should_exit;
 
+    //idle behavior of the input thread, see setInputWaitPolicy
+    std::atomic<InputWaitPolicy> _input_wait_policy;
+    std::atomic<int64_t> _input_spin_micros;
+
+    //signalled by notifyDataAvailable() to wake a parked input thread
+    std::mutex _input_wait_mutex;
+    std::condition_variable _input_wait_condition;
+    bool _input_signalled;
+
+    //shared input threads used instead of _input_thread, see startListening( FirmataReactor ); _reactor_source is guarded by _input_wait_mutex
+    FirmataReactor ^_reactor;
+    InputReactor::Source *_reactor_source;
+
+    IBuffer ^
+    copyToBuffer(
+        const uint8_t *data_,
+        size_t length_
+    );
+
+    SysexCallbackEventArgs ^
+    createSysexEventArgs(
+        uint8_t command_,
+        uint8_t *data_,
+        size_t length_,
+        bool view_
+    );
+
     String ^
     createStringFromMbs(
         uint8_t *mbs_,
         size_t len_
     );
 
+    void
+    dispatchMessage(
+        const FirmataMessage &message_
+    );
+
     void
     inputThread(
         void
     );
 
+    bool
+    isListening(
+        void
+    );
+
+    bool
+    isServicingThread(
+        void
+    );
+
+    void
+    parkInputThread(
+        std::chrono::microseconds timeout_
+    );
+
+    size_t
+    pollInput(
+        void
+    );
+
+    size_t
+    pollReactorInput(
+        void
+    );
+
     void
     onConnectionEstablished(
         void
@@ -427,11 +1017,56 @@ public:
         Platform::String ^message_
     );
 
+    void
+    abandonFrame(
+        uint8_t *frame_
+    );
+
+    uint8_t *
+    beginFrame(
+        size_t length_
+    );
+
+    void
+    drainTransmitRing(
+        bool wait_,
+        const uint8_t *oversized_frame_ = nullptr,
+        size_t oversized_length_ = 0
+    );
+
+    void
+    endFrame(
+        uint8_t *frame_,
+        size_t length_
+    );
+
+    void
+    sendFrame(
+        const uint8_t *frame_,
+        size_t length_
+    );
+
+    void
+    replaceTransport(
+        std::function<void( void )> replace_
+    );
+
     void
     stopThreads(
         void
     );
 
+    void
+    stopTransmitThread(
+        void
+    );
+
+    void
+    transmitThread(
+        void
+    );
+
+
     void
     reassembleByteString(
         uint8_t *byte_string_,
@@ -37,14 +37,14 @@ HardwareProfile::HardwareProfile(
     Windows::Storage::Streams::IBuffer ^buffer_,
     Protocol protocol_
     ) :
-    _is_valid( ATOMIC_VAR_INIT( false ) ),
-    _total_pin_count( ATOMIC_VAR_INIT( 0 ) ),
-    _analog_offset( ATOMIC_VAR_INIT( 0 ) ),
-    _analog_pin_count( ATOMIC_VAR_INIT( 0 ) ),
-    _pinCapabilities( nullptr ),
-    _analogResolutions( nullptr ),
-    _pwmResolutions( nullptr ),
-    _servoResolutions( nullptr )
+    _is_valid( false ),
+    _analog_offset( 0 ),
+    _analog_pin_count( 0 ),
+    _total_pin_count( 0 ),
+    _capabilities(),
+    _analog_resolutions(),
+    _pwm_resolutions(),
+    _servo_resolutions()
 {
     switch( protocol_ )
     {
@@ -55,47 +55,72 @@ HardwareProfile::HardwareProfile(
     default:
         throw ref new Platform::Exception( E_INVALIDARG, "An invalid or unsupported Protocol was specified in HardwareProfile constructor." );
     }
+
+    buildPinLists();
 }
 
 HardwareProfile::HardwareProfile(
     int total_number_of_pins_,
     int number_of_analog_pins_
     ) :
-    _is_valid( ATOMIC_VAR_INIT( false ) ),
-    _total_pin_count( ATOMIC_VAR_INIT( total_number_of_pins_ ) ),
-    _analog_offset( ATOMIC_VAR_INIT( total_number_of_pins_ - number_of_analog_pins_ ) ),
-    _analog_pin_count( ATOMIC_VAR_INIT( number_of_analog_pins_ ) ),
-    _pinCapabilities( nullptr ),
-    _analogResolutions( nullptr ),
-    _pwmResolutions( nullptr ),
-    _servoResolutions( nullptr )
+    _is_valid( false ),
+    _analog_offset( total_number_of_pins_ - number_of_analog_pins_ ),
+    _analog_pin_count( number_of_analog_pins_ ),
+    _total_pin_count( total_number_of_pins_ ),
+    _capabilities(),
+    _analog_resolutions(),
+    _pwm_resolutions(),
+    _servo_resolutions()
 {
+    buildPinLists();
 }
 
-
-HardwareProfile::~HardwareProfile()
+HardwareProfile::HardwareProfile(
+    const HardwareProfileCache::Profile &pins_
+    ) :
+    _is_valid( false ),
+    _analog_offset( 0 ),
+    _analog_pin_count( 0 ),
+    _total_pin_count( 0 ),
+    _capabilities(),
+    _analog_resolutions(),
+    _pwm_resolutions(),
+    _servo_resolutions()
 {
-    _is_valid = false;
-
-    if( _pinCapabilities != nullptr )
+    if( !pins_.empty() && pins_.size() <= MAX_PINS )
     {
-        delete( _pinCapabilities );
-    }
+        int analog_offset = -1;
+        int num_analog_pins = 0;
 
-    if( _analogResolutions != nullptr )
-    {
-        delete( _analogResolutions );
-    }
+        for( size_t pin = 0; pin < pins_.size(); ++pin )
+        {
+            for( size_t capability = 0; capability < CAPABILITY_COUNT; ++capability )
+            {
+                _capabilities[capability][pin] = ( ( pins_[pin].capabilities >> capability ) & 0x01 ) != 0;
+            }
 
-    if( _pwmResolutions != nullptr )
-    {
-        delete( _pwmResolutions );
-    }
+            //resolutions are only kept for the capabilities the pin has, as when parsing a capability response
+            if( hasCapability( pin, PinCapability::ANALOG ) )
+            {
+                _analog_resolutions[pin] = pins_[pin].analog_resolution;
+                if( analog_offset < 0 ) analog_offset = static_cast<int>( pin );
+                ++num_analog_pins;
+            }
+            if( hasCapability( pin, PinCapability::PWM ) ) _pwm_resolutions[pin] = pins_[pin].pwm_resolution;
+            if( hasCapability( pin, PinCapability::SERVO ) ) _servo_resolutions[pin] = pins_[pin].servo_resolution;
+        }
 
-    if( _servoResolutions != nullptr )
-    {
-        delete( _servoResolutions );
+        _total_pin_count = static_cast<int>( pins_.size() );
+        _analog_offset = ( analog_offset < 0 ) ? 0xFF : analog_offset;
+        _analog_pin_count = num_analog_pins;
+        _is_valid = true;
     }
+
+    buildPinLists();
+}
+
+HardwareProfile::~HardwareProfile()
+{
 }
 
 
@@ -108,11 +133,58 @@ HardwareProfile::getPinCapabilitiesBitmask(
     size_t pin_
     )
 {
-    if( !_is_valid || _pinCapabilities == nullptr || pin_ >= _total_pin_count )
+    uint8_t bitmask = 0;
+    if( pin_ >= MAX_PINS ) return bitmask;
+
+    for( size_t capability = 0; capability < CAPABILITY_COUNT; ++capability )
+    {
+        if( _capabilities[capability][pin_] ) bitmask |= static_cast<uint8_t>( 1 << capability );
+    }
+    return bitmask;
+}
+
+uint8_t
+HardwareProfile::getAnalogResolution(
+    size_t pin_
+    )
+{
+    return ( pin_ < MAX_PINS ) ? _analog_resolutions[pin_] : 0;
+}
+
+uint8_t
+HardwareProfile::getPwmResolution(
+    size_t pin_
+    )
+{
+    return ( pin_ < MAX_PINS ) ? _pwm_resolutions[pin_] : 0;
+}
+
+uint8_t
+HardwareProfile::getServoResolution(
+    size_t pin_
+    )
+{
+    return ( pin_ < MAX_PINS ) ? _servo_resolutions[pin_] : 0;
+}
+
+HardwareProfileCache::Profile
+HardwareProfile::getPinRecords(
+    void
+    )
+{
+    HardwareProfileCache::Profile pins;
+    if( !_is_valid ) return pins;
+
+    pins.resize( _total_pin_count );
+    for( size_t pin = 0; pin < pins.size(); ++pin )
     {
-        return 0;
+        pins[pin].capabilities = getPinCapabilitiesBitmask( pin );
+        pins[pin].analog_resolution = _analog_resolutions[pin];
+        pins[pin].pwm_resolution = _pwm_resolutions[pin];
+        pins[pin].servo_resolution = _servo_resolutions[pin];
     }
-    return _pinCapabilities->at( pin_ );
+
+    return pins;
 }
 
 bool
@@ -120,7 +192,7 @@ HardwareProfile::isAnalogSupported(
     size_t pin_
     )
 {
-    return ( getPinCapabilitiesBitmask( pin_ ) & static_cast<uint8_t>( PinCapability::ANALOG ) ) > 0;
+    return hasCapability( pin_, PinCapability::ANALOG );
 }
 
 bool
@@ -128,7 +200,7 @@ HardwareProfile::isDigitalInputSupported(
     size_t pin_
     )
 {
-    return ( getPinCapabilitiesBitmask( pin_ ) & static_cast<uint8_t>( PinCapability::INPUT ) ) > 0;
+    return hasCapability( pin_, PinCapability::INPUT );
 }
 
 bool
@@ -136,7 +208,7 @@ HardwareProfile::isDigitalInputPullupSupported(
     size_t pin_
     )
 {
-    return ( getPinCapabilitiesBitmask( pin_ ) & static_cast<uint8_t>( PinCapability::INPUT_PULLUP ) ) > 0;
+    return hasCapability( pin_, PinCapability::INPUT_PULLUP );
 }
 
 bool
@@ -144,7 +216,7 @@ HardwareProfile::isDigitalOutputSupported(
     size_t pin_
     )
 {
-    return ( getPinCapabilitiesBitmask( pin_ ) & static_cast<uint8_t>( PinCapability::OUTPUT ) ) > 0;
+    return hasCapability( pin_, PinCapability::OUTPUT );
 }
 
 bool
@@ -152,7 +224,7 @@ HardwareProfile::isI2cSupported(
     size_t pin_
     )
 {
-    return ( getPinCapabilitiesBitmask( pin_ ) & static_cast<uint8_t>( PinCapability::I2C ) ) > 0;
+    return hasCapability( pin_, PinCapability::I2C );
 }
 
 bool
@@ -160,7 +232,7 @@ HardwareProfile::isPwmSupported(
     size_t pin_
     )
 {
-    return ( getPinCapabilitiesBitmask( pin_ ) & static_cast<uint8_t>( PinCapability::PWM ) ) > 0;
+    return hasCapability( pin_, PinCapability::PWM );
 }
 
 bool
@@ -168,13 +240,71 @@ HardwareProfile::isServoSupported(
     size_t pin_
     )
 {
-    return ( getPinCapabilitiesBitmask( pin_ ) & static_cast<uint8_t>( PinCapability::SERVO ) ) > 0;
+    return hasCapability( pin_, PinCapability::SERVO );
 }
 
 //******************************************************************************
 //* Private Methods
 //******************************************************************************
 
+void
+HardwareProfile::buildPinLists(
+    void
+    )
+{
+    //an invalid profile has no capabilities, so it lists no pins at all
+    std::bitset<MAX_PINS> disabled;
+    if( _is_valid )
+    {
+        for( size_t pin = 0; pin < static_cast<size_t>( _total_pin_count ); ++pin )
+        {
+            disabled[pin] = ( getPinCapabilitiesBitmask( pin ) == 0 );
+        }
+    }
+
+    _analog_pins = pinList( _capabilities[capabilityIndex( PinCapability::ANALOG )] );
+    _digital_pins = pinList( _capabilities[capabilityIndex( PinCapability::OUTPUT )] );
+    _disabled_pins = pinList( disabled );
+    _i2c_pins = pinList( _capabilities[capabilityIndex( PinCapability::I2C )] );
+    _pwm_pins = pinList( _capabilities[capabilityIndex( PinCapability::PWM )] );
+    _servo_pins = pinList( _capabilities[capabilityIndex( PinCapability::SERVO )] );
+
+    _analog_pins_view = ( ref new Platform::Collections::Vector<uint8_t>( _analog_pins ) )->GetView();
+    _digital_pins_view = ( ref new Platform::Collections::Vector<uint8_t>( _digital_pins ) )->GetView();
+    _disabled_pins_view = ( ref new Platform::Collections::Vector<uint8_t>( _disabled_pins ) )->GetView();
+    _i2c_pins_view = ( ref new Platform::Collections::Vector<uint8_t>( _i2c_pins ) )->GetView();
+    _pwm_pins_view = ( ref new Platform::Collections::Vector<uint8_t>( _pwm_pins ) )->GetView();
+    _servo_pins_view = ( ref new Platform::Collections::Vector<uint8_t>( _servo_pins ) )->GetView();
+}
+
+size_t
+HardwareProfile::capabilityIndex(
+    PinCapability capability_
+    )
+{
+    switch( capability_ )
+    {
+    case PinCapability::INPUT: return 0;
+    case PinCapability::INPUT_PULLUP: return 1;
+    case PinCapability::OUTPUT: return 2;
+    case PinCapability::ANALOG: return 3;
+    case PinCapability::PWM: return 4;
+    case PinCapability::SERVO: return 5;
+    case PinCapability::I2C:
+    default: return 6;
+    }
+}
+
+bool
+HardwareProfile::hasCapability(
+    size_t pin_,
+    PinCapability capability_
+    )
+{
+    //capabilities are only ever set for the pins of a valid profile
+    return pin_ < MAX_PINS && _capabilities[capabilityIndex( capability_ )][pin_];
+}
+
 void
 HardwareProfile::initializeWithFirmata(
     Windows::Storage::Streams::IBuffer ^buffer_
@@ -183,201 +313,109 @@ HardwareProfile::initializeWithFirmata(
     if( buffer_ == nullptr ) return;
 
     const uint8_t MODE_ENABLED = 1;
-    const int FIRMATA_END_OF_PIN_VALUE = 0x7F;
-
-    auto reader = Windows::Storage::Streams::DataReader::FromBuffer( buffer_ );
-    auto size = buffer_->Length;
+    const uint8_t FIRMATA_END_OF_PIN_VALUE = 0x7F;
 
-    bool found_errors = false;
-    uint8_t *data = (uint8_t *)malloc( sizeof( uint8_t ) * size );
-    for( unsigned int i = 0; i < size; ++i )
+    std::vector<uint8_t> data( buffer_->Length );
+    if( !data.empty() )
     {
-        data[i] = reader->ReadByte();
+        Windows::Storage::Streams::DataReader::FromBuffer( buffer_ )->ReadBytes( Platform::ArrayReference<uint8_t>( data.data(), static_cast<unsigned int>( data.size() ) ) );
     }
 
-    byte total_pins = 0;
-    byte analog_offset = 0xFF;
-    byte num_analog_pins = 0;
-    std::vector<uint8_t> *pinCapabilities = new std::vector<uint8_t>;
-    std::map<uint8_t, uint8_t> *analogResolutions = new std::map<uint8_t, uint8_t>; //K = pin number, V = resolution value in bits
-    std::map<uint8_t, uint8_t> *pwmResolutions = new std::map<uint8_t, uint8_t>; //K = pin number, V = resolution value in bits
-    std::map<uint8_t, uint8_t> *servoResolutions = new std::map<uint8_t, uint8_t>; //K = pin number, V = resolution value in bits
+    //the profile is parsed into locals and only kept if the whole response is valid
+    std::array<std::bitset<MAX_PINS>, CAPABILITY_COUNT> capabilities;
+    std::array<uint8_t, MAX_PINS> analog_resolutions = {};
+    std::array<uint8_t, MAX_PINS> pwm_resolutions = {};
+    std::array<uint8_t, MAX_PINS> servo_resolutions = {};
+    size_t total_pins = 0;
+    uint8_t analog_offset = 0xFF;
+    uint8_t num_analog_pins = 0;
 
-    for( unsigned int i = 0; !found_errors && i < size; ++i )
+    for( size_t i = 0; i < data.size(); ++i, ++total_pins )
     {
-        uint8_t currentPinCapabilities = 0;
+        if( total_pins >= MAX_PINS ) return;    //more pins than Firmata can address
 
-        while( !found_errors && i < size && data[i] != FIRMATA_END_OF_PIN_VALUE )
+        //each pin lists its modes until FIRMATA_END_OF_PIN_VALUE. Every mode is followed by one byte, which says whether the mode is
+        //enabled or, for analog, PWM and servo, gives its resolution in bits
+        while( i < data.size() && data[i] != FIRMATA_END_OF_PIN_VALUE )
         {
+            if( i + 1 >= data.size() ) return;  //we've failed to get all of the data
+
             PinMode mode = static_cast<PinMode>( data[i] );
+            uint8_t value = data[i + 1];
+            i += 2;
+
             switch( mode )
             {
             case PinMode::INPUT:
-
-                //the next bit determines if the mode is enabled, this should always be true
-                ++i;
-                if( i < size )
-                {
-                    if( data[i] == MODE_ENABLED )
-                    {
-                        currentPinCapabilities |= static_cast<uint8_t>( PinCapability::INPUT );
-                    }
-                }
-                else
-                {
-                    found_errors = true;    //we've failed to get all of the data
-                }
-                ++i;
-
+                if( value == MODE_ENABLED ) capabilities[capabilityIndex( PinCapability::INPUT )][total_pins] = true;
                 break;
 
             case PinMode::OUTPUT:
-
-                //the next bit determines if the mode is enabled, this should always be true
-                ++i;
-                if( i < size )
-                {
-                    if( data[i] == MODE_ENABLED )
-                    {
-                        currentPinCapabilities |= static_cast<uint8_t>( PinCapability::OUTPUT );
-                    }
-                }
-                else
-                {
-                    found_errors = true;    //we've failed to get all of the data
-                }
-                ++i;
-
+                if( value == MODE_ENABLED ) capabilities[capabilityIndex( PinCapability::OUTPUT )][total_pins] = true;
                 break;
 
             case PinMode::PULLUP:
+                if( value == MODE_ENABLED ) capabilities[capabilityIndex( PinCapability::INPUT_PULLUP )][total_pins] = true;
+                break;
 
-                //the next bit determines if the mode is enabled, this should always be true
-                ++i;
-                if( i < size )
-                {
-                    if( data[i] == MODE_ENABLED )
-                    {
-                        currentPinCapabilities |= static_cast<uint8_t>( PinCapability::INPUT_PULLUP );
-                    }
-                }
-                else
-                {
-                    found_errors = true;    //we've failed to get all of the data
-                }
-                ++i;
-
+            case PinMode::I2C:
+                if( value == MODE_ENABLED ) capabilities[capabilityIndex( PinCapability::I2C )][total_pins] = true;
                 break;
 
             case PinMode::ANALOG:
-
-                //set the mode enabled & store the analog resolution of this pin
-                ++i;
-                if( i < size )
-                {
-                    currentPinCapabilities |= static_cast<uint8_t>( PinCapability::ANALOG );
-                    analogResolutions->insert( std::make_pair( total_pins, data[i] ) );
-                }
-                else
-                {
-                    found_errors = true;    //we've failed to get all of the data
-                }
-                ++i;
+                capabilities[capabilityIndex( PinCapability::ANALOG )][total_pins] = true;
+                analog_resolutions[total_pins] = value;
 
                 //analog offset keeps track of the first pin found that supports analog read, tells us how many digital pins we have,
                 //and allows us to convert analog pins like "A0" to the correct pin number
                 if( analog_offset == 0xFF )
                 {
-                    analog_offset = total_pins;
+                    analog_offset = static_cast<uint8_t>( total_pins );
                 }
                 ++num_analog_pins;
-
                 break;
 
             case PinMode::PWM:
-
-                //set the mode enabled & store the pwm resolution of this pin
-                ++i;
-                if( i < size )
-                {
-                    currentPinCapabilities |= static_cast<uint8_t>( PinCapability::PWM );
-                    pwmResolutions->insert( std::make_pair( total_pins, data[i] ) );
-                }
-                else
-                {
-                    found_errors = true;    //we've failed to get all of the data
-                }
-                ++i;
-
+                capabilities[capabilityIndex( PinCapability::PWM )][total_pins] = true;
+                pwm_resolutions[total_pins] = value;
                 break;
 
             case PinMode::SERVO:
-
-                //set the mode enabled & store the servo resolution of this pin
-                ++i;
-                if( i < size )
-                {
-                    currentPinCapabilities |= static_cast<uint8_t>( PinCapability::SERVO );
-                    servoResolutions->insert( std::make_pair( total_pins, data[i] ) );
-                }
-                else
-                {
-                    found_errors = true;    //we've failed to get all of the data
-                }
-                ++i;
-
-                break;
-
-            case PinMode::I2C:
-
-                //the next bit determines if the mode is enabled, this should always be true
-                ++i;
-                if( i < size )
-                {
-                    if( data[i] == MODE_ENABLED )
-                    {
-                        currentPinCapabilities |= static_cast<uint8_t>( PinCapability::I2C );
-                    }
-                }
-                else
-                {
-                    found_errors = true;    //we've failed to get all of the data
-                }
-                ++i;
-
+                capabilities[capabilityIndex( PinCapability::SERVO )][total_pins] = true;
+                servo_resolutions[total_pins] = value;
                 break;
 
             default:
-                //this value isn't recognized. it is likely fatal, but also possible that new data was added to the query response. We will attempt to continue
-                ++i;
-
+                //this value isn't recognized, it is likely a mode added to the protocol since, so it and its value are skipped
                 break;
             }
         }
-        pinCapabilities->push_back( currentPinCapabilities );
-        total_pins++;
-    }
-
-    //last minute error-checking
-    if( total_pins != pinCapabilities->size() ||
-        num_analog_pins != analogResolutions->size() )
-    {
-        found_errors = true;
-    }
-
-    free( data );
-    if( found_errors )
-    {
-        return;
     }
 
     //we've successfully parsed a valid capability response. Set all members of this class and mark it as valid.
-    _total_pin_count = total_pins;
+    _total_pin_count = static_cast<int>( total_pins );
     _analog_offset = analog_offset;
     _analog_pin_count = num_analog_pins;
-    _pinCapabilities = pinCapabilities;
-    _analogResolutions = analogResolutions;
-    _pwmResolutions = pwmResolutions;
-    _servoResolutions = servoResolutions;
+    _capabilities = capabilities;
+    _analog_resolutions = analog_resolutions;
+    _pwm_resolutions = pwm_resolutions;
+    _servo_resolutions = servo_resolutions;
     _is_valid = true;
 }
+
+std::vector<uint8_t>
+HardwareProfile::pinList(
+    const std::bitset<MAX_PINS> &pins_
+    )
+{
+    std::vector<uint8_t> pins;
+    pins.reserve( pins_.count() );
+    for( size_t pin = 0; pin < MAX_PINS; ++pin )
+    {
+        if( pins_[pin] )
+        {
+            pins.push_back( static_cast<uint8_t>( pin ) );
+        }
+    }
+    return pins;
+}
@@ -24,6 +24,11 @@
 
 #pragma once
 
+#include <array>
+#include <bitset>
+#include <vector>
+#include "HardwareProfileCache.h"
+
 namespace Microsoft {
 namespace Maker {
 namespace RemoteWiring {
@@ -96,120 +101,114 @@ public:
         }
     }
 
+    //the analog pins, copied into a new vector on every access; AnalogPinsView returns them without allocating
     property Windows::Foundation::Collections::IVector<uint8_t> ^AnalogPins
     {
         Windows::Foundation::Collections::IVector<uint8_t> ^ get()
         {
-            auto vector = ref new Platform::Collections::Vector<uint8_t>();
-            if( _is_valid )
-            {
-                for( size_t pin = _analog_offset; pin < _total_pin_count; ++pin )
-                {
-                    if( isAnalogSupported( pin ) )
-                    {
-                        vector->Append( pin );
-                    }
-                }
-            }
-            return vector;
+            return ref new Platform::Collections::Vector<uint8_t>( _analog_pins );
+        }
+    }
+
+    //the analog pins, as the same read-only list on every access
+    property Windows::Foundation::Collections::IVectorView<uint8_t> ^AnalogPinsView
+    {
+        Windows::Foundation::Collections::IVectorView<uint8_t> ^ get()
+        {
+            return _analog_pins_view;
         }
     }
 
+    //the digital output pins, copied into a new vector on every access; DigitalPinsView returns them without allocating
     property Windows::Foundation::Collections::IVector<uint8_t> ^DigitalPins
     {
         Windows::Foundation::Collections::IVector<uint8_t> ^ get()
         {
-            auto vector = ref new Platform::Collections::Vector<uint8_t>();
-            if( _is_valid )
-            {
-                for( size_t pin = 0; pin < _total_pin_count; ++pin )
-                {
-                    if( isDigitalOutputSupported( pin ) )
-                    {
-                        vector->Append( pin );
-                    }
-                }
-            }
-            return vector;
+            return ref new Platform::Collections::Vector<uint8_t>( _digital_pins );
         }
     }
 
+    //the digital output pins, as the same read-only list on every access
+    property Windows::Foundation::Collections::IVectorView<uint8_t> ^DigitalPinsView
+    {
+        Windows::Foundation::Collections::IVectorView<uint8_t> ^ get()
+        {
+            return _digital_pins_view;
+        }
+    }
+
+    //the disabled pins, copied into a new vector on every access; DisabledPinsView returns them without allocating
     property Windows::Foundation::Collections::IVector<uint8_t> ^DisabledPins
     {
         Windows::Foundation::Collections::IVector<uint8_t> ^ get()
         {
-            auto vector = ref new Platform::Collections::Vector<uint8_t>();
-            if( _is_valid )
-            {
-                for( size_t pin = 0; pin < _total_pin_count; ++pin )
-                {
-                    if( getPinCapabilitiesBitmask( pin ) == 0 )
-                    {
-                        vector->Append( pin );
-                    }
-                }
-            }
-            return vector;
+            return ref new Platform::Collections::Vector<uint8_t>( _disabled_pins );
         }
     }
 
+    //the disabled pins, as the same read-only list on every access
+    property Windows::Foundation::Collections::IVectorView<uint8_t> ^DisabledPinsView
+    {
+        Windows::Foundation::Collections::IVectorView<uint8_t> ^ get()
+        {
+            return _disabled_pins_view;
+        }
+    }
+
+    //the I2C pins, copied into a new vector on every access; I2cPinsView returns them without allocating
     property Windows::Foundation::Collections::IVector<uint8_t> ^I2cPins
     {
         Windows::Foundation::Collections::IVector<uint8_t> ^ get()
         {
-            auto vector = ref new Platform::Collections::Vector<uint8_t>();
-            if( _is_valid )
-            {
-                for( size_t pin = 0; pin < _total_pin_count; ++pin )
-                {
-                    if( isI2cSupported( pin ) )
-                    {
-                        vector->Append( pin );
-                    }
-                }
-            }
-            return vector;
+            return ref new Platform::Collections::Vector<uint8_t>( _i2c_pins );
         }
     }
 
+    //the I2C pins, as the same read-only list on every access
+    property Windows::Foundation::Collections::IVectorView<uint8_t> ^I2cPinsView
+    {
+        Windows::Foundation::Collections::IVectorView<uint8_t> ^ get()
+        {
+            return _i2c_pins_view;
+        }
+    }
+
+    //the PWM pins, copied into a new vector on every access; PwmPinsView returns them without allocating
     property Windows::Foundation::Collections::IVector<uint8_t> ^PwmPins
     {
         Windows::Foundation::Collections::IVector<uint8_t> ^ get()
         {
-            auto vector = ref new Platform::Collections::Vector<uint8_t>();
-            if( _is_valid )
-            {
-                for( size_t pin = 0; pin < _total_pin_count; ++pin )
-                {
-                    if( isPwmSupported( pin ) )
-                    {
-                        vector->Append( pin );
-                    }
-                }
-            }
-            return vector;
+            return ref new Platform::Collections::Vector<uint8_t>( _pwm_pins );
         }
     }
 
+    //the PWM pins, as the same read-only list on every access
+    property Windows::Foundation::Collections::IVectorView<uint8_t> ^PwmPinsView
+    {
+        Windows::Foundation::Collections::IVectorView<uint8_t> ^ get()
+        {
+            return _pwm_pins_view;
+        }
+    }
+
+    //the servo pins, copied into a new vector on every access; ServoPinsView returns them without allocating
     property Windows::Foundation::Collections::IVector<uint8_t> ^ServoPins
     {
         Windows::Foundation::Collections::IVector<uint8_t> ^ get()
         {
-            auto vector = ref new Platform::Collections::Vector<uint8_t>();
-            if( _is_valid )
-            {
-                for( size_t pin = 0; pin < _total_pin_count; ++pin )
-                {
-                    if( isServoSupported( pin ) )
-                    {
-                        vector->Append( pin );
-                    }
-                }
-            }
-            return vector;
+            return ref new Platform::Collections::Vector<uint8_t>( _servo_pins );
+        }
+    }
+
+    //the servo pins, as the same read-only list on every access
+    property Windows::Foundation::Collections::IVectorView<uint8_t> ^ServoPinsView
+    {
+        Windows::Foundation::Collections::IVectorView<uint8_t> ^ get()
+        {
+            return _servo_pins_view;
         }
     }
-    
+
     ///<summary>
     ///This default constructor accepts an IBuffer containing pin information which is assumed to be in the default Firmata protocol.
     ///<param name="buffer_">The input IBuffer object reference</param>
@@ -257,6 +256,36 @@ public:
         size_t pin_
         );
 
+    ///<summary>
+    ///returns the resolution of the analog (ADC) capability of the given pin number, in bits
+    ///<param name="pin_">The requested pin</param>
+    ///<returns>the resolution reported by the device, or 0 if the pin does not support the capability or this hardware profile is not valid</returns>
+    ///</summary>
+    uint8_t
+    getAnalogResolution(
+        size_t pin_
+        );
+
+    ///<summary>
+    ///returns the resolution of the PWM capability of the given pin number, in bits
+    ///<param name="pin_">The requested pin</param>
+    ///<returns>the resolution reported by the device, or 0 if the pin does not support the capability or this hardware profile is not valid</returns>
+    ///</summary>
+    uint8_t
+    getPwmResolution(
+        size_t pin_
+        );
+
+    ///<summary>
+    ///returns the resolution of the servo capability of the given pin number, in bits
+    ///<param name="pin_">The requested pin</param>
+    ///<returns>the resolution reported by the device, or 0 if the pin does not support the capability or this hardware profile is not valid</returns>
+    ///</summary>
+    uint8_t
+    getServoResolution(
+        size_t pin_
+        );
+
     ///<summary>
     ///returns true if the analog capability is supported by the given pin number
     ///<param name="pin_">The requested pin</param>
@@ -327,23 +356,87 @@ public:
         size_t pin_
         );
 
+internal:
+    ///<summary>
+    ///this constructor rebuilds a valid profile from the pin records kept by a HardwareProfileCache
+    ///<param name="pins_">The capabilities and resolutions of each pin, in pin order</param>
+    ///</summary>
+    HardwareProfile(
+        const HardwareProfileCache::Profile &pins_
+        );
+
+    ///<summary>
+    ///returns the capabilities and resolutions of each pin in the form kept by a HardwareProfileCache, or no records if this profile is not valid
+    ///</summary>
+    HardwareProfileCache::Profile
+    getPinRecords(
+        void
+        );
+
 private:
-    std::atomic_bool _is_valid;
+    //Firmata addresses at most 128 pins
+    static const size_t MAX_PINS = 128;
+    static const size_t CAPABILITY_COUNT = 7;
+
+    bool _is_valid;
 
     //stateful members received from the device
-    std::atomic_int _analog_offset;
-    std::atomic_int _analog_pin_count;
-    std::atomic_int _total_pin_count;
-    std::vector<uint8_t> *_pinCapabilities;
-    //for each of the following maps: K = pin number, V = resolution value in bits
-    std::map<uint8_t, uint8_t> *_analogResolutions;
-    std::map<uint8_t, uint8_t> *_pwmResolutions;
-    std::map<uint8_t, uint8_t> *_servoResolutions;
+    int _analog_offset;
+    int _analog_pin_count;
+    int _total_pin_count;
+
+    //one bitset per PinCapability, in the order of their bit values, so checking a capability is a single bit test
+    std::array<std::bitset<MAX_PINS>, CAPABILITY_COUNT> _capabilities;
+
+    //resolutions in bits, indexed by pin number; 0 where the pin lacks the capability
+    std::array<uint8_t, MAX_PINS> _analog_resolutions;
+    std::array<uint8_t, MAX_PINS> _pwm_resolutions;
+    std::array<uint8_t, MAX_PINS> _servo_resolutions;
+
+    //the pin lists are built once the profile is complete and never change afterwards; the IVector properties hand out copies, which
+    //the caller is free to modify
+    std::vector<uint8_t> _analog_pins;
+    std::vector<uint8_t> _digital_pins;
+    std::vector<uint8_t> _disabled_pins;
+    std::vector<uint8_t> _i2c_pins;
+    std::vector<uint8_t> _pwm_pins;
+    std::vector<uint8_t> _servo_pins;
+
+    //views of the same lists, built alongside them and shared by every caller
+    Windows::Foundation::Collections::IVectorView<uint8_t> ^_analog_pins_view;
+    Windows::Foundation::Collections::IVectorView<uint8_t> ^_digital_pins_view;
+    Windows::Foundation::Collections::IVectorView<uint8_t> ^_disabled_pins_view;
+    Windows::Foundation::Collections::IVectorView<uint8_t> ^_i2c_pins_view;
+    Windows::Foundation::Collections::IVectorView<uint8_t> ^_pwm_pins_view;
+    Windows::Foundation::Collections::IVectorView<uint8_t> ^_servo_pins_view;
+
+    void
+    buildPinLists(
+        void
+        );
+
+    static
+    size_t
+    capabilityIndex(
+        PinCapability capability_
+        );
+
+    bool
+    hasCapability(
+        size_t pin_,
+        PinCapability capability_
+        );
 
     void
     initializeWithFirmata(
         Windows::Storage::Streams::IBuffer ^buffer_
         );
+
+    static
+    std::vector<uint8_t>
+    pinList(
+        const std::bitset<MAX_PINS> &pins_
+        );
 };
 
 } // namespace Wiring
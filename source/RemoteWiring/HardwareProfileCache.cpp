@@ -0,0 +1,271 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "HardwareProfileCache.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+using namespace Microsoft::Maker::RemoteWiring;
+
+namespace {
+    const char MAGIC[4] = { 'R', 'W', 'H', 'P' };
+    const uint8_t VERSION = 1;
+    const size_t HEADER_SIZE = sizeof( MAGIC ) + 3;
+    const size_t PIN_RECORD_SIZE = 4;
+
+#ifdef _WIN32
+    const wchar_t TEMPORARY_SUFFIX[] = L".tmp";
+#else
+    const char TEMPORARY_SUFFIX[] = ".tmp";
+#endif
+}
+
+//******************************************************************************
+//* Constructors / Destructors
+//******************************************************************************
+
+HardwareProfileCache::HardwareProfileCache(
+    void
+    )
+{
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+bool
+HardwareProfileCache::open(
+    const path_char *path_
+    )
+{
+    if( path_ == nullptr ) return false;
+
+    std::lock_guard<std::mutex> lock( _mutex );
+    _path = path_;
+    _profiles.clear();
+
+    std::FILE *file = openFile( _path, false );
+    if( file == nullptr ) return false;
+
+    std::vector<uint8_t> contents;
+    uint8_t chunk[512];
+    size_t read;
+    while( ( read = std::fread( chunk, 1, sizeof( chunk ), file ) ) > 0 )
+    {
+        contents.insert( contents.end(), chunk, chunk + read );
+    }
+    std::fclose( file );
+
+    //a damaged file is discarded rather than trusted in part
+    if( !parse( contents ) )
+    {
+        _profiles.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool
+HardwareProfileCache::find(
+    const std::string &firmware_,
+    Profile &profile_
+    ) const
+{
+    std::lock_guard<std::mutex> lock( _mutex );
+
+    auto entry = _profiles.find( firmware_ );
+    if( entry == _profiles.end() ) return false;
+
+    profile_ = entry->second;
+    return true;
+}
+
+bool
+HardwareProfileCache::store(
+    const std::string &firmware_,
+    const Profile &profile_
+    )
+{
+    if( firmware_.empty() || firmware_.size() > MAX_KEY_LENGTH || profile_.empty() || profile_.size() > MAX_PINS ) return false;
+
+    std::lock_guard<std::mutex> lock( _mutex );
+
+    auto entry = _profiles.find( firmware_ );
+    if( entry != _profiles.end() && entry->second == profile_ ) return true;
+    if( entry == _profiles.end() && _profiles.size() >= MAX_ENTRIES ) return false;
+
+    if( _path.empty() )
+    {
+        _profiles[firmware_] = profile_;
+        return false;
+    }
+
+    //the profile is only cached once it is in the file, so a failed write is retried by the next store of the same profile
+    std::map<std::string, Profile> profiles = _profiles;
+    profiles[firmware_] = profile_;
+
+    //the new contents are written beside the file and then renamed over it, so a crash or failure mid-write never leaves a torn cache
+    std::basic_string<path_char> temporary_path = _path + TEMPORARY_SUFFIX;
+    std::vector<uint8_t> contents = serialize( profiles );
+    std::FILE *file = openFile( temporary_path, true );
+    if( file == nullptr ) return false;
+
+    bool written = ( std::fwrite( contents.data(), 1, contents.size(), file ) == contents.size() );
+    written = ( std::fclose( file ) == 0 ) && written;
+    if( !written || !replaceFile( temporary_path, _path ) )
+    {
+        removeFile( temporary_path );
+        return false;
+    }
+
+    _profiles.swap( profiles );
+    return true;
+}
+
+size_t
+HardwareProfileCache::size(
+    void
+    ) const
+{
+    std::lock_guard<std::mutex> lock( _mutex );
+    return _profiles.size();
+}
+
+//******************************************************************************
+//* Private Methods
+//******************************************************************************
+
+std::FILE *
+HardwareProfileCache::openFile(
+    const std::basic_string<path_char> &path_,
+    bool write_
+    )
+{
+    std::FILE *file = nullptr;
+#ifdef _WIN32
+    if( _wfopen_s( &file, path_.c_str(), write_ ? L"wb" : L"rb" ) ) file = nullptr;
+#else
+    file = std::fopen( path_.c_str(), write_ ? "wb" : "rb" );
+#endif
+    return file;
+}
+
+bool
+HardwareProfileCache::replaceFile(
+    const std::basic_string<path_char> &source_,
+    const std::basic_string<path_char> &destination_
+    )
+{
+#ifdef _WIN32
+    return !!MoveFileExW( source_.c_str(), destination_.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH );
+#else
+    return !std::rename( source_.c_str(), destination_.c_str() );
+#endif
+}
+
+void
+HardwareProfileCache::removeFile(
+    const std::basic_string<path_char> &path_
+    )
+{
+#ifdef _WIN32
+    _wremove( path_.c_str() );
+#else
+    std::remove( path_.c_str() );
+#endif
+}
+
+bool
+HardwareProfileCache::parse(
+    const std::vector<uint8_t> &contents_
+    )
+{
+    if( contents_.size() < HEADER_SIZE || std::memcmp( contents_.data(), MAGIC, sizeof( MAGIC ) ) || contents_[sizeof( MAGIC )] != VERSION ) return false;
+
+    size_t entries = contents_[sizeof( MAGIC ) + 1] | ( contents_[sizeof( MAGIC ) + 2] << 8 );
+    size_t position = HEADER_SIZE;
+
+    for( size_t i = 0; i < entries; ++i )
+    {
+        if( position >= contents_.size() ) return false;
+        size_t key_length = contents_[position++];
+
+        //the key is followed by the pin count
+        if( contents_.size() - position < key_length + 1 ) return false;
+        std::string key( reinterpret_cast<const char *>( contents_.data() + position ), key_length );
+        position += key_length;
+
+        size_t pins = contents_[position++];
+        if( contents_.size() - position < pins * PIN_RECORD_SIZE ) return false;
+
+        Profile profile( pins );
+        for( PinRecord &pin : profile )
+        {
+            pin.capabilities = contents_[position];
+            pin.analog_resolution = contents_[position + 1];
+            pin.pwm_resolution = contents_[position + 2];
+            pin.servo_resolution = contents_[position + 3];
+            position += PIN_RECORD_SIZE;
+        }
+
+        _profiles[key].swap( profile );
+    }
+
+    return position == contents_.size();
+}
+
+std::vector<uint8_t>
+HardwareProfileCache::serialize(
+    const std::map<std::string, Profile> &profiles_
+    )
+{
+    std::vector<uint8_t> contents( MAGIC, MAGIC + sizeof( MAGIC ) );
+    contents.push_back( VERSION );
+    contents.push_back( static_cast<uint8_t>( profiles_.size() & 0xFF ) );
+    contents.push_back( static_cast<uint8_t>( profiles_.size() >> 8 ) );
+
+    for( const auto &entry : profiles_ )
+    {
+        contents.push_back( static_cast<uint8_t>( entry.first.size() ) );
+        contents.insert( contents.end(), entry.first.begin(), entry.first.end() );
+        contents.push_back( static_cast<uint8_t>( entry.second.size() ) );
+
+        for( const PinRecord &pin : entry.second )
+        {
+            contents.push_back( pin.capabilities );
+            contents.push_back( pin.analog_resolution );
+            contents.push_back( pin.pwm_resolution );
+            contents.push_back( pin.servo_resolution );
+        }
+    }
+
+    return contents;
+}
@@ -0,0 +1,160 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Microsoft {
+namespace Maker {
+namespace RemoteWiring {
+
+/*
+ * HardwareProfileCache remembers the pin capabilities reported by each firmware, keyed by the firmware's name and version, so a board
+ * running known firmware can be used as soon as it has identified itself instead of after a full capability query. The cache is a
+ * small file which is read once when opened and replaced whenever a profile is added or changes; the new contents are written to a
+ * temporary file beside it which is then renamed over it, so the file is always either the old or the new cache, never part of one.
+ *
+ * The file holds a header (the magic "RWHP", a version byte and a 16-bit little-endian entry count) followed by each entry: the key
+ * length and key bytes, the pin count, then four bytes per pin - the capability bitmask and the analog, PWM and servo resolutions.
+ */
+class HardwareProfileCache
+{
+public:
+    //the capabilities of a single pin, as reported by CAPABILITY_RESPONSE
+    struct PinRecord
+    {
+        uint8_t capabilities;
+        uint8_t analog_resolution;
+        uint8_t pwm_resolution;
+        uint8_t servo_resolution;
+
+        bool operator==( const PinRecord &other_ ) const
+        {
+            return capabilities == other_.capabilities && analog_resolution == other_.analog_resolution && pwm_resolution == other_.pwm_resolution && servo_resolution == other_.servo_resolution;
+        }
+
+        bool operator!=( const PinRecord &other_ ) const { return !( *this == other_ ); }
+    };
+
+    typedef std::vector<PinRecord> Profile;
+
+#ifdef _WIN32
+    typedef wchar_t path_char;
+#else
+    typedef char path_char;
+#endif
+
+    HardwareProfileCache(
+        void
+    );
+
+    ///<summary>
+    ///Uses the file at path_ as the cache, loading any profiles it already holds. A missing or unreadable file leaves the cache empty
+    ///and is replaced the next time a profile is stored.
+    ///<returns>true if existing profiles were loaded</returns>
+    ///</summary>
+    bool
+    open(
+        const path_char *path_
+    );
+
+    ///<summary>
+    ///Copies the profile cached for the given firmware into profile_.
+    ///<returns>false if no profile is cached for the firmware</returns>
+    ///</summary>
+    bool
+    find(
+        const std::string &firmware_,
+        Profile &profile_
+    ) const;
+
+    ///<summary>
+    ///Caches profile_ for the given firmware and rewrites the file if this changed its contents. If the file cannot be written the
+    ///profile is not cached, so storing it again retries the write.
+    ///<returns>false if the file could not be written</returns>
+    ///</summary>
+    bool
+    store(
+        const std::string &firmware_,
+        const Profile &profile_
+    );
+
+    size_t
+    size(
+        void
+    ) const;
+
+    //limits of the file format
+    static const size_t MAX_KEY_LENGTH = 0xFF;
+    static const size_t MAX_PINS = 0xFF;
+    static const size_t MAX_ENTRIES = 0xFFFF;
+
+private:
+    mutable std::mutex _mutex;
+    std::basic_string<path_char> _path;
+    std::map<std::string, Profile> _profiles;
+
+    bool
+    parse(
+        const std::vector<uint8_t> &contents_
+    );
+
+    static
+    std::vector<uint8_t>
+    serialize(
+        const std::map<std::string, Profile> &profiles_
+    );
+
+    static
+    std::FILE *
+    openFile(
+        const std::basic_string<path_char> &path_,
+        bool write_
+    );
+
+    //renames source_ to destination_, replacing it if it exists
+    static
+    bool
+    replaceFile(
+        const std::basic_string<path_char> &source_,
+        const std::basic_string<path_char> &destination_
+    );
+
+    static
+    void
+    removeFile(
+        const std::basic_string<path_char> &path_
+    );
+};
+
+} // namespace RemoteWiring
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,145 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "I2cSampleRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace Microsoft::Maker::RemoteWiring::I2c;
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+I2cSampleRing::I2cSampleRing(
+    size_t capacity_,
+    size_t sample_length_
+    ) :
+    _capacity( ( std::max )( capacity_, static_cast<size_t>( 1 ) ) ),
+    _sample_length( sample_length_ ),
+    _data( new uint8_t[_capacity * sample_length_ + 1] ),
+    _timestamps( new clock::time_point[_capacity] ),
+    _head( 0 ),
+    _tail( 0 ),
+    _dropped( 0 )
+{
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+bool
+I2cSampleRing::push(
+    clock::time_point timestamp_,
+    const uint8_t *data_,
+    size_t length_
+    )
+{
+    uint64_t head = _head.load( std::memory_order_relaxed );
+    if( ( head - _tail.load( std::memory_order_acquire ) ) >= _capacity )
+    {
+        //only the producer writes _dropped, so no read-modify-write is needed
+        _dropped.store( _dropped.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+        return false;
+    }
+
+    size_t slot = static_cast<size_t>( head % _capacity );
+    uint8_t *sample = _data.get() + ( slot * _sample_length );
+    size_t length = ( std::min )( length_, _sample_length );
+    if( length ) { std::memcpy( sample, data_, length ); }
+    if( length < _sample_length ) { std::memset( sample + length, 0, _sample_length - length ); }
+    _timestamps[slot] = timestamp_;
+
+    //publishes the sample to consumers
+    _head.store( head + 1, std::memory_order_release );
+    return true;
+}
+
+size_t
+I2cSampleRing::drain(
+    uint8_t *data_,
+    clock::time_point *timestamps_,
+    size_t max_samples_
+    )
+{
+    std::lock_guard<std::mutex> lock( _drain_mutex );
+
+    uint64_t tail = _tail.load( std::memory_order_relaxed );
+    size_t count = static_cast<size_t>( ( std::min )( _head.load( std::memory_order_acquire ) - tail, static_cast<uint64_t>( max_samples_ ) ) );
+
+    //the waiting samples may wrap around the end of the storage, in which case they are copied in two runs
+    size_t first = static_cast<size_t>( tail % _capacity );
+    size_t run = ( std::min )( count, _capacity - first );
+    if( run )
+    {
+        std::memcpy( data_, _data.get() + ( first * _sample_length ), run * _sample_length );
+        std::copy( _timestamps.get() + first, _timestamps.get() + first + run, timestamps_ );
+    }
+    if( count > run )
+    {
+        std::memcpy( data_ + ( run * _sample_length ), _data.get(), ( count - run ) * _sample_length );
+        std::copy( _timestamps.get(), _timestamps.get() + ( count - run ), timestamps_ + run );
+    }
+
+    //releases the slots back to the producer
+    _tail.store( tail + count, std::memory_order_release );
+    return count;
+}
+
+size_t
+I2cSampleRing::available(
+    void
+    ) const
+{
+    //the tail is read first; it can only have advanced towards the head read after it
+    uint64_t tail = _tail.load( std::memory_order_acquire );
+    return static_cast<size_t>( _head.load( std::memory_order_acquire ) - tail );
+}
+
+size_t
+I2cSampleRing::capacity(
+    void
+    ) const
+{
+    return _capacity;
+}
+
+uint64_t
+I2cSampleRing::dropped(
+    void
+    ) const
+{
+    return _dropped.load( std::memory_order_relaxed );
+}
+
+size_t
+I2cSampleRing::sampleLength(
+    void
+    ) const
+{
+    return _sample_length;
+}
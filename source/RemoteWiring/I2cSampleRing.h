@@ -0,0 +1,121 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace Microsoft {
+namespace Maker {
+namespace RemoteWiring {
+namespace I2c {
+
+/*
+ * I2cSampleRing holds the replies of one continuous I2C read. Storage for every sample is allocated up front, so depositing a reply is a
+ * copy and two atomic stores with no allocation or locking; the input thread is the only producer. Consumers drain any number of samples
+ * at once, oldest first. When the ring is full new samples are dropped and counted rather than overwriting ones not yet drained.
+ */
+class I2cSampleRing
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    ///<summary>
+    ///Allocates room for capacity_ samples (at least 1) of sample_length_ bytes each.
+    ///</summary>
+    I2cSampleRing(
+        size_t capacity_,
+        size_t sample_length_
+    );
+
+    ///<summary>
+    ///Stores a sample received at timestamp_; a shorter reply is padded with zeros and a longer one truncated. Producer only.
+    ///<returns>false if the ring was full and the sample was dropped</returns>
+    ///</summary>
+    bool
+    push(
+        clock::time_point timestamp_,
+        const uint8_t *data_,
+        size_t length_
+    );
+
+    ///<summary>
+    ///Removes up to max_samples_ samples, copying their bytes back-to-back into data_ (sampleLength() bytes each) and their receive times
+    ///into timestamps_. May be called from any thread.
+    ///<returns>the number of samples removed</returns>
+    ///</summary>
+    size_t
+    drain(
+        uint8_t *data_,
+        clock::time_point *timestamps_,
+        size_t max_samples_
+    );
+
+    ///<summary>
+    ///Returns the number of samples waiting to be drained.
+    ///</summary>
+    size_t
+    available(
+        void
+    ) const;
+
+    size_t
+    capacity(
+        void
+    ) const;
+
+    uint64_t
+    dropped(
+        void
+    ) const;
+
+    size_t
+    sampleLength(
+        void
+    ) const;
+
+private:
+    const size_t _capacity;
+    const size_t _sample_length;
+    std::unique_ptr<uint8_t[]> _data;
+    std::unique_ptr<clock::time_point[]> _timestamps;
+
+    //samples written and samples drained since the ring was created; the difference is the number waiting
+    std::atomic<uint64_t> _head;
+    std::atomic<uint64_t> _tail;
+    std::atomic<uint64_t> _dropped;
+
+    //serializes consumers
+    std::mutex _drain_mutex;
+};
+
+} // namespace I2c
+} // namespace RemoteWiring
+} // namespace Maker
+} // namespace Microsoft
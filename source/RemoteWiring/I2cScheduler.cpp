@@ -0,0 +1,274 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "I2cScheduler.h"
+
+#include <algorithm>
+
+using namespace Microsoft::Maker::RemoteWiring::I2c;
+
+namespace {
+    //read/write mode bits of I2C_REQUEST
+    const uint8_t I2C_WRITE = 0x00;
+    const uint8_t I2C_READ_ONCE = 0x08;
+}
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+I2cScheduler::I2cScheduler(
+    Sender sender_,
+    size_t window_
+    ) :
+    _sender( std::move( sender_ ) ),
+    _window( ( std::max )( window_, static_cast<size_t>( 1 ) ) ),
+    _in_flight( 0 ),
+    _pumping( false ),
+    _pump_again( false ),
+    _closed( false ),
+    _requests_sent( 0 ),
+    _frames_sent( 0 )
+{
+}
+
+I2cScheduler::~I2cScheduler(
+    void
+    )
+{
+    std::deque<Queued> cancelled;
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        _closed = true;
+        cancelled.swap( _queue );
+    }
+
+    _table.cancelAll();
+    for( Queued &queued : cancelled )
+    {
+        queued.operation.completion( Result::CANCELLED, nullptr, 0 );
+    }
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+void
+I2cScheduler::setWindow(
+    size_t window_
+    )
+{
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        _window = ( std::max )( window_, static_cast<size_t>( 1 ) );
+    }
+
+    pump();
+}
+
+void
+I2cScheduler::submit(
+    std::vector<Operation> &&batch_,
+    clock::duration timeout_
+    )
+{
+    clock::time_point deadline = clock::now() + timeout_;
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        for( Operation &operation : batch_ )
+        {
+            Queued queued;
+            queued.operation = std::move( operation );
+            queued.deadline = deadline;
+            _queue.push_back( std::move( queued ) );
+        }
+    }
+
+    pump();
+}
+
+bool
+I2cScheduler::onReply(
+    uint8_t address_,
+    uint8_t reg_,
+    const uint8_t *data_,
+    size_t length_
+    )
+{
+    return _table.complete( address_, reg_, data_, length_ );
+}
+
+size_t
+I2cScheduler::expire(
+    clock::time_point now_
+    )
+{
+    std::vector<Completion> expired;
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        for( auto queued = _queue.begin(); queued != _queue.end(); )
+        {
+            if( queued->deadline > now_ ) { ++queued; continue; }
+
+            expired.push_back( std::move( queued->operation.completion ) );
+            queued = _queue.erase( queued );
+        }
+    }
+
+    for( Completion &completion : expired )
+    {
+        completion( Result::TIMED_OUT, nullptr, 0 );
+    }
+
+    //reads in flight release their window slots as they time out
+    return expired.size() + _table.expire( now_ );
+}
+
+I2cScheduler::Statistics
+I2cScheduler::statistics(
+    void
+    ) const
+{
+    std::lock_guard<std::mutex> lock( _mutex );
+
+    Statistics statistics;
+    statistics.window = _window;
+    statistics.in_flight = _in_flight;
+    statistics.queued = _queue.size();
+    statistics.requests_sent = _requests_sent;
+    statistics.frames_sent = _frames_sent;
+    return statistics;
+}
+
+//******************************************************************************
+//* Private Methods
+//******************************************************************************
+
+void
+I2cScheduler::pump(
+    void
+    )
+{
+    std::unique_lock<std::mutex> lock( _mutex );
+
+    //only one thread sends at a time so operations reach the wire in the order they were queued; a thread finding the pump busy leaves
+    //its work to the thread already running it
+    if( _pumping || _closed ) { _pump_again = true; return; }
+    _pumping = true;
+
+    do
+    {
+        _pump_again = false;
+
+        std::vector<Request> requests;
+        std::vector<Completion> written;
+        std::vector<ReadSent> reads;
+        while( !_queue.empty() && !_closed )
+        {
+            Queued &queued = _queue.front();
+            Operation &operation = queued.operation;
+
+            Request request;
+            request.address = operation.address;
+            if( operation.read_length )
+            {
+                if( _in_flight >= _window ) break;
+
+                //registered before it is sent, so the reply can never arrive ahead of it
+                ++_in_flight;
+                Completion completion = std::move( operation.completion );
+                uint64_t id = _table.add( operation.address, operation.reg, queued.deadline, [ this, completion ]( Result result_, const uint8_t *data_, size_t length_ ) -> void
+                {
+                    completion( result_, data_, length_ );
+                    release();
+                } );
+
+                ReadSent read = { operation.address, operation.reg, id };
+                reads.push_back( read );
+                request.rw_mask = I2C_READ_ONCE;
+                request.payload.push_back( operation.reg );
+                request.payload.push_back( operation.read_length );
+            }
+            else
+            {
+                written.push_back( std::move( operation.completion ) );
+                request.rw_mask = I2C_WRITE;
+                request.payload = std::move( operation.data );
+            }
+
+            requests.push_back( std::move( request ) );
+            _queue.pop_front();
+        }
+
+        if( requests.empty() ) break;
+        _requests_sent += requests.size();
+        ++_frames_sent;
+
+        lock.unlock();
+        bool sent = true;
+        try
+        {
+            _sender( requests );
+        }
+        catch( ... )
+        {
+            sent = false;
+        }
+
+        //reads which never reached the device will not be answered, so they fail now rather than time out
+        if( !sent )
+        {
+            for( const ReadSent &read : reads )
+            {
+                _table.abandon( read.address, read.reg, read.id );
+            }
+        }
+
+        for( Completion &completion : written )
+        {
+            completion( sent ? Result::COMPLETED : Result::FAILED, nullptr, 0 );
+        }
+        lock.lock();
+    } while( _pump_again );
+
+    _pumping = false;
+}
+
+void
+I2cScheduler::release(
+    void
+    )
+{
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        --_in_flight;
+    }
+
+    pump();
+}
@@ -0,0 +1,185 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "I2cTransactionTable.h"
+
+namespace Microsoft {
+namespace Maker {
+namespace RemoteWiring {
+namespace I2c {
+
+/*
+ * I2cScheduler pipelines I2C operations submitted from any number of threads onto one bus. Operations are sent in the order they were
+ * submitted, several to a frame, with up to a window of reads outstanding at once; each reply (or timeout) frees a slot and releases the
+ * next queued operation, so throughput is bounded by the bus rather than by the round trip. The window should be sized so the requests
+ * in flight fit the firmware's receive buffer. Writes are not answered and do not occupy the window; they complete once sent.
+ */
+class I2cScheduler
+{
+public:
+    typedef I2cTransactionTable::clock clock;
+    typedef I2cTransactionTable::Completion Completion;
+    typedef I2cTransactionTable::Result Result;
+
+    struct Operation
+    {
+        uint8_t address;
+        uint8_t reg;
+
+        //bytes to read from reg, or zero to write data
+        uint8_t read_length;
+        std::vector<uint8_t> data;
+
+        Completion completion;
+    };
+
+    //an I2C_REQUEST ready to be encoded: the read/write mode bits and the bytes which follow them
+    struct Request
+    {
+        uint8_t address;
+        uint8_t rw_mask;
+        std::vector<uint8_t> payload;
+    };
+
+    struct Statistics
+    {
+        size_t window;
+        size_t in_flight;
+        size_t queued;
+        uint64_t requests_sent;
+        uint64_t frames_sent;
+    };
+
+    //sends the requests back-to-back, ideally as a single frame; throws if they could not be sent, which fails their operations
+    typedef std::function<void( const std::vector<Request> &requests_ )> Sender;
+
+    I2cScheduler(
+        Sender sender_,
+        size_t window_
+    );
+
+    ///<summary>
+    ///Cancels every queued and outstanding operation.
+    ///</summary>
+    ~I2cScheduler(
+        void
+    );
+
+    ///<summary>
+    ///Sets the number of reads which may await their reply at once (at least 1); a larger window releases queued reads immediately.
+    ///</summary>
+    void
+    setWindow(
+        size_t window_
+    );
+
+    ///<summary>
+    ///Queues the operations behind everything submitted before them and sends as many as the window allows. Operations which have not
+    ///completed within timeout_, whether queued or in flight, complete as TIMED_OUT on the next call to expire().
+    ///</summary>
+    void
+    submit(
+        std::vector<Operation> &&batch_,
+        clock::duration timeout_
+    );
+
+    ///<summary>
+    ///Completes the oldest outstanding read of the register with the reply and releases the next queued operation.
+    ///<returns>false if no read of the register was outstanding</returns>
+    ///</summary>
+    bool
+    onReply(
+        uint8_t address_,
+        uint8_t reg_,
+        const uint8_t *data_,
+        size_t length_
+    );
+
+    ///<summary>
+    ///Times out every operation whose deadline has passed.
+    ///</summary>
+    size_t
+    expire(
+        clock::time_point now_
+    );
+
+    Statistics
+    statistics(
+        void
+    ) const;
+
+private:
+    struct Queued
+    {
+        Operation operation;
+        clock::time_point deadline;
+    };
+
+    //a read registered with the table, which is abandoned if its request could not be sent
+    struct ReadSent
+    {
+        uint8_t address;
+        uint8_t reg;
+        uint64_t id;
+    };
+
+    Sender _sender;
+
+    //everything below is guarded by _mutex
+    mutable std::mutex _mutex;
+    std::deque<Queued> _queue;
+    size_t _window;
+    size_t _in_flight;
+    bool _pumping;
+    bool _pump_again;
+    bool _closed;
+    uint64_t _requests_sent;
+    uint64_t _frames_sent;
+
+    //declared last so that completions, which release window slots, never outlive the members they use
+    I2cTransactionTable _table;
+
+    void
+    pump(
+        void
+    );
+
+    void
+    release(
+        void
+    );
+};
+
+} // namespace I2c
+} // namespace RemoteWiring
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,238 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "I2cTransactionTable.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace Microsoft::Maker::RemoteWiring::I2c;
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+I2cTransactionTable::I2cTransactionTable(
+    void
+    ) :
+    _outstanding( 0 ),
+    _next_id( 0 )
+{
+}
+
+I2cTransactionTable::~I2cTransactionTable(
+    void
+    )
+{
+    cancelAll();
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+uint64_t
+I2cTransactionTable::add(
+    uint8_t address_,
+    uint8_t reg_,
+    clock::time_point deadline_,
+    Completion completion_
+    )
+{
+    Transaction transaction;
+    transaction.deadline = deadline_;
+    transaction.completion = std::move( completion_ );
+    transaction.reply_discarded = false;
+
+    std::lock_guard<std::mutex> lock( _mutex );
+    uint64_t id = _next_id++;
+    transaction.id = id;
+    _transactions[keyFor( address_, reg_ )].push_back( std::move( transaction ) );
+    ++_outstanding;
+    return id;
+}
+
+bool
+I2cTransactionTable::abandon(
+    uint8_t address_,
+    uint8_t reg_,
+    uint64_t id_
+    )
+{
+    Completion completion;
+    uint16_t key = keyFor( address_, reg_ );
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        auto entry = _transactions.find( key );
+        std::deque<Transaction>::iterator transaction;
+        if( entry != _transactions.end() )
+        {
+            transaction = std::find_if( entry->second.begin(), entry->second.end(), [ id_ ]( const Transaction &transaction_ ) -> bool { return transaction_.id == id_; } );
+        }
+
+        if( entry == _transactions.end() || transaction == entry->second.end() )
+        {
+            //the read timed out while it was being sent, and counted on a reply which will never come
+            auto late = _late_replies.find( key );
+            if( late != _late_replies.end() && !--late->second ) { _late_replies.erase( late ); }
+            return false;
+        }
+
+        completion = std::move( transaction->completion );
+        entry->second.erase( transaction );
+        if( entry->second.empty() ) { _transactions.erase( entry ); }
+        --_outstanding;
+    }
+
+    completion( Result::FAILED, nullptr, 0 );
+    return true;
+}
+
+bool
+I2cTransactionTable::complete(
+    uint8_t address_,
+    uint8_t reg_,
+    const uint8_t *data_,
+    size_t length_
+    )
+{
+    Completion completion;
+    uint16_t key = keyFor( address_, reg_ );
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        auto entry = _transactions.find( key );
+
+        //replies arrive in the order they were requested, so a reply owed to a read which timed out comes before any other
+        auto late = _late_replies.find( key );
+        if( late != _late_replies.end() )
+        {
+            if( !--late->second ) { _late_replies.erase( late ); }
+            if( entry != _transactions.end() ) { entry->second.front().reply_discarded = true; }
+            return true;
+        }
+
+        if( entry == _transactions.end() ) return false;
+
+        completion = std::move( entry->second.front().completion );
+        entry->second.pop_front();
+        if( entry->second.empty() ) { _transactions.erase( entry ); }
+        --_outstanding;
+    }
+
+    completion( Result::COMPLETED, data_, length_ );
+    return true;
+}
+
+size_t
+I2cTransactionTable::expire(
+    clock::time_point now_
+    )
+{
+    std::vector<Completion> expired;
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        if( !_outstanding ) return 0;
+
+        for( auto entry = _transactions.begin(); entry != _transactions.end(); )
+        {
+            std::deque<Transaction> &fifo = entry->second;
+            for( auto transaction = fifo.begin(); transaction != fifo.end(); )
+            {
+                if( transaction->deadline > now_ ) { ++transaction; continue; }
+
+                //the reply is still on its way and must not complete the next read of the register, unless it was already discarded
+                //in place of a lost reply
+                if( !transaction->reply_discarded ) { ++_late_replies[entry->first]; }
+
+                expired.push_back( std::move( transaction->completion ) );
+                transaction = fifo.erase( transaction );
+                --_outstanding;
+            }
+
+            entry = fifo.empty() ? _transactions.erase( entry ) : std::next( entry );
+        }
+    }
+
+    for( Completion &completion : expired )
+    {
+        completion( Result::TIMED_OUT, nullptr, 0 );
+    }
+
+    return expired.size();
+}
+
+size_t
+I2cTransactionTable::cancelAll(
+    void
+    )
+{
+    std::unordered_map<uint16_t, std::deque<Transaction>> cancelled;
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _mutex );
+        cancelled.swap( _transactions );
+        _outstanding = 0;
+
+        //replies to reads sent before the cancellation are not expected any more
+        _late_replies.clear();
+    }
+
+    size_t count = 0;
+    for( auto &entry : cancelled )
+    {
+        for( Transaction &transaction : entry.second )
+        {
+            transaction.completion( Result::CANCELLED, nullptr, 0 );
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+size_t
+I2cTransactionTable::outstanding(
+    void
+    ) const
+{
+    std::lock_guard<std::mutex> lock( _mutex );
+    return _outstanding;
+}
+
+//******************************************************************************
+//* Private Methods
+//******************************************************************************
+
+uint16_t
+I2cTransactionTable::keyFor(
+    uint8_t address_,
+    uint8_t reg_
+    )
+{
+    return static_cast<uint16_t>( ( address_ << 8 ) | reg_ );
+}
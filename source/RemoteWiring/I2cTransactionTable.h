@@ -0,0 +1,164 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace Microsoft {
+namespace Maker {
+namespace RemoteWiring {
+namespace I2c {
+
+/*
+ * I2cTransactionTable correlates I2C replies with the reads which requested them. Firmata answers a one-time read with a reply carrying
+ * the device address and register it was read from, and replies to the same address and register arrive in the order they were requested,
+ * so outstanding reads are kept in one FIFO per (address, register) and each reply completes the oldest read in its FIFO. Reads to
+ * different devices or registers can therefore be in flight at the same time. Completions are invoked outside the table's lock.
+ * Firmata answers every read, so a read which times out still has a reply on the way. The table counts those replies per register and
+ * discards them when they arrive, rather than completing the next read of the register with stale data. Should a reply be lost
+ * altogether, the reply discarded in its place belongs to the next read; that read then times out without leaving a reply owed.
+ */
+class I2cTransactionTable
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    enum class Result
+    {
+        COMPLETED,
+        TIMED_OUT,
+        CANCELLED,
+        //the request could not be sent
+        FAILED,
+    };
+
+    //data_ and length_ describe the reply when the result is COMPLETED, and are empty otherwise
+    typedef std::function<void( Result result_, const uint8_t *data_, size_t length_ )> Completion;
+
+    I2cTransactionTable(
+        void
+    );
+
+    ///<summary>
+    ///Cancels every outstanding read.
+    ///</summary>
+    ~I2cTransactionTable(
+        void
+    );
+
+    ///<summary>
+    ///Registers a read of the given register which times out at deadline_. Must be called before the request is sent.
+    ///<returns>an identifier for the read, which abandon() takes if the request could not be sent</returns>
+    ///</summary>
+    uint64_t
+    add(
+        uint8_t address_,
+        uint8_t reg_,
+        clock::time_point deadline_,
+        Completion completion_
+    );
+
+    ///<summary>
+    ///Completes the read, whose request could not be sent, as FAILED; no reply is expected for it any more.
+    ///<returns>false if the read had already timed out or been cancelled</returns>
+    ///</summary>
+    bool
+    abandon(
+        uint8_t address_,
+        uint8_t reg_,
+        uint64_t id_
+    );
+
+    ///<summary>
+    ///Completes the oldest outstanding read of the register with the reply, or discards the reply if it answers a read which timed out.
+    ///<returns>false if the reply answers no read, outstanding or timed out</returns>
+    ///</summary>
+    bool
+    complete(
+        uint8_t address_,
+        uint8_t reg_,
+        const uint8_t *data_,
+        size_t length_
+    );
+
+    ///<summary>
+    ///Times out every read whose deadline has passed.
+    ///<returns>the number of reads timed out</returns>
+    ///</summary>
+    size_t
+    expire(
+        clock::time_point now_
+    );
+
+    ///<summary>
+    ///Cancels every outstanding read.
+    ///</summary>
+    size_t
+    cancelAll(
+        void
+    );
+
+    size_t
+    outstanding(
+        void
+    ) const;
+
+private:
+    struct Transaction
+    {
+        uint64_t id;
+        clock::time_point deadline;
+        Completion completion;
+
+        //a reply arrived while this was the oldest read, but was discarded as the answer to a read which had timed out
+        bool reply_discarded;
+    };
+
+    mutable std::mutex _mutex;
+    std::unordered_map<uint16_t, std::deque<Transaction>> _transactions;
+    size_t _outstanding;
+    uint64_t _next_id;
+
+    //replies still owed to reads which timed out, by (address, register)
+    std::unordered_map<uint16_t, size_t> _late_replies;
+
+    static
+    uint16_t
+    keyFor(
+        uint8_t address_,
+        uint8_t reg_
+    );
+};
+
+} // namespace I2c
+} // namespace RemoteWiring
+} // namespace Maker
+} // namespace Microsoft
@@ -0,0 +1,154 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "pch.h"
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace Microsoft::Maker::RemoteWiring;
+
+//******************************************************************************
+//* Constructors
+//******************************************************************************
+
+LatencyHistogram::LatencyHistogram(
+    void
+    )
+{
+    reset();
+}
+
+//******************************************************************************
+//* Public Methods
+//******************************************************************************
+
+void
+LatencyHistogram::record(
+    clock::duration latency_
+    )
+{
+    int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>( latency_ ).count();
+    uint64_t value = ( nanoseconds > 0 ) ? static_cast<uint64_t>( nanoseconds ) : 0;
+
+    _buckets[bucketIndex( value )].fetch_add( 1, std::memory_order_relaxed );
+    _sum_ns.fetch_add( value, std::memory_order_relaxed );
+
+    uint64_t current = _min_ns.load( std::memory_order_relaxed );
+    while( value < current && !_min_ns.compare_exchange_weak( current, value, std::memory_order_relaxed ) );
+
+    current = _max_ns.load( std::memory_order_relaxed );
+    while( value > current && !_max_ns.compare_exchange_weak( current, value, std::memory_order_relaxed ) );
+
+    //the count is published last, so a snapshot never reports more values than its buckets hold
+    _count.fetch_add( 1, std::memory_order_release );
+}
+
+void
+LatencyHistogram::reset(
+    void
+    )
+{
+    for( std::atomic<uint64_t> &bucket : _buckets ) { bucket.store( 0, std::memory_order_relaxed ); }
+    _count.store( 0, std::memory_order_relaxed );
+    _min_ns.store( ( std::numeric_limits<uint64_t>::max )(), std::memory_order_relaxed );
+    _max_ns.store( 0, std::memory_order_relaxed );
+    _sum_ns.store( 0, std::memory_order_relaxed );
+}
+
+void
+LatencyHistogram::snapshot(
+    Snapshot &snapshot_
+    ) const
+{
+    snapshot_.count = _count.load( std::memory_order_acquire );
+    for( size_t i = 0; i < BUCKET_COUNT; ++i ) { snapshot_.buckets[i] = _buckets[i].load( std::memory_order_relaxed ); }
+    snapshot_.sum_ns = _sum_ns.load( std::memory_order_relaxed );
+    snapshot_.max_ns = _max_ns.load( std::memory_order_relaxed );
+    snapshot_.min_ns = snapshot_.count ? _min_ns.load( std::memory_order_relaxed ) : 0;
+}
+
+double
+LatencyHistogram::Snapshot::meanNanoseconds(
+    void
+    ) const
+{
+    return count ? static_cast<double>( sum_ns ) / count : 0.0;
+}
+
+uint64_t
+LatencyHistogram::Snapshot::percentileNanoseconds(
+    double fraction_
+    ) const
+{
+    if( !count ) return 0;
+
+    fraction_ = ( std::min )( ( std::max )( fraction_, 0.0 ), 1.0 );
+    uint64_t rank = ( std::max )( static_cast<uint64_t>( fraction_ * count + 0.5 ), static_cast<uint64_t>( 1 ) );
+
+    uint64_t seen = 0;
+    for( size_t i = 0; i < BUCKET_COUNT; ++i )
+    {
+        seen += buckets[i];
+        if( seen >= rank )
+        {
+            //report the top of the bucket, but never beyond the values actually observed
+            return ( std::max )( ( std::min )( LatencyHistogram::bucketLimit( i ), max_ns ), min_ns );
+        }
+    }
+    return max_ns;
+}
+
+//******************************************************************************
+//* Private Methods
+//******************************************************************************
+
+size_t
+LatencyHistogram::bucketIndex(
+    uint64_t value_ns_
+    )
+{
+    if( value_ns_ < SUB_BUCKETS ) return static_cast<size_t>( value_ns_ );
+
+    //find the most significant bit; the SUB_BUCKET_BITS bits below it select the bucket within that power of two
+    size_t msb = 0;
+    for( uint64_t value = value_ns_; value >>= 1; ) { ++msb; }
+    if( msb >= MAX_VALUE_BITS ) return BUCKET_COUNT - 1;
+
+    size_t sub_bucket = static_cast<size_t>( value_ns_ >> ( msb - SUB_BUCKET_BITS ) ) - SUB_BUCKETS;
+    return ( msb - SUB_BUCKET_BITS + 1 ) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t
+LatencyHistogram::bucketLimit(
+    size_t index_
+    )
+{
+    if( index_ < SUB_BUCKETS ) return index_;
+
+    size_t shift = index_ / SUB_BUCKETS - 1;
+    uint64_t mantissa = SUB_BUCKETS + ( index_ % SUB_BUCKETS );
+    return ( ( mantissa + 1 ) << shift ) - 1;
+}
@@ -0,0 +1,205 @@
+/*
+    Copyright(c) Microsoft Open Technologies, Inc. All rights reserved.
+
+    The MIT License(MIT)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files(the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions :
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace Microsoft {
+namespace Maker {
+namespace RemoteWiring {
+
+/*
+ * LatencyHistogram records durations into log-linear buckets in the manner of an HDR histogram: every power of two is split into
+ * SUB_BUCKETS equal buckets, so any recorded value is reported within 1 / SUB_BUCKETS (about 3%) of its true value while the whole
+ * range from nanoseconds to minutes fits in a fixed array. record() is lock-free and wait-free apart from the min/max updates, so it
+ * can be called from the input thread and from API calls concurrently.
+ */
+class LatencyHistogram
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    static const size_t SUB_BUCKET_BITS = 5;
+    static const size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+    //the largest value kept distinct, about 37 minutes in nanoseconds; larger values are counted in the last bucket
+    static const size_t MAX_VALUE_BITS = 41;
+    static const size_t BUCKET_COUNT = ( MAX_VALUE_BITS - SUB_BUCKET_BITS + 1 ) * SUB_BUCKETS;
+
+    /*
+     * A copy of the histogram taken at one moment. The copy is not atomic as a whole; a value recorded while it is taken may be
+     * counted in the buckets but not yet in the totals, or vice versa.
+     */
+    struct Snapshot
+    {
+        uint64_t count;
+        uint64_t min_ns;
+        uint64_t max_ns;
+        uint64_t sum_ns;
+        std::array<uint64_t, BUCKET_COUNT> buckets;
+
+        double
+        meanNanoseconds(
+            void
+        ) const;
+
+        ///<summary>
+        ///Returns the value below which the given fraction (0.0 - 1.0) of recorded values fall, or zero if nothing was recorded.
+        ///</summary>
+        uint64_t
+        percentileNanoseconds(
+            double fraction_
+        ) const;
+    };
+
+    LatencyHistogram(
+        void
+    );
+
+    void
+    record(
+        clock::duration latency_
+    );
+
+    void
+    reset(
+        void
+    );
+
+    void
+    snapshot(
+        Snapshot &snapshot_
+    ) const;
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> _buckets;
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _min_ns;
+    std::atomic<uint64_t> _max_ns;
+    std::atomic<uint64_t> _sum_ns;
+
+    static
+    size_t
+    bucketIndex(
+        uint64_t value_ns_
+    );
+
+    //the largest value counted in the given bucket
+    static
+    uint64_t
+    bucketLimit(
+        size_t index_
+    );
+};
+
+/*
+ * PendingRequest holds the time an outstanding request was sent, until the response to it is observed. Only the earliest
+ * unanswered request is timed, so a burst of requests answered by a single response measures the latency of the first.
+ */
+class PendingRequest
+{
+public:
+    PendingRequest(
+        void
+    ) :
+        _sent( 0 )
+    {
+    }
+
+    ///<summary>
+    ///Notes that a request was sent at now_, unless an earlier one is still awaiting its response.
+    ///</summary>
+    inline
+    void
+    mark(
+        LatencyHistogram::clock::time_point now_
+    )
+    {
+        int64_t expected = 0;
+        _sent.compare_exchange_strong( expected, ticks( now_ ), std::memory_order_relaxed );
+    }
+
+    ///<summary>
+    ///Returns true if a request is awaiting its response, and when it was sent.
+    ///</summary>
+    inline
+    bool
+    outstanding(
+        LatencyHistogram::clock::time_point &sent_
+    ) const
+    {
+        int64_t sent = _sent.load( std::memory_order_relaxed );
+        sent_ = LatencyHistogram::clock::time_point( LatencyHistogram::clock::duration( sent - 1 ) );
+        return sent != 0;
+    }
+
+    ///<summary>
+    ///Forgets any outstanding request, for example one whose response has been lost.
+    ///</summary>
+    inline
+    void
+    clear(
+        void
+    )
+    {
+        _sent.store( 0, std::memory_order_relaxed );
+    }
+
+    ///<summary>
+    ///Completes the outstanding request, if any, recording the time since it was sent into histogram_.
+    ///</summary>
+    inline
+    void
+    complete(
+        LatencyHistogram::clock::time_point now_,
+        LatencyHistogram &histogram_
+    )
+    {
+        int64_t sent = _sent.exchange( 0, std::memory_order_relaxed );
+        if( sent ) { histogram_.record( now_.time_since_epoch() - LatencyHistogram::clock::duration( sent - 1 ) ); }
+    }
+
+private:
+    //clock ticks since the epoch plus one, so that zero can mean no request is outstanding
+    std::atomic<int64_t> _sent;
+
+    static
+    inline
+    int64_t
+    ticks(
+        LatencyHistogram::clock::time_point time_
+    )
+    {
+        return static_cast<int64_t>( time_.time_since_epoch().count() ) + 1;
+    }
+};
+
+} // namespace RemoteWiring
+} // namespace Maker
+} // namespace Microsoft
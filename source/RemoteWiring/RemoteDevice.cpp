@@ -31,6 +31,58 @@ using namespace Microsoft::Maker;
 using namespace Microsoft::Maker::Firmata;
 using namespace Microsoft::Maker::RemoteWiring;
 
+namespace {
+    //indices into _events_raised, in the order DeviceMetrics expects
+    const size_t DIGITAL_PIN_EVENTS = 0;
+    const size_t ANALOG_PIN_EVENTS = 1;
+    const size_t SYSEX_MESSAGE_EVENTS = 2;
+    const size_t STRING_MESSAGE_EVENTS = 3;
+
+    //coalesced report slots keep a 48-bit sequence number above the 16-bit reported value; at one report per microsecond the sequence
+    //takes almost nine years to wrap, so the difference between two sequences is always the exact number of reports in between
+    inline uint64_t packReport( uint64_t sequence_, uint16_t value_ ) { return ( sequence_ << 16 ) | value_; }
+    inline uint64_t reportSequence( uint64_t slot_ ) { return slot_ >> 16; }
+    inline uint16_t reportValue( uint64_t slot_ ) { return static_cast<uint16_t>( slot_ & 0xFFFF ); }
+}
+
+//******************************************************************************
+//* DeviceMetrics
+//******************************************************************************
+
+Platform::String ^
+DeviceMetrics::toText(
+    void
+    )
+{
+    wchar_t text[640];
+    swprintf_s( text, L"%-40ls %llu\n%-40ls %llu\n%-40ls %llu\n%-40ls %llu\n%-40ls %llu\n%-40ls %llu\n%-40ls %llu\n%-40ls %llu\n%-40ls %llu\n",
+        L"device.digital_pin_events", _digital_pin_events,
+        L"device.analog_pin_events", _analog_pin_events,
+        L"device.sysex_message_events", _sysex_message_events,
+        L"device.string_message_events", _string_message_events,
+        L"device.lock_acquisitions", _lock_acquisitions,
+        L"device.lock_contentions", _lock_contentions,
+        L"device.lock_wait_ns", _lock_wait_ns,
+        L"device.reconnects", _reconnects,
+        L"device.last_restore_ns", _last_restore_ns );
+
+    return ref new Platform::String( text ) + _connection->toText();
+}
+
+Platform::String ^
+DeviceMetrics::toJson(
+    void
+    )
+{
+    wchar_t json[640];
+    swprintf_s( json, L"{\"device\":{\"digital_pin_events\":%llu,\"analog_pin_events\":%llu,\"sysex_message_events\":%llu,\"string_message_events\":%llu,"
+        L"\"lock_acquisitions\":%llu,\"lock_contentions\":%llu,\"lock_wait_ns\":%llu,\"reconnects\":%llu,\"last_restore_ns\":%llu},\"connection\":",
+        _digital_pin_events, _analog_pin_events, _sysex_message_events, _string_message_events, _lock_acquisitions, _lock_contentions, _lock_wait_ns,
+        _reconnects, _last_restore_ns );
+
+    return ref new Platform::String( json ) + _connection->toJson() + L"}";
+}
+
 //******************************************************************************
 //* Constructors / Destructors
 //******************************************************************************
@@ -40,8 +92,46 @@ RemoteDevice::RemoteDevice(
     ) :
     _initialized( ATOMIC_VAR_INIT(false) ),
     _firmata( ref new Firmata::UwpFirmata ),
+    _serial_connection( serial_connection_ ),
     _twoWire( nullptr ),
-    _hardwareProfile( nullptr )
+    _hardwareProfile( nullptr ),
+    _suppress_redundant_commands( false ),
+    _suppressed_commands( 0 ),
+    _report_delivery_mode( ReportDeliveryMode::IMMEDIATE ),
+    _analog_reports_pending( 0 ),
+    _digital_reports_pending( 0 ),
+    _report_delivery_scheduled( false ),
+    _coalesced_reports( 0 ),
+    _probe_should_exit( false ),
+    _probe_interval( 0 ),
+    _events_raised(),
+    _sampling_interval( DEFAULT_SAMPLING_INTERVAL_MILLIS ),
+    _sampling_interval_sent( false ),
+    _sampling_timer( nullptr ),
+    _sampling_target_bytes_per_second( 0.0 ),
+    _min_sampling_interval( 1 ),
+    _max_sampling_interval( MAX_SAMPLING_INTERVAL_MILLIS ),
+    _sampled_bytes( 0 ),
+    _auto_reconnect( false ),
+    _reconnect_baud( 0 ),
+    _reconnect_config( Serial::SerialConfig::SERIAL_8N1 ),
+    _reconnect_timer( nullptr ),
+    _restore_pending( false ),
+    _reconnects( 0 ),
+    _last_restore_ns( 0 ),
+    _firmware_replies( 0 ),
+    _firmware_major( 0 ),
+    _firmware_minor( 0 ),
+    _profile_cache( nullptr ),
+    _profile_verified( false ),
+    _profile_stored( false ),
+    _handshake_firmware_ns( 0 ),
+    _handshake_capability_ns( 0 ),
+    _handshake_ready_ns( 0 ),
+    _capability_queries( 0 ),
+    _handshake_from_cache( false ),
+    _handshake_subscribed( false ),
+    _reports_subscribed( false )
 {
     //subscribe to all relevant connection changes from our new Firmata object and then attach the given IStream object
     _firmata->FirmataConnectionReady += ref new Firmata::FirmataConnectionCallback( this, &Microsoft::Maker::RemoteWiring::RemoteDevice::onConnectionReady );
@@ -55,8 +145,46 @@ RemoteDevice::RemoteDevice(
     ) :
     _initialized( ATOMIC_VAR_INIT(false) ),
     _firmata( firmata_ ),
+    _serial_connection( nullptr ),
     _twoWire( nullptr ),
-    _hardwareProfile( nullptr )
+    _hardwareProfile( nullptr ),
+    _suppress_redundant_commands( false ),
+    _suppressed_commands( 0 ),
+    _report_delivery_mode( ReportDeliveryMode::IMMEDIATE ),
+    _analog_reports_pending( 0 ),
+    _digital_reports_pending( 0 ),
+    _report_delivery_scheduled( false ),
+    _coalesced_reports( 0 ),
+    _probe_should_exit( false ),
+    _probe_interval( 0 ),
+    _events_raised(),
+    _sampling_interval( DEFAULT_SAMPLING_INTERVAL_MILLIS ),
+    _sampling_interval_sent( false ),
+    _sampling_timer( nullptr ),
+    _sampling_target_bytes_per_second( 0.0 ),
+    _min_sampling_interval( 1 ),
+    _max_sampling_interval( MAX_SAMPLING_INTERVAL_MILLIS ),
+    _sampled_bytes( 0 ),
+    _auto_reconnect( false ),
+    _reconnect_baud( 0 ),
+    _reconnect_config( Serial::SerialConfig::SERIAL_8N1 ),
+    _reconnect_timer( nullptr ),
+    _restore_pending( false ),
+    _reconnects( 0 ),
+    _last_restore_ns( 0 ),
+    _firmware_replies( 0 ),
+    _firmware_major( 0 ),
+    _firmware_minor( 0 ),
+    _profile_cache( nullptr ),
+    _profile_verified( false ),
+    _profile_stored( false ),
+    _handshake_firmware_ns( 0 ),
+    _handshake_capability_ns( 0 ),
+    _handshake_ready_ns( 0 ),
+    _capability_queries( 0 ),
+    _handshake_from_cache( false ),
+    _handshake_subscribed( false ),
+    _reports_subscribed( false )
 {
     //since the UwpFirmata object is provided, we need to lock its state & verify it is not already in a connected state
     _firmata->lock();
@@ -81,6 +209,9 @@ RemoteDevice::~RemoteDevice(
     void
     )
 {
+    disableAutoReconnect();
+    disableAdaptiveSampling();
+    stopLatencyProbe();
     _firmata->finish();
 }
 
@@ -98,7 +229,7 @@ RemoteDevice::analogRead(
 	uint8_t parsed_pin = parsePinFromAnalogString( analog_pin_ );
 
     {   //critical section 
-        std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+        std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
 
         //verify that we were given a valid analog pin number, parsePinFromAnalogString returns -1 as uint if the string is invalid, so this will catch both cases
         if( !_initialized || parsed_pin >= _hardwareProfile->AnalogPinCount )
@@ -135,9 +266,9 @@ RemoteDevice::analogWrite(
     )
 {
     //critical section equivalent to function scope
-    std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+    std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
 
-    if( !_initialized )
+    if( !_initialized || pin_ >= MAX_PINS )
     {
         return;
     }
@@ -151,6 +282,13 @@ RemoteDevice::analogWrite(
 
     if( _pin_mode[pin_] == static_cast<uint8_t>( PinMode::PWM ) || _pin_mode[pin_] == static_cast<uint8_t>( PinMode::SERVO ) )
     {
+        //saturate at the largest value the pin's resolution can represent, rather than letting the device drop the high bits
+        uint8_t resolution = ( _pin_mode[pin_] == static_cast<uint8_t>( PinMode::PWM ) ) ? _hardwareProfile->getPwmResolution( pin_ ) : _hardwareProfile->getServoResolution( pin_ );
+        if( resolution && resolution < 16 )
+        {
+            value_ = ( std::min )( value_, static_cast<uint16_t>( ( 1 << resolution ) - 1 ) );
+        }
+
         _firmata->sendAnalog( pin_, value_ );
     }
 }
@@ -166,7 +304,7 @@ RemoteDevice::digitalRead(
     getPinMap( pin_, &port, &port_mask );
 
     {   //critical section
-        std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+        std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
 
         if( !_initialized )
         {
@@ -203,7 +341,7 @@ RemoteDevice::digitalWrite(
     getPinMap( pin_, &port, &port_mask );
 
     {   //critical section
-        std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+        std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
 
         if( !_initialized )
         {
@@ -232,17 +370,174 @@ RemoteDevice::digitalWrite(
             _digital_port[port] &= ~port_mask;
         }
 
+        //input bits are only echoed back to the device, so only a change to an output bit makes the message worth sending
+        uint8_t output_mask = ~_subscribed_ports[port];
+        if( _suppress_redundant_commands && _digital_port_sent[port] >= 0 && !( ( _digital_port[port] ^ _digital_port_sent[port] ) & output_mask ) )
+        {
+            ++_suppressed_commands;
+            return;
+        }
+
         _firmata->sendDigitalPort( port, _digital_port[port] );
+        _digital_port_sent[port] = _digital_port[port];
+    }
+}
+
+void
+RemoteDevice::disableAdaptiveSampling(
+    void
+    )
+{
+    std::lock_guard<std::mutex> lock( _sampling_mutex );
+    if( _sampling_timer != nullptr )
+    {
+        _sampling_timer->Cancel();
+        _sampling_timer = nullptr;
+    }
+}
+
+void
+RemoteDevice::disableAutoReconnect(
+    void
+    )
+{
+    std::lock_guard<std::mutex> lock( _reconnect_mutex );
+    _auto_reconnect = false;
+    if( _reconnect_timer != nullptr )
+    {
+        _reconnect_timer->Cancel();
+        _reconnect_timer = nullptr;
     }
 }
 
+void
+RemoteDevice::enableAdaptiveSampling(
+    uint32_t link_bytes_per_second_,
+    double target_utilization_,
+    uint16_t min_interval_millis_,
+    uint16_t max_interval_millis_
+    )
+{
+    disableAdaptiveSampling();
+    if( !link_bytes_per_second_ || target_utilization_ <= 0.0 ) return;
+
+    std::lock_guard<std::mutex> lock( _sampling_mutex );
+
+    _sampling_target_bytes_per_second = link_bytes_per_second_ * ( std::min )( target_utilization_, 1.0 );
+    _min_sampling_interval = ( std::max )( min_interval_millis_, static_cast<uint16_t>( 1 ) );
+    _max_sampling_interval = ( std::min )( ( std::max )( max_interval_millis_, _min_sampling_interval ), static_cast<uint16_t>( MAX_SAMPLING_INTERVAL_MILLIS ) );
+
+    //traffic is measured from now on
+    _sampled_bytes = _firmata->getMetrics()->BytesReceived;
+    _sampled_time = std::chrono::steady_clock::now();
+
+    Windows::Foundation::TimeSpan period;
+    period.Duration = 10000000LL;   //one second, in 100 nanosecond units
+    _sampling_timer = Windows::System::Threading::ThreadPoolTimer::CreatePeriodicTimer( ref new Windows::System::Threading::TimerElapsedHandler( [ this ]( Windows::System::Threading::ThreadPoolTimer ^timer_ ) -> void { adaptSamplingInterval(); } ), period );
+}
+
+void
+RemoteDevice::enableAutoReconnect(
+    uint32_t baud_,
+    Serial::SerialConfig config_,
+    uint32_t retry_interval_millis_
+    )
+{
+    if( _serial_connection == nullptr || !retry_interval_millis_ ) return;
+
+    std::lock_guard<std::mutex> lock( _reconnect_mutex );
+    _auto_reconnect = true;
+    _reconnect_baud = baud_;
+    _reconnect_config = config_;
+    _reconnect_interval.Duration = static_cast<int64_t>( retry_interval_millis_ ) * 10000LL;   //100 nanosecond units
+}
+
+bool
+RemoteDevice::enableHardwareProfileCache(
+    Platform::String ^path_
+    )
+{
+    if( path_ == nullptr ) return false;
+
+    std::shared_ptr<HardwareProfileCache> cache( new HardwareProfileCache() );
+    bool loaded = cache->open( path_->Data() );
+
+    std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
+    _profile_cache = std::move( cache );
+    _profile_stored = false;
+    return loaded;
+}
+
+DeviceMetrics ^
+RemoteDevice::getMetrics(
+    void
+    )
+{
+    std::array<uint64_t, 4> events_raised;
+    for( size_t i = 0; i < events_raised.size(); ++i ) { events_raised[i] = _events_raised[i].load( std::memory_order_relaxed ); }
+
+    return ref new DeviceMetrics( events_raised, _device_mutex.statistics(), _reconnects, _last_restore_ns, _firmata->getMetrics() );
+}
+
+HandshakeStatistics ^
+RemoteDevice::getHandshakeStatistics(
+    void
+    )
+{
+    std::lock_guard<std::mutex> lock( _handshake_mutex );
+    return ref new HandshakeStatistics( _capability_queries, _handshake_firmware_ns, _handshake_capability_ns, _handshake_ready_ns, _handshake_from_cache );
+}
+
+LatencyStatistics ^
+RemoteDevice::getLatencyStatistics(
+    LatencyMetric metric_
+    )
+{
+    std::unique_ptr<LatencyHistogram::Snapshot> snapshot( new LatencyHistogram::Snapshot() );
+
+    if( metric_ == LatencyMetric::I2C_REQUEST_TO_REPLY )
+    {
+        if( _twoWire != nullptr ) { _twoWire->_request_latency.snapshot( *snapshot ); }
+    }
+    else if( static_cast<size_t>( metric_ ) < DEVICE_LATENCY_METRIC_COUNT )
+    {
+        _latency[static_cast<size_t>( metric_ )].snapshot( *snapshot );
+    }
+
+    return ref new LatencyStatistics( *snapshot );
+}
+
+uint16_t
+RemoteDevice::getSamplingInterval(
+    void
+    )
+{
+    return _sampling_interval;
+}
+
+uint64_t
+RemoteDevice::getSuppressedCommandCount(
+    void
+    )
+{
+    return _suppressed_commands;
+}
+
+uint64_t
+RemoteDevice::getCoalescedReportCount(
+    void
+    )
+{
+    return _coalesced_reports;
+}
+
 PinMode
 RemoteDevice::getPinMode(
     uint8_t pin_
     )
 {
     //critical section equivalent to function scope
-    std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+    std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
     return static_cast<PinMode>( _pin_mode[ pin_ ].load() );
 }
 
@@ -271,7 +566,7 @@ RemoteDevice::pinMode(
     getPinMap( pin_, &port, &port_mask );
 
     {   //critical section
-        std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+        std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
 
         //verify we're initialized properly and the requested pin mode is supported by this pin
         if( !( _initialized && isModeSupported( pin_, mode_ ) ) )
@@ -279,6 +574,12 @@ RemoteDevice::pinMode(
             return;
         }
 
+        if( _suppress_redundant_commands && _pin_mode_sent[pin_] && _pin_mode[pin_] == static_cast<uint8_t>( mode_ ) )
+        {
+            ++_suppressed_commands;
+            return;
+        }
+
         _firmata->lock();
         try
         {
@@ -291,15 +592,15 @@ RemoteDevice::pinMode(
             {
                 _subscribed_ports[port] |= port_mask;
                 _firmata->write( static_cast<uint8_t>( Firmata::Command::REPORT_DIGITAL_PIN ) | ( port & 0x0F ) );
-                _firmata->write( _subscribed_ports[port] );
+                _firmata->write( 1 );
             }
             //if the selected mode is NOT input and we WERE subscribed to it, unsubscribe
             else if( _pin_mode[pin_] == static_cast<uint8_t>( PinMode::INPUT ) )
             {
-                //make sure we aren't subscribed to this port
+                //the port is reported as a whole, so it stays subscribed while any of its other pins is an input
                 _subscribed_ports[port] &= ~port_mask;
                 _firmata->write( static_cast<uint8_t>( Firmata::Command::REPORT_DIGITAL_PIN ) | ( port & 0x0F ) );
-                _firmata->write( _subscribed_ports[port] );
+                _firmata->write( _subscribed_ports[port] ? 1 : 0 );
             }
             _firmata->flush();
         }
@@ -320,6 +621,7 @@ RemoteDevice::pinMode(
 
         //finally, update the cached pin mode
         _pin_mode[pin_] = static_cast<uint8_t>( mode_ );
+        _pin_mode_sent[pin_] = true;
     }
 }
 
@@ -338,6 +640,108 @@ RemoteDevice::pinMode(
     pinMode( parsed_pin + _hardwareProfile->AnalogOffset, mode_ );
 }
 
+void
+RemoteDevice::refreshDeviceState(
+    void
+    )
+{
+    //critical section equivalent to function scope
+    std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
+
+    if( !_initialized )
+    {
+        return;
+    }
+
+    _firmata->lock();
+    try
+    {
+        writeDeviceState();
+        _firmata->flush();
+    }
+    catch( ... )
+    {
+        //something has gone wrong, any fatal errors should be evented, so we need to exit this function
+        _firmata->unlock();
+        return;
+    }
+
+    _firmata->unlock();
+}
+
+void
+RemoteDevice::resetLatencyStatistics(
+    void
+    )
+{
+    for( LatencyHistogram &histogram : _latency ) { histogram.reset(); }
+    if( _twoWire != nullptr ) { _twoWire->_request_latency.reset(); }
+}
+
+void
+RemoteDevice::setSamplingInterval(
+    uint16_t interval_millis_
+    )
+{
+    sendSamplingInterval( ( std::min )( ( std::max )( interval_millis_, static_cast<uint16_t>( 1 ) ), static_cast<uint16_t>( MAX_SAMPLING_INTERVAL_MILLIS ) ) );
+}
+
+void
+RemoteDevice::setRedundantCommandSuppression(
+    bool enabled_
+    )
+{
+    _suppress_redundant_commands = enabled_;
+}
+
+void
+RemoteDevice::setReportDeliveryMode(
+    ReportDeliveryMode mode_
+    )
+{
+    {   //critical section
+        std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
+
+        //coalesced digital events are computed against the state subscribers last saw, which is the cache when coming from IMMEDIATE
+        if( mode_ == ReportDeliveryMode::COALESCED && _report_delivery_mode != ReportDeliveryMode::COALESCED )
+        {
+            std::copy( _digital_port.begin(), _digital_port.end(), _digital_delivered_state.begin() );
+        }
+
+        //reports already pending are still delivered, so switching modes never loses the latest value
+        _report_delivery_mode = mode_;
+    }
+}
+
+
+void
+RemoteDevice::startLatencyProbe(
+    uint32_t interval_millis_
+    )
+{
+    stopLatencyProbe();
+    if( !interval_millis_ ) return;
+
+    _probe_interval = std::chrono::milliseconds( interval_millis_ );
+    _probe_should_exit = false;
+    _probe_thread = std::thread( [ this ]() -> void { probeThread(); } );
+}
+
+void
+RemoteDevice::stopLatencyProbe(
+    void
+    )
+{
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _probe_mutex );
+        _probe_should_exit = true;
+        _probe_condition.notify_one();
+    }
+
+    if( _probe_thread.joinable() ) { _probe_thread.join(); }
+    _latency_probe_pending.clear();
+}
+
 
 //******************************************************************************
 //* Callbacks
@@ -354,7 +758,7 @@ RemoteDevice::onDigitalReport(
     uint8_t port_xor;
 
     {   //critical section
-        std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+        std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
         //output_state will only set bits which correspond to output pins that are HIGH
         uint8_t output_state = ~_subscribed_ports[port] & _digital_port[port];
         port_val |= output_state;
@@ -366,17 +770,16 @@ RemoteDevice::onDigitalReport(
         _digital_port[port] = port_val;
     }
 
-    //throw a pin event for each pin that has changed
-    uint8_t i = 0;
-    while( port_xor > 0 )
+    if( _report_delivery_mode == ReportDeliveryMode::COALESCED )
     {
-        if( port_xor & 0x01 )
-        {
-            DigitalPinUpdated( ( port * 8 ) + i, ( ( port_val >> i ) & 0x01 ) > 0 ? PinState::HIGH : PinState::LOW );
-        }
-        port_xor >>= 1;
-        ++i;
+        //reports for a port are raised by a single thread, so the slot has no competing writers
+        uint64_t sequence = reportSequence( _digital_report_slots[port] ) + 1;
+        _digital_report_slots[port] = packReport( sequence, port_val );
+        scheduleCoalescedReport( _digital_reports_pending, port );
+        return;
     }
+
+    raiseDigitalPinEvents( port, port_val, port_xor );
 }
 
 void
@@ -388,11 +791,21 @@ RemoteDevice::onAnalogReport(
     uint16_t val = args_->getValue();
 
     {   //critical section
-        std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+        std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
         _analog_pins[pin] = val;
     }
 
+    if( _report_delivery_mode == ReportDeliveryMode::COALESCED && pin < MAX_ANALOG_PINS )
+    {
+        //reports for a pin are raised by a single thread, so the slot has no competing writers
+        uint64_t sequence = reportSequence( _analog_report_slots[pin] ) + 1;
+        _analog_report_slots[pin] = packReport( sequence, val );
+        scheduleCoalescedReport( _analog_reports_pending, pin );
+        return;
+    }
+
     //throw an event for the pin value update
+    _events_raised[ANALOG_PIN_EVENTS].fetch_add( 1, std::memory_order_relaxed );
     AnalogPinUpdated( L"A" + pin.ToString(), val );
 }
 
@@ -401,6 +814,51 @@ RemoteDevice::onSysexMessage(
     Firmata::SysexCallbackEventArgs ^argv_
     )
 {
+    if( argv_->getCommand() == static_cast<uint8_t>( SysexCommand::REPORT_FIRMWARE ) )
+    {
+        _latency_probe_pending.complete( LatencyHistogram::clock::now(), _latency[static_cast<size_t>( LatencyMetric::ECHO_PROBE )] );
+
+        //the reply carries the firmware's version and name, which identify it to auto-reconnect
+        Windows::Storage::Streams::IBuffer ^buffer = argv_->getDataBuffer();
+        std::vector<uint8_t> identity( buffer->Length );
+        if( !identity.empty() ) { Windows::Storage::Streams::DataReader::FromBuffer( buffer )->ReadBytes( Platform::ArrayReference<uint8_t>( identity.data(), static_cast<unsigned int>( identity.size() ) ) ); }
+
+        //the major and minor version are followed by the name, each character sent as two 7-bit bytes
+        std::wstring name;
+        std::string firmware;
+        for( size_t i = 2; i + 1 < identity.size(); i += 2 )
+        {
+            wchar_t c = static_cast<wchar_t>( identity[i] | ( identity[i + 1] << 7 ) );
+            name.push_back( c );
+            firmware.push_back( ( c < 0x80 ) ? static_cast<char>( c ) : '?' );
+        }
+        if( identity.size() >= 2 )
+        {
+            firmware += " " + std::to_string( identity[0] ) + "." + std::to_string( identity[1] );
+        }
+
+        {   //critical section
+            std::lock_guard<std::mutex> lock( _firmware_mutex );
+            if( identity.size() >= 2 )
+            {
+                _firmware_name.swap( name );
+                _firmware_major = identity[0];
+                _firmware_minor = identity[1];
+                _firmware_key = firmware;
+            }
+            _firmware_identity.swap( identity );
+            ++_firmware_replies;
+            _firmware_condition.notify_all();
+        }
+
+        markHandshakePhase( _handshake_firmware_ns );
+        if( !firmware.empty() ) { onFirmwareReported( firmware ); }
+    }
+
+    //firmware replies are watched from the start of the handshake, but nothing is raised before the device is ready
+    if( !_initialized ) return;
+
+    _events_raised[SYSEX_MESSAGE_EVENTS].fetch_add( 1, std::memory_order_relaxed );
     SysexMessageReceived( argv_->getCommand(), Windows::Storage::Streams::DataReader::FromBuffer( argv_->getDataBuffer() ) );
 }
 
@@ -409,6 +867,7 @@ RemoteDevice::onStringMessage(
     Firmata::StringCallbackEventArgs ^argv_
     )
 {
+    _events_raised[STRING_MESSAGE_EVENTS].fetch_add( 1, std::memory_order_relaxed );
     StringMessageReceived( argv_->getString() );
 }
 
@@ -423,21 +882,45 @@ RemoteDevice::initialize(
     )
 {
     {   //critical section equivalent to function scope
-        std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+        std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
 
         if( _initialized ) return;
         _hardwareProfile = hardwareProfile_;
-        _firmata->DigitalPortValueUpdated += ref new Firmata::CallbackFunction( [ this ]( Firmata::UwpFirmata ^caller, Firmata::CallbackEventArgs^ args ) -> void { onDigitalReport( args ); } );
-        _firmata->AnalogValueUpdated += ref new Firmata::CallbackFunction( [ this ]( Firmata::UwpFirmata ^caller, Firmata::CallbackEventArgs^ args ) -> void { onAnalogReport( args ); } );
-        _firmata->SysexMessageReceived += ref new Firmata::SysexCallbackFunction( [ this ]( Firmata::UwpFirmata ^caller, Firmata::SysexCallbackEventArgs^ args ) -> void { onSysexMessage( args ); } );
-        _firmata->StringMessageReceived += ref new Firmata::StringCallbackFunction( [ this ]( Firmata::UwpFirmata ^caller, Firmata::StringCallbackEventArgs^ args ) -> void { onStringMessage( args ); } );
+
+        //a device whose firmware changed while reconnecting is initialized again, but its reports are already subscribed
+        if( !_reports_subscribed )
+        {
+            _firmata->DigitalPortValueUpdated += ref new Firmata::CallbackFunction( [ this ]( Firmata::UwpFirmata ^caller, Firmata::CallbackEventArgs^ args ) -> void { onDigitalReport( args ); } );
+            _firmata->AnalogValueUpdated += ref new Firmata::CallbackFunction( [ this ]( Firmata::UwpFirmata ^caller, Firmata::CallbackEventArgs^ args ) -> void { onAnalogReport( args ); } );
+            _firmata->StringMessageReceived += ref new Firmata::StringCallbackFunction( [ this ]( Firmata::UwpFirmata ^caller, Firmata::StringCallbackEventArgs^ args ) -> void { onStringMessage( args ); } );
+            _reports_subscribed = true;
+        }
 
         std::fill( _digital_port.begin(), _digital_port.end(), 0 );
         std::fill( _subscribed_ports.begin(), _subscribed_ports.end(), 0 );
         std::fill( _analog_pins.begin(), _analog_pins.end(), 0 );
         std::fill( _pin_mode.begin(), _pin_mode.end(), static_cast<uint8_t>( PinMode::OUTPUT ) );
+        std::fill( _analog_report_slots.begin(), _analog_report_slots.end(), 0 );
+        std::fill( _digital_report_slots.begin(), _digital_report_slots.end(), 0 );
+        _analog_delivered_sequence.fill( 0 );
+        _digital_delivered_sequence.fill( 0 );
+        _digital_delivered_state.fill( 0 );
+        _pin_mode_sent.reset();
+        _digital_port_sent.fill( -1 );
 
         _initialized = true;
+
+        //a sampling interval requested while connecting takes effect now
+        if( _sampling_interval_sent )
+        {
+            sendSamplingInterval( _sampling_interval );
+        }
+
+        //wake the handshake, which raises DeviceReady
+        {   //critical section
+            std::lock_guard<std::mutex> handshake_lock( _handshake_mutex );
+            _handshake_condition.notify_all();
+        }
     }
 }
 
@@ -448,7 +931,7 @@ RemoteDevice::isModeSupported(
     )
 {
     //critical section equivalent to function scope
-    std::lock_guard<std::recursive_mutex> lock( _device_mutex );
+    std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
 
     if( !_initialized )
     {
@@ -496,6 +979,125 @@ RemoteDevice::isModeSupported(
     }
 }
 
+void
+RemoteDevice::deliverCoalescedReports(
+    void
+    )
+{
+    for( ;; )
+    {
+        uint32_t analog_pending = _analog_reports_pending.exchange( 0 );
+        uint32_t digital_pending = _digital_reports_pending.exchange( 0 );
+
+        if( !analog_pending && !digital_pending )
+        {
+            _report_delivery_scheduled = false;
+
+            //a report which arrived after the exchange above saw the flag still set and did not schedule a delivery of its own
+            if( ( _analog_reports_pending || _digital_reports_pending ) && !_report_delivery_scheduled.exchange( true ) ) continue;
+            return;
+        }
+
+        for( uint8_t port = 0; digital_pending; ++port, digital_pending >>= 1 )
+        {
+            if( !( digital_pending & 0x01 ) ) continue;
+
+            uint64_t slot = _digital_report_slots[port];
+            uint8_t port_val = static_cast<uint8_t>( reportValue( slot ) );
+            _coalesced_reports += reportSequence( slot ) - _digital_delivered_sequence[port] - 1;
+            _digital_delivered_sequence[port] = reportSequence( slot );
+
+            //compare against what subscribers last saw, pins which toggled back and forth in between are not reported
+            uint8_t port_xor = ( port_val ^ _digital_delivered_state[port] ) & _subscribed_ports[port];
+            _digital_delivered_state[port] = port_val;
+            raiseDigitalPinEvents( port, port_val, port_xor );
+        }
+
+        for( uint8_t pin = 0; analog_pending; ++pin, analog_pending >>= 1 )
+        {
+            if( !( analog_pending & 0x01 ) ) continue;
+
+            uint64_t slot = _analog_report_slots[pin];
+            _coalesced_reports += reportSequence( slot ) - _analog_delivered_sequence[pin] - 1;
+            _analog_delivered_sequence[pin] = reportSequence( slot );
+
+            _events_raised[ANALOG_PIN_EVENTS].fetch_add( 1, std::memory_order_relaxed );
+            AnalogPinUpdated( L"A" + pin.ToString(), reportValue( slot ) );
+        }
+    }
+}
+
+void
+RemoteDevice::adaptSamplingInterval(
+    void
+    )
+{
+    std::lock_guard<std::mutex> lock( _sampling_mutex );
+    if( _sampling_timer == nullptr || !_initialized || !_firmata->connectionReady() ) return;
+
+    uint64_t bytes = _firmata->getMetrics()->BytesReceived;
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>( now - _sampled_time ).count();
+    if( seconds <= 0.0 ) return;
+
+    double bytes_per_second = ( bytes - _sampled_bytes ) / seconds;
+    _sampled_bytes = bytes;
+    _sampled_time = now;
+
+    //sampled reports make up most inbound traffic and their rate is inversely proportional to the interval, so scaling the interval by
+    //the ratio of measured to target traffic lands near the target. Lengthen as soon as the link is over target, but only shorten well
+    //below it, and by at most half per step, so the interval does not oscillate around the target
+    double ratio = bytes_per_second / _sampling_target_bytes_per_second;
+    if( ratio <= 1.0 && ratio >= ADAPTIVE_SAMPLING_LOWER_BAND ) return;
+
+    double interval = _sampling_interval * ( std::min )( ( std::max )( ratio, 0.5 ), 4.0 );
+    interval = ( std::min )( ( std::max )( interval, static_cast<double>( _min_sampling_interval ) ), static_cast<double>( _max_sampling_interval ) );
+
+    uint16_t next_interval = static_cast<uint16_t>( interval + 0.5 );
+    if( next_interval != _sampling_interval )
+    {
+        sendSamplingInterval( next_interval );
+    }
+}
+
+void
+RemoteDevice::attemptReconnect(
+    void
+    )
+{
+    uint32_t baud;
+    Serial::SerialConfig config;
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _reconnect_mutex );
+        if( !_auto_reconnect || !_restore_pending ) return;
+
+        baud = _reconnect_baud;
+        config = _reconnect_config;
+    }
+
+    //the retry interval outlasts a connection attempt, so a stream which is still not ready has given up on the previous one
+    if( _serial_connection->connectionReady() ) return;
+
+    try
+    {
+        _serial_connection->end();
+    }
+    catch( ... )
+    {
+        //not every stream can be closed, the attempt goes ahead regardless
+    }
+
+    try
+    {
+        _serial_connection->begin( baud, config );
+    }
+    catch( ... )
+    {
+        //the timer makes the next attempt
+    }
+}
+
 void
 RemoteDevice::getPinMap(
     uint8_t pin_,
@@ -514,51 +1116,339 @@ RemoteDevice::getPinMap(
 }
 
 void
-RemoteDevice::onConnectionFailed(
-    Platform::String^ message_
+RemoteDevice::probeThread(
+    void
     )
 {
-    DeviceConnectionFailed( message_ );
+    std::unique_lock<std::mutex> lock( _probe_mutex );
+
+    while( !_probe_should_exit )
+    {
+        auto now = LatencyHistogram::clock::now();
+        LatencyHistogram::clock::time_point sent;
+
+        //only one probe is in flight at a time; one which has gone unanswered for too long is assumed lost
+        bool awaiting_reply = _latency_probe_pending.outstanding( sent ) && ( now - sent ) < LATENCY_PROBE_TIMEOUT;
+
+        if( !awaiting_reply && _initialized && _firmata->connectionReady() )
+        {
+            _latency_probe_pending.clear();
+            _latency_probe_pending.mark( now );
+
+            try
+            {
+                _firmata->sendSysex( SysexCommand::REPORT_FIRMWARE, nullptr );
+            }
+            catch( ... )
+            {
+                _latency_probe_pending.clear();
+            }
+        }
+
+        _probe_condition.wait_for( lock, _probe_interval, [ this ]() -> bool { return _probe_should_exit; } );
+    }
 }
 
 void
-RemoteDevice::onConnectionLost(
-    Platform::String^ message_
+RemoteDevice::markHandshakePhase(
+    uint64_t &phase_ns_
     )
 {
-    DeviceConnectionLost( message_ );
+    std::lock_guard<std::mutex> lock( _handshake_mutex );
+    if( !phase_ns_ )
+    {
+        phase_ns_ = static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - _handshake_start ).count() );
+    }
 }
 
 void
-RemoteDevice::onConnectionReady(
+RemoteDevice::onFirmwareReported(
+    const std::string &firmware_
+    )
+{
+    //every latency probe is answered with a firmware report, so once the profile has been stored they are ignored without locking
+    if( _initialized && _profile_stored ) return;
+
+    std::unique_lock<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
+    if( _profile_cache == nullptr ) return;
+
+    if( !_initialized )
+    {
+        HardwareProfileCache::Profile pins;
+        if( !_profile_cache->find( firmware_, pins ) ) return;
+
+        HardwareProfile ^hardwareProfile = ref new HardwareProfile( pins );
+        if( !hardwareProfile->IsValid ) return;
+
+        _profile_verified = false;
+        {   //critical section
+            std::lock_guard<std::mutex> handshake_lock( _handshake_mutex );
+            _handshake_from_cache = true;
+        }
+        initialize( hardwareProfile );
+    }
+    else if( _profile_verified && !_profile_stored )
+    {
+        _profile_stored = true;
+        std::shared_ptr<HardwareProfileCache> cache = _profile_cache;
+        HardwareProfileCache::Profile pins = _hardwareProfile->getPinRecords();
+        lock.unlock();
+
+        storeHardwareProfile( cache, firmware_, std::move( pins ) );
+    }
+}
+
+std::vector<uint8_t>
+RemoteDevice::queryFirmwareIdentity(
     void
     )
 {
-    _firmata->PinCapabilityResponseReceived += ref new Microsoft::Maker::Firmata::SysexCallbackFunction( this, &Microsoft::Maker::RemoteWiring::RemoteDevice::onPinCapabilityResponseReceived );
-    _firmata->startListening();
+    uint64_t replies;
 
-	//this async task will send a request for pin capability report from the device, wait for increasing intervals as long as the device
-	//has not correctly responded. If, after a set amount of time, it is determined that no response has been received, it will repeat
-	//the process for a set number of attempts. A device response will be received in the form of a PinCapabilityResponseReceived event.
-    Concurrency::create_task( [ this ]
-    {
-        const int MAX_ATTEMPTS = 30;
-		const int MAX_DELAY_LOOP = 5;
-		const int INIT_DELAY_MS = 10;
-        int attempts = 0;
-		int delay_loop = 0;
-		int delay_ms = INIT_DELAY_MS;
-        
-		//this loop will send the pin capability report and repeatedly lock the _device_mutex while checking the state of the object's initialization.
-		//locking guarantees that the state is able to be read only entirely before or after a complete initialization.
-        for( ;; )
-        {
-            {   //critical section
-                std::lock_guard<std::recursive_mutex> lock( _device_mutex );
-                if( _initialized ) return true;
-            }
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _firmware_mutex );
+        replies = _firmware_replies;
+    }
 
-            if( attempts >= MAX_ATTEMPTS ) return false;
+    try
+    {
+        _firmata->sendSysex( SysexCommand::REPORT_FIRMWARE, nullptr );
+    }
+    catch( ... )
+    {
+        return std::vector<uint8_t>();
+    }
+
+    std::unique_lock<std::mutex> lock( _firmware_mutex );
+    if( !_firmware_condition.wait_for( lock, FIRMWARE_QUERY_TIMEOUT, [ this, replies ]() -> bool { return _firmware_replies != replies; } ) )
+    {
+        return std::vector<uint8_t>();
+    }
+
+    return _firmware_identity;
+}
+
+void
+RemoteDevice::raiseDeviceReady(
+    void
+    )
+{
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _reconnect_mutex );
+        if( _restore_pending )
+        {
+            _last_restore_ns = static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - _connection_lost_time ).count() );
+            ++_reconnects;
+            _restore_pending = false;
+        }
+    }
+
+    DeviceReady();
+}
+
+void
+RemoteDevice::raiseDigitalPinEvents(
+    uint8_t port_,
+    uint8_t port_val_,
+    uint8_t changed_mask_
+    )
+{
+    //throw a pin event for each pin that has changed
+    uint8_t i = 0;
+    while( changed_mask_ > 0 )
+    {
+        if( changed_mask_ & 0x01 )
+        {
+            _events_raised[DIGITAL_PIN_EVENTS].fetch_add( 1, std::memory_order_relaxed );
+            DigitalPinUpdated( ( port_ * 8 ) + i, ( ( port_val_ >> i ) & 0x01 ) > 0 ? PinState::HIGH : PinState::LOW );
+        }
+        changed_mask_ >>= 1;
+        ++i;
+    }
+}
+
+void
+RemoteDevice::restoreDeviceState(
+    void
+    )
+{
+    std::vector<uint8_t> known_identity;
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _firmware_mutex );
+        known_identity = _firmware_identity;
+    }
+
+    //different firmware may not support the cached pin modes, so the device is initialized again from its capabilities
+    std::vector<uint8_t> identity = queryFirmwareIdentity();
+    if( identity.empty() || identity != known_identity )
+    {
+        {   //critical section
+            std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
+            _initialized = false;
+            _profile_stored = false;
+        }
+
+        startHandshake();
+        return;
+    }
+
+    {   //critical section
+        std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
+
+        //the board has been reset, so everything it had been told is sent again in a single burst
+        _firmata->lock();
+        try
+        {
+            writeDeviceState();
+            _firmata->flush();
+        }
+        catch( ... )
+        {
+            //the connection has been lost again, it will be restored once it returns
+            _firmata->unlock();
+            return;
+        }
+
+        _firmata->unlock();
+    }
+
+    raiseDeviceReady();
+}
+
+void
+RemoteDevice::sendSamplingInterval(
+    uint16_t interval_millis_
+    )
+{
+    _sampling_interval = interval_millis_;
+    _sampling_interval_sent = true;
+
+    //an interval set before the device is ready is sent once it has been initialized
+    if( !_initialized ) return;
+
+    using Windows::Storage::Streams::DataWriter;
+    DataWriter ^writer = ref new DataWriter();
+    writer->WriteByte( interval_millis_ & 0x7F );
+    writer->WriteByte( ( interval_millis_ >> 7 ) & 0x7F );
+
+    _firmata->sendSysex( SysexCommand::SAMPLING_INTERVAL, writer->DetachBuffer() );
+}
+
+void
+RemoteDevice::writeDeviceState(
+    void
+    )
+{
+    //pin modes go first, a digital port value is only meaningful once its pins are outputs
+    for( uint8_t pin = 0; pin < MAX_PINS; ++pin )
+    {
+        if( !_pin_mode_sent[pin] ) continue;
+
+        _firmata->write( static_cast<uint8_t>( Firmata::Command::SET_PIN_MODE ) );
+        _firmata->write( pin );
+        _firmata->write( _pin_mode[pin] );
+    }
+
+    for( uint8_t port = 0; port < MAX_PORTS; ++port )
+    {
+        if( _subscribed_ports[port] )
+        {
+            _firmata->write( static_cast<uint8_t>( Firmata::Command::REPORT_DIGITAL_PIN ) | ( port & 0x0F ) );
+            _firmata->write( 1 );
+        }
+
+        if( _digital_port_sent[port] >= 0 )
+        {
+            _firmata->write( static_cast<uint8_t>( Firmata::Command::DIGITAL_MESSAGE ) | ( port & 0x0F ) );
+            _firmata->write( static_cast<uint8_t>( _digital_port[port] & 0x7F ) );
+            _firmata->write( static_cast<uint8_t>( _digital_port[port] >> 7 ) );
+            _digital_port_sent[port] = _digital_port[port];
+        }
+    }
+
+    if( _sampling_interval_sent )
+    {
+        _firmata->write( static_cast<uint8_t>( Firmata::Command::START_SYSEX ) );
+        _firmata->write( static_cast<uint8_t>( SysexCommand::SAMPLING_INTERVAL ) );
+        _firmata->write( static_cast<uint8_t>( _sampling_interval & 0x7F ) );
+        _firmata->write( static_cast<uint8_t>( ( _sampling_interval >> 7 ) & 0x7F ) );
+        _firmata->write( static_cast<uint8_t>( Firmata::Command::END_SYSEX ) );
+    }
+}
+
+void
+RemoteDevice::storeHardwareProfile(
+    std::shared_ptr<HardwareProfileCache> cache_,
+    const std::string &firmware_,
+    HardwareProfileCache::Profile pins_
+    )
+{
+    //writing the file can take a while, so it is done on the thread pool rather than the input thread; the cache serializes the writes
+    //and each one writes every profile stored so far, so the order they run in does not matter
+    std::string firmware = firmware_;
+    Concurrency::create_task( [ cache_, firmware, pins_ ]() -> void { cache_->store( firmware, pins_ ); } );
+}
+
+void
+RemoteDevice::scheduleCoalescedReport(
+    std::atomic_uint32_t &pending_,
+    uint8_t index_
+    )
+{
+    pending_ |= ( 1 << index_ );
+
+    //a single delivery task runs at a time, so each pin has at most one notification outstanding and events for it stay in order
+    if( !_report_delivery_scheduled.exchange( true ) )
+    {
+        Concurrency::create_task( [ this ]() -> void { deliverCoalescedReports(); } );
+    }
+}
+
+void
+RemoteDevice::startHandshake(
+    void
+    )
+{
+    if( !_handshake_subscribed.exchange( true ) )
+    {
+        _firmata->PinCapabilityResponseReceived += ref new Microsoft::Maker::Firmata::SysexCallbackFunction( this, &Microsoft::Maker::RemoteWiring::RemoteDevice::onPinCapabilityResponseReceived );
+        _firmata->SysexMessageReceived += ref new Firmata::SysexCallbackFunction( [ this ]( Firmata::UwpFirmata ^caller, Firmata::SysexCallbackEventArgs^ args ) -> void { onSysexMessage( args ); } );
+    }
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _handshake_mutex );
+        _handshake_start = std::chrono::steady_clock::now();
+        _handshake_firmware_ns = 0;
+        _handshake_capability_ns = 0;
+        _handshake_ready_ns = 0;
+        _capability_queries = 0;
+        _handshake_from_cache = false;
+    }
+
+    //the firmware is asked to identify itself before its capabilities. The two queries go out back-to-back and the short firmware reply
+    //arrives first, so a board running firmware with a cached profile is ready without waiting for the capability response, which then
+    //only verifies the cached profile
+    try
+    {
+        _firmata->sendSysex( SysexCommand::REPORT_FIRMWARE, nullptr );
+    }
+    catch( ... )
+    {
+        //the capability query is enough on its own
+    }
+
+    //this async task sends the capability query and waits to be woken by initialize(), repeating the query if no valid response has
+    //arrived in time. A device response will be received in the form of a PinCapabilityResponseReceived event.
+    Concurrency::create_task( [ this ]() -> bool
+    {
+        std::unique_lock<std::mutex> lock( _handshake_mutex );
+
+        while( !_initialized )
+        {
+            if( _capability_queries >= MAX_CAPABILITY_QUERIES ) return false;
+            ++_capability_queries;
+            lock.unlock();
 
             //manually sending a sysex message asking for the pin configuration will guarantee it is sent properly even if a user has started a sysex message themselves
             _firmata->lock();
@@ -573,23 +1463,14 @@ RemoteDevice::onConnectionReady(
             {
                 //if an error occurs here we count it as an attempt and continue.
             }
-
             _firmata->unlock();
-            ++attempts;
-			
-			//this loop is responsible for waiting at increasing intervals until the response is received or MAX_DELAY_LOOP number of iterations have occurred.
-			for( delay_loop = 0, delay_ms = INIT_DELAY_MS; delay_loop < MAX_DELAY_LOOP; ++delay_loop, delay_ms *= 2 )
-			{
-				Sleep( delay_ms );
-				
-				{   //critical section
-					std::lock_guard<std::recursive_mutex> lock( _device_mutex );
-					if( _initialized ) return true;
-				}
-			}
+
+            lock.lock();
+            _handshake_condition.wait_for( lock, CAPABILITY_QUERY_TIMEOUT, [ this ]() -> bool { return _initialized; } );
         }
 
-        return false;
+        _handshake_ready_ns = static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - _handshake_start ).count() );
+        return true;
     } )
         .then( [ this ] ( task<bool> t )
     {
@@ -598,7 +1479,7 @@ RemoteDevice::onConnectionReady(
             bool result = t.get();
             if( !result ) throw ref new Platform::Exception( E_UNEXPECTED, L"Pin configuration not received." );
 
-            DeviceReady();
+            raiseDeviceReady();
         }
         catch( Platform::Exception ^e )
         {
@@ -607,6 +1488,62 @@ RemoteDevice::onConnectionReady(
     } );
 }
 
+void
+RemoteDevice::onConnectionFailed(
+    Platform::String^ message_
+    )
+{
+    DeviceConnectionFailed( message_ );
+}
+
+void
+RemoteDevice::onConnectionLost(
+    Platform::String^ message_
+    )
+{
+    DeviceConnectionLost( message_ );
+
+    std::lock_guard<std::mutex> lock( _reconnect_mutex );
+    if( !_auto_reconnect || _reconnect_timer != nullptr ) return;
+
+    //time to restore is measured from the first loss until DeviceReady is raised again, however many attempts it takes
+    if( !_restore_pending )
+    {
+        _restore_pending = true;
+        _connection_lost_time = std::chrono::steady_clock::now();
+    }
+
+    _reconnect_timer = Windows::System::Threading::ThreadPoolTimer::CreatePeriodicTimer( ref new Windows::System::Threading::TimerElapsedHandler( [ this ]( Windows::System::Threading::ThreadPoolTimer ^timer_ ) -> void { attemptReconnect(); } ), _reconnect_interval );
+}
+
+void
+RemoteDevice::onConnectionReady(
+    void
+    )
+{
+    _firmata->startListening();
+
+    bool restore_pending;
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _reconnect_mutex );
+        if( _reconnect_timer != nullptr )
+        {
+            _reconnect_timer->Cancel();
+            _reconnect_timer = nullptr;
+        }
+        restore_pending = _restore_pending;
+    }
+
+    //a device which was ready before the connection was lost is brought back to its cached state instead of starting over
+    if( restore_pending && _initialized )
+    {
+        Concurrency::create_task( [ this ]() -> void { restoreDeviceState(); } );
+        return;
+    }
+
+    startHandshake();
+}
 
 void
 RemoteDevice::onPinCapabilityResponseReceived(
@@ -614,12 +1551,49 @@ RemoteDevice::onPinCapabilityResponseReceived(
     SysexCallbackEventArgs ^argv_
     )
 {
-    if( _initialized || argv_ == nullptr ) return;
+    if( ( _initialized && _profile_verified ) || argv_ == nullptr ) return;
 
     HardwareProfile ^hardwareProfile = ref new HardwareProfile( argv_->getDataBuffer() );
-    if( hardwareProfile->IsValid )
+    if( !hardwareProfile->IsValid ) return;
+    markHandshakePhase( _handshake_capability_ns );
+
+    std::shared_ptr<HardwareProfileCache> cache;
+    HardwareProfileCache::Profile pins;
+    {   //critical section
+        std::lock_guard<Firmata::TimedMutex<std::recursive_mutex>> lock( _device_mutex );
+
+        if( !_initialized )
+        {
+            initialize( hardwareProfile );
+        }
+        else if( _profile_verified )
+        {
+            return;
+        }
+        else if( _hardwareProfile->getPinRecords() != hardwareProfile->getPinRecords() )
+        {
+            //the device was initialized from the cache, and the device itself knows best
+            _hardwareProfile = hardwareProfile;
+        }
+        _profile_verified = true;
+
+        if( _profile_cache == nullptr ) return;
+
+        cache = _profile_cache;
+        pins = _hardwareProfile->getPinRecords();
+    }
+
+    std::string firmware;
+    {   //critical section
+        std::lock_guard<std::mutex> firmware_lock( _firmware_mutex );
+        firmware = _firmware_key;
+    }
+
+    //without a name the profile is cached once the firmware has identified itself, see onFirmwareReported
+    if( !firmware.empty() )
     {
-        initialize( hardwareProfile );
+        _profile_stored = true;
+        storeHardwareProfile( cache, firmware, std::move( pins ) );
     }
 }
 
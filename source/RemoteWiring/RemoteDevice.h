@@ -24,10 +24,20 @@
 
 #pragma once
 
+#include <bitset>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include "TwoWire.h"
 #include "HardwareProfile.h"
+#include "HardwareProfileCache.h"
+#include "LatencyHistogram.h"
+#include "../Firmata/TimedMutex.h"
 
 namespace Microsoft {
 namespace Maker {
@@ -56,6 +66,194 @@ public enum class PinState
     HIGH = 0x01,
 };
 
+///<summary>
+///Determines how DigitalPinUpdated and AnalogPinUpdated events are raised for reports received from the device.
+///</summary>
+public enum class ReportDeliveryMode
+{
+    //an event is raised on the input thread for every report received
+    IMMEDIATE,
+    //each analog pin and digital port holds only its latest report; an event is raised for the latest value once subscribers have
+    //handled the previous one, and reports which arrive in the meantime are dropped instead of queued
+    COALESCED,
+};
+
+///<summary>
+///The round trips timed by RemoteDevice, see RemoteDevice::getLatencyStatistics.
+///</summary>
+public enum class LatencyMetric
+{
+    //an echo probe sent by startLatencyProbe to the device's reply, the latency of the link itself
+    ECHO_PROBE,
+    //I2c::TwoWire::requestFrom to the reply from the same address; timed by TwoWire, so metrics timed by RemoteDevice go above it
+    I2C_REQUEST_TO_REPLY,
+};
+
+///<summary>
+///A summary of one LatencyMetric at the time it was requested. Percentiles are accurate to within about 3%.
+///</summary>
+public ref class LatencyStatistics sealed
+{
+public:
+    //round trips timed
+    property uint64_t Count { uint64_t get() { return _count; } }
+
+    property double MinMicroseconds { double get() { return _min; } }
+    property double MeanMicroseconds { double get() { return _mean; } }
+    property double MaxMicroseconds { double get() { return _max; } }
+
+    property double P50Microseconds { double get() { return _p50; } }
+    property double P90Microseconds { double get() { return _p90; } }
+    property double P99Microseconds { double get() { return _p99; } }
+    property double P999Microseconds { double get() { return _p999; } }
+
+internal:
+    LatencyStatistics(
+        const LatencyHistogram::Snapshot &snapshot_
+    ) :
+        _count( snapshot_.count ),
+        _min( snapshot_.min_ns / 1000.0 ),
+        _mean( snapshot_.meanNanoseconds() / 1000.0 ),
+        _max( snapshot_.max_ns / 1000.0 ),
+        _p50( snapshot_.percentileNanoseconds( 0.5 ) / 1000.0 ),
+        _p90( snapshot_.percentileNanoseconds( 0.9 ) / 1000.0 ),
+        _p99( snapshot_.percentileNanoseconds( 0.99 ) / 1000.0 ),
+        _p999( snapshot_.percentileNanoseconds( 0.999 ) / 1000.0 )
+    {
+    }
+
+private:
+    uint64_t _count;
+    double _min;
+    double _mean;
+    double _max;
+    double _p50;
+    double _p90;
+    double _p99;
+    double _p999;
+};
+
+///<summary>
+///A snapshot of the counters RemoteDevice keeps, together with those of its connection. Counters only ever increase; rates are found
+///by comparing two snapshots taken some time apart.
+///</summary>
+public ref class DeviceMetrics sealed
+{
+public:
+    //events raised to subscribers
+    property uint64_t DigitalPinEvents { uint64_t get() { return _digital_pin_events; } }
+    property uint64_t AnalogPinEvents { uint64_t get() { return _analog_pin_events; } }
+    property uint64_t SysexMessageEvents { uint64_t get() { return _sysex_message_events; } }
+    property uint64_t StringMessageEvents { uint64_t get() { return _string_message_events; } }
+
+    //use of the lock guarding the device state cache, which API calls and reports from the device contend for
+    property uint64_t LockAcquisitions { uint64_t get() { return _lock_acquisitions; } }
+    property uint64_t LockContentions { uint64_t get() { return _lock_contentions; } }
+    property uint64_t LockWaitMicroseconds { uint64_t get() { return _lock_wait_ns / 1000; } }
+
+    //connections restored by auto-reconnect, and the time from the latest loss of the connection to DeviceReady being raised again
+    property uint64_t Reconnects { uint64_t get() { return _reconnects; } }
+    property uint64_t LastRestoreMicroseconds { uint64_t get() { return _last_restore_ns / 1000; } }
+
+    //the counters of the underlying UwpFirmata connection
+    property Firmata::FirmataMetrics ^ Connection { Firmata::FirmataMetrics ^ get() { return _connection; } }
+
+    ///<summary>
+    ///Formats every counter, including those of the connection, as a line of text.
+    ///</summary>
+    Platform::String ^
+    toText(
+        void
+    );
+
+    ///<summary>
+    ///Formats every counter as a JSON object with "device" and "connection" members, for collection by monitoring tools.
+    ///</summary>
+    Platform::String ^
+    toJson(
+        void
+    );
+
+internal:
+    DeviceMetrics(
+        const std::array<uint64_t, 4> &events_raised_,
+        const Firmata::TimedMutex<std::recursive_mutex>::Statistics &lock_statistics_,
+        uint64_t reconnects_,
+        uint64_t last_restore_ns_,
+        Firmata::FirmataMetrics ^connection_
+    ) :
+        _digital_pin_events( events_raised_[0] ),
+        _analog_pin_events( events_raised_[1] ),
+        _sysex_message_events( events_raised_[2] ),
+        _string_message_events( events_raised_[3] ),
+        _lock_acquisitions( lock_statistics_.acquisitions ),
+        _lock_contentions( lock_statistics_.contentions ),
+        _lock_wait_ns( lock_statistics_.wait_ns ),
+        _reconnects( reconnects_ ),
+        _last_restore_ns( last_restore_ns_ ),
+        _connection( connection_ )
+    {
+    }
+
+private:
+    uint64_t _digital_pin_events;
+    uint64_t _analog_pin_events;
+    uint64_t _sysex_message_events;
+    uint64_t _string_message_events;
+    uint64_t _lock_acquisitions;
+    uint64_t _lock_contentions;
+    uint64_t _lock_wait_ns;
+    uint64_t _reconnects;
+    uint64_t _last_restore_ns;
+    Firmata::FirmataMetrics ^_connection;
+};
+
+///<summary>
+///The timing of the most recent handshake, measured from the connection becoming ready, see RemoteDevice::getHandshakeStatistics.
+///Phases which have not completed read 0.
+///</summary>
+public ref class HandshakeStatistics sealed
+{
+public:
+    //capability queries sent, including repeats of queries which went unanswered
+    property uint32_t CapabilityQueries { uint32_t get() { return _capability_queries; } }
+
+    //until the firmware identified itself
+    property uint64_t FirmwareMicroseconds { uint64_t get() { return _firmware_ns / 1000; } }
+
+    //until a valid capability response was received
+    property uint64_t CapabilityResponseMicroseconds { uint64_t get() { return _capability_ns / 1000; } }
+
+    //until the device was initialized and DeviceReady could be raised
+    property uint64_t ReadyMicroseconds { uint64_t get() { return _ready_ns / 1000; } }
+
+    //true if the device was initialized from a HardwareProfileCache rather than its capability response
+    property bool ProfileFromCache { bool get() { return _profile_from_cache; } }
+
+internal:
+    HandshakeStatistics(
+        uint32_t capability_queries_,
+        uint64_t firmware_ns_,
+        uint64_t capability_ns_,
+        uint64_t ready_ns_,
+        bool profile_from_cache_
+    ) :
+        _capability_queries( capability_queries_ ),
+        _firmware_ns( firmware_ns_ ),
+        _capability_ns( capability_ns_ ),
+        _ready_ns( ready_ns_ ),
+        _profile_from_cache( profile_from_cache_ )
+    {
+    }
+
+private:
+    uint32_t _capability_queries;
+    uint64_t _firmware_ns;
+    uint64_t _capability_ns;
+    uint64_t _ready_ns;
+    bool _profile_from_cache;
+};
+
 public delegate void DigitalPinUpdatedCallback( uint8_t pin, PinState state );
 public delegate void AnalogPinUpdatedCallback( Platform::String ^pin, uint16_t value );
 public delegate void SysexMessageReceivedCallback( uint8_t command, Windows::Storage::Streams::DataReader ^message );
@@ -101,6 +299,25 @@ public:
         }
     }
 
+    //the name and version ("major.minor") the firmware reported, or nullptr until it has identified itself
+    property Platform::String ^ FirmwareName
+    {
+        Platform::String ^ get()
+        {
+            std::lock_guard<std::mutex> lock( _firmware_mutex );
+            return _firmware_key.empty() ? nullptr : ref new Platform::String( _firmware_name.c_str() );
+        }
+    }
+
+    property Platform::String ^ FirmwareVersion
+    {
+        Platform::String ^ get()
+        {
+            std::lock_guard<std::mutex> lock( _firmware_mutex );
+            return _firmware_key.empty() ? nullptr : _firmware_major.ToString() + L"." + _firmware_minor.ToString();
+        }
+    }
+
     [Windows::Foundation::Metadata::DefaultOverloadAttribute]
     RemoteDevice(
         Serial::IStream ^serial_connection_
@@ -129,7 +346,8 @@ public:
     ///<para>This function should only be called for pins that support PWM. If the given pin is in 
     ///PinMode.OUTPUT, the pin will automatically be changed to PinMode.PWM</para>
     ///<param name="pin_">A raw pin number which will be treated "as is" and used exactly as given.</param>
-    ///<param name="value_">The analog value to write to the given pin.</param>
+    ///<param name="value_">The analog value to write to the given pin. Values beyond the resolution the device reports for the pin are
+    ///limited to its maximum; pins above 15 and values wider than 14 bits are sent with EXTENDED_ANALOG.</param>
     ///</summary>
     void
     analogWrite(
@@ -189,6 +407,116 @@ public:
         PinMode mode_
     );
 
+    ///<summary>
+    ///Returns the number of analog and digital reports which were replaced by a newer report before an event was raised for them.
+    ///<para>Reports are only ever dropped with ReportDeliveryMode.COALESCED.</para>
+    ///</summary>
+    uint64_t
+    getCoalescedReportCount(
+        void
+    );
+
+    ///<summary>
+    ///Returns how long each phase of the most recent handshake took.
+    ///</summary>
+    HandshakeStatistics ^
+    getHandshakeStatistics(
+        void
+    );
+
+    ///<summary>
+    ///Returns the round-trip latencies observed for the given metric since this RemoteDevice was created or resetLatencyStatistics was called.
+    ///<para>Only requests the device answers are timed. Firmata does not acknowledge digitalWrite, analogWrite or pinMode, so their
+    ///latency cannot be told apart from the device's sampling interval and is not recorded.</para>
+    ///</summary>
+    LatencyStatistics ^
+    getLatencyStatistics(
+        LatencyMetric metric_
+    );
+
+    ///<summary>
+    ///Stops adjusting the sampling interval; the interval last sent stays in effect.
+    ///</summary>
+    void
+    disableAdaptiveSampling(
+        void
+    );
+
+    ///<summary>
+    ///Stops re-opening the connection when it is lost; a reconnection already under way is abandoned.
+    ///</summary>
+    void
+    disableAutoReconnect(
+        void
+    );
+
+    ///<summary>
+    ///Adjusts the sampling interval once a second so that data received from the device uses about target_utilization_ (0.0 - 1.0) of
+    ///a link able to carry link_bytes_per_second_, keeping the interval within [min_interval_millis_, max_interval_millis_].
+    ///<para>A 57600 baud serial link carries 5760 bytes per second. The interval is lengthened as soon as the link is busier than the
+    ///target and shortened, at most by half each second, while it is below three quarters of the target, so slow links stop saturating
+    ///and fast links sample as often as the bounds allow.</para>
+    ///</summary>
+    void
+    enableAdaptiveSampling(
+        uint32_t link_bytes_per_second_,
+        double target_utilization_,
+        uint16_t min_interval_millis_,
+        uint16_t max_interval_millis_
+    );
+
+    ///<summary>
+    ///Re-opens the connection with the given settings whenever it is lost, retrying every retry_interval_millis_ milliseconds until the
+    ///stream connects. The interval should exceed the time the stream takes to connect. DeviceConnectionLost is still raised.
+    ///<para>Once reconnected the firmware is asked to identify itself. If it is the firmware the device was initialized with, the handshake
+    ///is skipped: every pin mode, digital port subscription and output value and the sampling interval are sent to the board in a single
+    ///burst and DeviceReady is raised again. Otherwise the full handshake is repeated and the cached pin state starts over.</para>
+    ///<para>Only a RemoteDevice constructed from an IStream can reconnect. The time taken is reported by getMetrics.</para>
+    ///</summary>
+    void
+    enableAutoReconnect(
+        uint32_t baud_,
+        Serial::SerialConfig config_,
+        uint32_t retry_interval_millis_
+    );
+
+    ///<summary>
+    ///Remembers the pin capabilities reported by each firmware in the file at path_, keyed by the firmware's name and version.
+    ///<para>A board running firmware found in the cache becomes ready as soon as it has identified itself, without waiting for its
+    ///capability response. The capability query is still sent, and if the board's answer differs from the cached profile the answer
+    ///replaces it, both in DeviceHardwareProfile and in the file. Call this before the connection is established.</para>
+    ///<returns>true if the file already held cached profiles</returns>
+    ///</summary>
+    bool
+    enableHardwareProfileCache(
+        Platform::String ^path_
+    );
+
+    ///<summary>
+    ///Returns the events raised and the device lock usage of this RemoteDevice, together with the counters of its connection.
+    ///</summary>
+    DeviceMetrics ^
+    getMetrics(
+        void
+    );
+
+    ///<summary>
+    ///Returns the sampling interval last sent to the device, or the StandardFirmata default of 19 milliseconds if none has been sent.
+    ///</summary>
+    uint16_t
+    getSamplingInterval(
+        void
+    );
+
+    ///<summary>
+    ///Returns the number of digitalWrite and pinMode requests which were not sent because the device was already in the requested state.
+    ///<para>Requests are only ever suppressed after setRedundantCommandSuppression( true ).</para>
+    ///</summary>
+    uint64_t
+    getSuppressedCommandCount(
+        void
+    );
+
     ///<summary>
     ///Retrieves the mode of the given pin from the cache stored by RemoteDevice class. 
     ///<para>This is not a function you will find in the Arduino API, but is an extremely helpful function 
@@ -212,12 +540,86 @@ public:
         Platform::String ^analog_pin_
         );
 
+    ///<summary>
+    ///Re-sends every pin mode set through pinMode and every digital port value set through digitalWrite, whether or not the device
+    ///is believed to be in that state already.
+    ///<para>Use this when the device may have lost its state without the connection being lost, for example after a watchdog reset.</para>
+    ///</summary>
+    void
+    refreshDeviceState(
+        void
+    );
+
+    ///<summary>
+    ///Discards all recorded round-trip latencies.
+    ///</summary>
+    void
+    resetLatencyStatistics(
+        void
+    );
+
+    ///<summary>
+    ///Sets how often, in milliseconds, the device samples its analog inputs and continuous I2C reads and reports their values.
+    ///<para>The interval is limited to [1, 16383] milliseconds. Reporting every analog pin more often than the link can carry only
+    ///delays every other message; see enableAdaptiveSampling.</para>
+    ///</summary>
+    void
+    setSamplingInterval(
+        uint16_t interval_millis_
+    );
+
+    ///<summary>
+    ///When enabled, digitalWrite and pinMode only send a message to the device if it changes the state last sent, which keeps
+    ///control loops that set the same outputs every tick from flooding slow connections. Disabled by default.
+    ///</summary>
+    void
+    setRedundantCommandSuppression(
+        bool enabled_
+    );
+
+    ///<summary>
+    ///Sets how DigitalPinUpdated and AnalogPinUpdated events are raised. The default is ReportDeliveryMode.IMMEDIATE.
+    ///<para>Use ReportDeliveryMode.COALESCED when event handlers may fall behind the device's sampling rate; subscribers then always
+    ///receive the most recent value and latency stays bounded, at the cost of intermediate samples.</para>
+    ///</summary>
+    void
+    setReportDeliveryMode(
+        ReportDeliveryMode mode_
+    );
+
+    ///<summary>
+    ///Measures the latency of the link continuously by sending a firmware query every interval_millis_ milliseconds and timing the reply,
+    ///recorded as LatencyMetric.ECHO_PROBE. The query does not affect any pin. A probe which is unanswered after a second is abandoned.
+    ///<para>The replies are also raised through SysexMessageReceived, with the REPORT_FIRMWARE command.</para>
+    ///</summary>
+    void
+    startLatencyProbe(
+        uint32_t interval_millis_
+    );
+
+    ///<summary>
+    ///Stops the probes started by startLatencyProbe.
+    ///</summary>
+    void
+    stopLatencyProbe(
+        void
+    );
+
 
 private:
     //constant members
     static const size_t MAX_PORTS = 16;
     static const size_t MAX_PINS = 128;
     static const size_t MAX_ANALOG_PINS = 16;
+    static const uint16_t DEFAULT_SAMPLING_INTERVAL_MILLIS = 19;
+    static const uint16_t MAX_SAMPLING_INTERVAL_MILLIS = 0x3FFF;
+    const double ADAPTIVE_SAMPLING_LOWER_BAND = 0.75;
+    //the number of metrics kept in _latency, which are those ahead of I2C_REQUEST_TO_REPLY; the I2C metric is kept by TwoWire
+    static const size_t DEVICE_LATENCY_METRIC_COUNT = static_cast<size_t>( LatencyMetric::I2C_REQUEST_TO_REPLY );
+    const std::chrono::seconds LATENCY_PROBE_TIMEOUT = std::chrono::seconds( 1 );
+    const std::chrono::seconds FIRMWARE_QUERY_TIMEOUT = std::chrono::seconds( 1 );
+    const std::chrono::milliseconds CAPABILITY_QUERY_TIMEOUT = std::chrono::milliseconds( 300 );
+    static const uint32_t MAX_CAPABILITY_QUERIES = 30;
 
     //initialized state member
     std::atomic_bool _initialized;
@@ -231,8 +633,14 @@ private:
     //a reference to the UAP firmata interface
     Firmata::UwpFirmata ^_firmata;
 
-    //a mutex for thread safety
-    std::recursive_mutex _device_mutex;
+    //the stream given to the constructor, re-opened by auto-reconnect
+    Serial::IStream ^_serial_connection;
+
+    //a mutex for thread safety, timed so that contention shows up in getMetrics
+    Firmata::TimedMutex<std::recursive_mutex> _device_mutex;
+
+    //events raised to subscribers: DigitalPinUpdated, AnalogPinUpdated, SysexMessageReceived, StringMessageReceived
+    std::array<std::atomic<uint64_t>, 4> _events_raised;
 
     //state-tracking cache variables
     std::array<std::atomic_uint8_t, MAX_PORTS> _subscribed_ports;
@@ -240,6 +648,117 @@ private:
     std::array<std::atomic_uint16_t, MAX_ANALOG_PINS> _analog_pins;
     std::array<std::atomic_uint8_t, MAX_PINS> _pin_mode;
 
+    //state last sent to the device, used to suppress redundant commands; guarded by _device_mutex
+    std::atomic_bool _suppress_redundant_commands;
+    std::atomic<uint64_t> _suppressed_commands;
+    std::bitset<MAX_PINS> _pin_mode_sent;
+    std::array<int16_t, MAX_PORTS> _digital_port_sent;
+
+    //latest-value slots for ReportDeliveryMode::COALESCED, each packing a 48-bit sequence number above a 16-bit value
+    std::atomic<ReportDeliveryMode> _report_delivery_mode;
+    std::array<std::atomic<uint64_t>, MAX_ANALOG_PINS> _analog_report_slots;
+    std::array<std::atomic<uint64_t>, MAX_PORTS> _digital_report_slots;
+
+    //one bit per analog pin / digital port with a report waiting to be delivered
+    std::atomic_uint32_t _analog_reports_pending;
+    std::atomic_uint32_t _digital_reports_pending;
+    std::atomic_bool _report_delivery_scheduled;
+    std::atomic<uint64_t> _coalesced_reports;
+
+    //state last delivered to subscribers, only touched by deliverCoalescedReports
+    std::array<uint64_t, MAX_ANALOG_PINS> _analog_delivered_sequence;
+    std::array<uint64_t, MAX_PORTS> _digital_delivered_sequence;
+    std::array<uint8_t, MAX_PORTS> _digital_delivered_state;
+
+    //the sampling interval last sent, and whether one has been sent at all
+    std::atomic<uint16_t> _sampling_interval;
+    std::atomic_bool _sampling_interval_sent;
+
+    //adaptive sampling state, guarded by _sampling_mutex
+    std::mutex _sampling_mutex;
+    Windows::System::Threading::ThreadPoolTimer ^_sampling_timer;
+    double _sampling_target_bytes_per_second;
+    uint16_t _min_sampling_interval;
+    uint16_t _max_sampling_interval;
+    uint64_t _sampled_bytes;
+    std::chrono::steady_clock::time_point _sampled_time;
+
+    //round-trip latency histograms indexed by LatencyMetric; I2C requests are timed by TwoWire
+    std::array<LatencyHistogram, DEVICE_LATENCY_METRIC_COUNT> _latency;
+    PendingRequest _latency_probe_pending;
+
+    //auto-reconnect settings and the state of a reconnection, guarded by _reconnect_mutex
+    std::mutex _reconnect_mutex;
+    bool _auto_reconnect;
+    uint32_t _reconnect_baud;
+    Serial::SerialConfig _reconnect_config;
+    Windows::Foundation::TimeSpan _reconnect_interval;
+    Windows::System::Threading::ThreadPoolTimer ^_reconnect_timer;
+    bool _restore_pending;
+    std::chrono::steady_clock::time_point _connection_lost_time;
+    std::atomic<uint64_t> _reconnects;
+    std::atomic<uint64_t> _last_restore_ns;
+
+    //the payload of the latest REPORT_FIRMWARE reply, which identifies the firmware, guarded by _firmware_mutex
+    std::mutex _firmware_mutex;
+    std::condition_variable _firmware_condition;
+    std::vector<uint8_t> _firmware_identity;
+    uint64_t _firmware_replies;
+
+    //the firmware's name and version as reported, and as the key of its cached profile; guarded by _firmware_mutex
+    std::wstring _firmware_name;
+    uint8_t _firmware_major;
+    uint8_t _firmware_minor;
+    std::string _firmware_key;
+
+    //profiles of known firmware, see enableHardwareProfileCache; guarded by _device_mutex, and shared with the stores still writing it
+    std::shared_ptr<HardwareProfileCache> _profile_cache;
+
+    //whether the hardware profile in use came from the device's capability response rather than the cache
+    std::atomic_bool _profile_verified;
+
+    //whether the verified profile has been handed to the cache since the device was last initialized or the cache replaced
+    std::atomic_bool _profile_stored;
+
+    //the progress of the handshake, guarded by _handshake_mutex; initialize() signals _handshake_condition
+    std::mutex _handshake_mutex;
+    std::condition_variable _handshake_condition;
+    std::chrono::steady_clock::time_point _handshake_start;
+    uint64_t _handshake_firmware_ns;
+    uint64_t _handshake_capability_ns;
+    uint64_t _handshake_ready_ns;
+    uint32_t _capability_queries;
+    bool _handshake_from_cache;
+
+    //handlers are only added once however many times the connection is (re-)established
+    std::atomic_bool _handshake_subscribed;
+    bool _reports_subscribed;
+
+    //sends echo probes while running, see startLatencyProbe
+    std::thread _probe_thread;
+    std::mutex _probe_mutex;
+    std::condition_variable _probe_condition;
+    bool _probe_should_exit;
+    std::chrono::milliseconds _probe_interval;
+
+    //re-opens the stream after the connection has been lost, see enableAutoReconnect
+    void
+    attemptReconnect(
+        void
+    );
+
+    //raises the pending coalesced reports until none remain
+    void
+    deliverCoalescedReports(
+        void
+    );
+
+    //measures inbound traffic and moves the sampling interval toward the adaptive sampling target
+    void
+    adaptSamplingInterval(
+        void
+    );
+
     //maps the given pin number to the correct port and mask
     void
     getPinMap(
@@ -259,6 +778,84 @@ private:
         Platform::String^ string_
     );
 
+    //sends echo probes until stopLatencyProbe is called
+    void
+    probeThread(
+        void
+    );
+
+    //records the time from the start of the handshake to now in phase_ns_, unless the phase has already completed
+    void
+    markHandshakePhase(
+        uint64_t &phase_ns_
+    );
+
+    //initializes the device from the cached profile of the firmware it reported, or caches the profile the device reported earlier
+    void
+    onFirmwareReported(
+        const std::string &firmware_
+    );
+
+    //asks the firmware to identify itself and returns the reply, or an empty identity if none arrives in time
+    std::vector<uint8_t>
+    queryFirmwareIdentity(
+        void
+    );
+
+    //raises DeviceReady, recording the time taken to restore a lost connection
+    void
+    raiseDeviceReady(
+        void
+    );
+
+    //brings a reconnected device back to the cached state, or repeats the handshake if its firmware has changed
+    void
+    restoreDeviceState(
+        void
+    );
+
+    //queries the pin capabilities until the device is initialized, then raises DeviceReady or DeviceConnectionFailed
+    void
+    startHandshake(
+        void
+    );
+
+    //writes every pin mode, port subscription, digital port value and sampling interval the device has been sent into the open frame;
+    //the caller holds _device_mutex and the Firmata lock, and flushes
+    void
+    writeDeviceState(
+        void
+    );
+
+    //stores the profile in the cache without blocking the calling thread
+    void
+    storeHardwareProfile(
+        std::shared_ptr<HardwareProfileCache> cache_,
+        const std::string &firmware_,
+        HardwareProfileCache::Profile pins_
+    );
+
+    //raises DigitalPinUpdated for each pin of the port set in changed_mask_
+    void
+    raiseDigitalPinEvents(
+        uint8_t port_,
+        uint8_t port_val_,
+        uint8_t changed_mask_
+    );
+
+    //sends the sampling interval to the device without touching the adaptive sampling state
+    void
+    sendSamplingInterval(
+        uint16_t interval_millis_
+    );
+
+    //marks a coalesced report as pending and makes sure a delivery is scheduled
+    void
+    scheduleCoalescedReport(
+        std::atomic_uint32_t &pending_,
+        uint8_t index_
+    );
+
     //connection callbacks
     void
     onConnectionReady(
@@ -25,9 +25,108 @@
 #include "pch.h"
 #include "TwoWire.h"
 
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <robuffer.h>
+#include <wrl/client.h>
+
 using namespace Microsoft::Maker::Firmata;
 using namespace Microsoft::Maker::RemoteWiring::I2c;
 
+namespace {
+    Windows::Storage::Streams::IBuffer ^
+    toBuffer(
+        const uint8_t *data_,
+        size_t length_
+    )
+    {
+        Windows::Storage::Streams::DataWriter ^writer = ref new Windows::Storage::Streams::DataWriter();
+        if( length_ ) { writer->WriteBytes( Platform::ArrayReference<uint8_t>( const_cast<uint8_t *>( data_ ), static_cast<unsigned int>( length_ ) ) ); }
+        return writer->DetachBuffer();
+    }
+
+    //returns the bytes of the buffer in place, or nullptr if the buffer does not expose them
+    const uint8_t *
+    bufferBytes(
+        Windows::Storage::Streams::IBuffer ^buffer_
+    )
+    {
+        Microsoft::WRL::ComPtr<Windows::Storage::Streams::IBufferByteAccess> access;
+        uint8_t *bytes = nullptr;
+        if( SUCCEEDED( reinterpret_cast<IInspectable *>( buffer_ )->QueryInterface( IID_PPV_ARGS( &access ) ) ) )
+        {
+            access->Buffer( &bytes );
+        }
+
+        return bytes;
+    }
+
+    Platform::Exception ^
+    failureFor(
+        I2cScheduler::Result result_
+    )
+    {
+        if( result_ == I2cScheduler::Result::TIMED_OUT )
+        {
+            return ref new Platform::COMException( HRESULT_FROM_WIN32( ERROR_TIMEOUT ), L"No I2C reply was received before the read timed out." );
+        }
+
+        if( result_ == I2cScheduler::Result::FAILED )
+        {
+            return ref new Platform::COMException( E_FAIL, L"The I2C request could not be sent." );
+        }
+
+        return ref new Platform::OperationCanceledException();
+    }
+}
+
+
+//******************************************************************************
+//* I2cBatch
+//******************************************************************************
+
+void
+I2cBatch::read(
+    uint8_t address_,
+    uint8_t reg_,
+    uint8_t numBytes_
+    )
+{
+    I2cScheduler::Operation operation;
+    operation.address = address_;
+    operation.reg = reg_;
+    operation.read_length = numBytes_;
+    _operations.push_back( std::move( operation ) );
+}
+
+
+void
+I2cBatch::write(
+    uint8_t address_,
+    Windows::Storage::Streams::IBuffer ^data_
+    )
+{
+    I2cScheduler::Operation operation;
+    operation.address = address_;
+    operation.reg = 0;
+    operation.read_length = 0;
+
+    if( data_ != nullptr && data_->Length )
+    {
+        auto bytes = ref new Platform::Array<uint8_t>( data_->Length );
+        Windows::Storage::Streams::DataReader::FromBuffer( data_ )->ReadBytes( bytes );
+        operation.data.assign( bytes->begin(), bytes->end() );
+    }
+
+    _operations.push_back( std::move( operation ) );
+}
+
+
+//******************************************************************************
+//* TwoWire
+//******************************************************************************
+
 void
 TwoWire::enable(
     uint16_t i2cReadDelayMicros_
@@ -51,7 +150,7 @@ TwoWire::beginTransmission(
 {
     if( _address ) return;
     _address = address_;
-    _position = 0;
+    _transmission.clear();
 }
 
 void
@@ -59,9 +158,8 @@ TwoWire::write(
     uint8_t data_
     )
 {
-    if( !_address || _position > MAX_MESSAGE_LEN ) return;
-    _data_buffer.get()[_position] = data_;
-    ++_position;
+    if( !_address ) return;
+    _transmission.push_back( data_ );
 }
 
 
@@ -71,9 +169,348 @@ TwoWire::endTransmission(
     )
 {
     if( !_address ) return;
-    sendI2cSysex( _address, 0, _position, _data_buffer.get() );
+
+    //the transmission is over whether or not it could be sent
+    try
+    {
+        //the bytes are sent as they are, so nothing is assumed about how the device addresses them; a longer transfer to a
+        //register-addressed device is split by writeBlockAsync
+        if( _transmission.size() > MAX_TRANSMISSION_BYTES )
+        {
+            throw ref new Platform::Exception( E_INVALIDARG, L"The transmission is longer than one I2C request can carry." );
+        }
+
+        sendI2cSysex( _address, 0, static_cast<uint8_t>( _transmission.size() ), _transmission.data() );
+    }
+    catch( ... )
+    {
+        _address = 0;
+        _transmission.clear();
+        throw;
+    }
+
     _address = 0;
-    _position = 0;
+    _transmission.clear();
+}
+
+
+I2cSamples ^
+TwoWire::drainSamples(
+    uint8_t address_,
+    uint8_t reg_,
+    uint32_t max_samples_
+    )
+{
+    std::shared_ptr<I2cSampleRing> ring;
+
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _continuous_mutex );
+        for( ContinuousRead &read : _continuous_reads )
+        {
+            if( read.address == address_ && read.reg == reg_ ) { ring = read.ring; break; }
+        }
+    }
+
+    if( !ring ) return nullptr;
+
+    //one allocation for the payloads and one for the timestamps, however many samples are drained
+    size_t count = ( std::min )( ring->available(), static_cast<size_t>( max_samples_ ) );
+    auto data = ref new Platform::Array<uint8_t>( static_cast<unsigned int>( count * ring->sampleLength() ) );
+    std::vector<I2cSampleRing::clock::time_point> times( count );
+    count = ring->drain( data->Data, times.data(), count );
+
+    auto timestamps = ref new Platform::Array<int64_t>( static_cast<unsigned int>( count ) );
+    for( size_t i = 0; i < count; ++i )
+    {
+        timestamps[static_cast<unsigned int>( i )] = std::chrono::duration_cast<std::chrono::microseconds>( times[i].time_since_epoch() ).count();
+    }
+
+    Windows::Storage::Streams::DataWriter ^writer = ref new Windows::Storage::Streams::DataWriter();
+    writer->WriteBytes( data );
+    return ref new I2cSamples( static_cast<uint32_t>( count ), static_cast<uint32_t>( ring->sampleLength() ), ring->dropped(), writer->DetachBuffer(), timestamps );
+}
+
+
+Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer ^> ^
+TwoWire::readAsync(
+    uint8_t address_,
+    uint8_t reg_,
+    uint8_t numBytes_,
+    uint32_t timeout_millis_
+    )
+{
+    Concurrency::task_completion_event<Windows::Storage::Streams::IBuffer ^> reply_event;
+
+    std::vector<I2cScheduler::Operation> operations( 1 );
+    I2cScheduler::Operation &read = operations.back();
+    read.address = address_;
+    read.reg = reg_;
+    read.read_length = numBytes_;
+    read.completion = [ reply_event ]( I2cScheduler::Result result_, const uint8_t *data_, size_t length_ ) -> void
+    {
+        if( result_ == I2cScheduler::Result::COMPLETED )
+        {
+            reply_event.set( toBuffer( data_, length_ ) );
+        }
+        else
+        {
+            reply_event.set_exception( failureFor( result_ ) );
+        }
+    };
+
+    _scheduler->submit( std::move( operations ), std::chrono::milliseconds( timeout_millis_ ) );
+    expireAfter( timeout_millis_ );
+
+    return Concurrency::create_async( [ reply_event ]() -> Concurrency::task<Windows::Storage::Streams::IBuffer ^> { return Concurrency::create_task( reply_event ); } );
+}
+
+
+Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer ^> ^
+TwoWire::readBlockAsync(
+    uint8_t address_,
+    uint8_t reg_,
+    uint32_t length_,
+    uint32_t timeout_millis_
+    )
+{
+    //registers are addressed with one byte, so a block running past 0xFF would wrap around to register 0
+    if( reg_ + static_cast<uint64_t>( length_ ) > 0x100 )
+    {
+        throw ref new Platform::Exception( E_INVALIDARG, L"The block extends past register 0xFF." );
+    }
+
+    //each chunk's reply is copied to its place in the result, which is handed out once the last chunk completes
+    struct BlockState
+    {
+        std::mutex mutex;
+        std::vector<uint8_t> data;
+        size_t remaining;
+        I2cScheduler::Result failure;
+        Concurrency::task_completion_event<Windows::Storage::Streams::IBuffer ^> reply_event;
+    };
+
+    size_t chunk_bytes = _chunk_bytes;
+    auto state = std::make_shared<BlockState>();
+    state->data.resize( length_ );
+    state->remaining = ( length_ + chunk_bytes - 1 ) / chunk_bytes;
+    state->failure = I2cScheduler::Result::COMPLETED;
+
+    if( !length_ )
+    {
+        state->reply_event.set( toBuffer( nullptr, 0 ) );
+    }
+
+    std::vector<I2cScheduler::Operation> operations;
+    operations.reserve( state->remaining );
+    for( size_t offset = 0; offset < length_; offset += chunk_bytes )
+    {
+        size_t chunk_length = ( std::min )( chunk_bytes, length_ - offset );
+
+        I2cScheduler::Operation read;
+        read.address = address_;
+        read.reg = static_cast<uint8_t>( reg_ + offset );
+        read.read_length = static_cast<uint8_t>( chunk_length );
+        read.completion = [ state, offset, chunk_length ]( I2cScheduler::Result result_, const uint8_t *data_, size_t reply_length_ ) -> void
+        {
+            std::lock_guard<std::mutex> lock( state->mutex );
+            if( result_ != I2cScheduler::Result::COMPLETED )
+            {
+                state->failure = result_;
+            }
+            else if( reply_length_ )
+            {
+                std::memcpy( state->data.data() + offset, data_, ( std::min )( reply_length_, chunk_length ) );
+            }
+
+            if( --state->remaining ) return;
+
+            if( state->failure != I2cScheduler::Result::COMPLETED )
+            {
+                state->reply_event.set_exception( failureFor( state->failure ) );
+            }
+            else
+            {
+                state->reply_event.set( toBuffer( state->data.data(), state->data.size() ) );
+            }
+        };
+        operations.push_back( std::move( read ) );
+    }
+
+    if( !operations.empty() )
+    {
+        _scheduler->submit( std::move( operations ), std::chrono::milliseconds( timeout_millis_ ) );
+        expireAfter( timeout_millis_ );
+    }
+
+    Concurrency::task_completion_event<Windows::Storage::Streams::IBuffer ^> reply_event = state->reply_event;
+    return Concurrency::create_async( [ reply_event ]() -> Concurrency::task<Windows::Storage::Streams::IBuffer ^> { return Concurrency::create_task( reply_event ); } );
+}
+
+
+Windows::Foundation::IAsyncAction ^
+TwoWire::writeBlockAsync(
+    uint8_t address_,
+    uint8_t reg_,
+    Windows::Storage::Streams::IBuffer ^data_
+    )
+{
+    std::vector<uint8_t> bytes;
+    if( data_ != nullptr && data_->Length )
+    {
+        auto array = ref new Platform::Array<uint8_t>( data_->Length );
+        Windows::Storage::Streams::DataReader::FromBuffer( data_ )->ReadBytes( array );
+        bytes.assign( array->begin(), array->end() );
+    }
+
+    std::vector<I2cScheduler::Operation> operations = splitWrite( address_, reg_, bytes.data(), bytes.size() );
+
+    //writes complete as they are sent, in order, so the last chunk completes the transfer
+    Concurrency::task_completion_event<void> sent_event;
+    operations.back().completion = [ sent_event ]( I2cScheduler::Result result_, const uint8_t *, size_t ) -> void
+    {
+        if( result_ == I2cScheduler::Result::COMPLETED )
+        {
+            sent_event.set();
+        }
+        else
+        {
+            sent_event.set_exception( failureFor( result_ ) );
+        }
+    };
+
+    _scheduler->submit( std::move( operations ), std::chrono::milliseconds( DEFAULT_READ_TIMEOUT_MILLIS ) );
+    return Concurrency::create_async( [ sent_event ]() -> Concurrency::task<void> { return Concurrency::create_task( sent_event ); } );
+}
+
+
+void
+TwoWire::setTransferChunkSize(
+    uint8_t chunk_bytes_
+    )
+{
+    _chunk_bytes = ( std::min )( ( std::max )( static_cast<size_t>( chunk_bytes_ ), static_cast<size_t>( 1 ) ), MAX_CHUNK_BYTES );
+}
+
+
+void
+TwoWire::setRequestWindow(
+    uint8_t window_
+    )
+{
+    _scheduler->setWindow( window_ );
+}
+
+
+void
+TwoWire::startContinuousRead(
+    uint8_t address_,
+    uint8_t reg_,
+    uint8_t numBytes_,
+    uint32_t capacity_
+    )
+{
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _continuous_mutex );
+        for( ContinuousRead &read : _continuous_reads )
+        {
+            if( read.address == address_ && read.reg == reg_ ) return;
+        }
+
+        //the ring is in place before the request is sent, so the first reply is never missed
+        ContinuousRead read;
+        read.address = address_;
+        read.reg = reg_;
+        read.ring = std::make_shared<I2cSampleRing>( capacity_, numBytes_ );
+        _continuous_reads.push_back( std::move( read ) );
+    }
+
+    uint8_t request[] = { reg_, numBytes_ };
+    sendI2cSysex( address_, I2C_READ_CONTINUOUSLY, sizeof( request ), request );
+}
+
+
+void
+TwoWire::stopContinuousRead(
+    uint8_t address_,
+    uint8_t reg_
+    )
+{
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _continuous_mutex );
+        auto read = std::find_if( _continuous_reads.begin(), _continuous_reads.end(), [ address_, reg_ ]( const ContinuousRead &read_ ) -> bool { return read_.address == address_ && read_.reg == reg_; } );
+        if( read == _continuous_reads.end() ) return;
+
+        _continuous_reads.erase( read );
+    }
+
+    //the firmware stops continuous reads by address
+    sendI2cSysex( address_, I2C_STOP_READING, 0, nullptr );
+}
+
+
+Windows::Foundation::IAsyncOperation<Windows::Foundation::Collections::IVectorView<Windows::Storage::Streams::IBuffer ^> ^> ^
+TwoWire::submitAsync(
+    I2cBatch ^batch_,
+    uint32_t timeout_millis_
+    )
+{
+    typedef Windows::Foundation::Collections::IVectorView<Windows::Storage::Streams::IBuffer ^> ResultView;
+
+    //gathers the result of each operation and completes the batch with the last of them
+    struct BatchState
+    {
+        std::mutex mutex;
+        std::vector<Windows::Storage::Streams::IBuffer ^> results;
+        size_t remaining;
+        I2cScheduler::Result failure;
+        Concurrency::task_completion_event<ResultView ^> reply_event;
+    };
+
+    auto state = std::make_shared<BatchState>();
+    std::vector<I2cScheduler::Operation> operations;
+    if( batch_ != nullptr ) { operations = batch_->operations(); }
+    state->results.resize( operations.size(), nullptr );
+    state->remaining = operations.size();
+    state->failure = I2cScheduler::Result::COMPLETED;
+
+    if( operations.empty() )
+    {
+        state->reply_event.set( ( ref new Platform::Collections::Vector<Windows::Storage::Streams::IBuffer ^>() )->GetView() );
+    }
+
+    for( size_t i = 0; i < operations.size(); ++i )
+    {
+        bool is_read = ( operations[i].read_length != 0 );
+        operations[i].completion = [ state, i, is_read ]( I2cScheduler::Result result_, const uint8_t *data_, size_t length_ ) -> void
+        {
+            std::lock_guard<std::mutex> lock( state->mutex );
+            if( result_ != I2cScheduler::Result::COMPLETED )
+            {
+                state->failure = result_;
+            }
+            else if( is_read )
+            {
+                state->results[i] = toBuffer( data_, length_ );
+            }
+
+            if( --state->remaining ) return;
+
+            if( state->failure != I2cScheduler::Result::COMPLETED )
+            {
+                state->reply_event.set_exception( failureFor( state->failure ) );
+            }
+            else
+            {
+                state->reply_event.set( ( ref new Platform::Collections::Vector<Windows::Storage::Streams::IBuffer ^>( std::move( state->results ) ) )->GetView() );
+            }
+        };
+    }
+
+    _scheduler->submit( std::move( operations ), std::chrono::milliseconds( timeout_millis_ ) );
+    expireAfter( timeout_millis_ );
+
+    Concurrency::task_completion_event<ResultView ^> reply_event = state->reply_event;
+    return Concurrency::create_async( [ reply_event ]() -> Concurrency::task<ResultView ^> { return Concurrency::create_task( reply_event ); } );
 }
 
 
@@ -81,6 +518,87 @@ TwoWire::endTransmission(
 //* Private Methods
 //******************************************************************************
 
+void
+TwoWire::expireAfter(
+    uint32_t timeout_millis_
+    )
+{
+    //the timer holds a reference to this object until it fires, and fires a millisecond late so it never runs before the deadline it checks
+    TwoWire ^wire = this;
+    Windows::Foundation::TimeSpan timeout;
+    timeout.Duration = ( static_cast<int64_t>( timeout_millis_ ) + 1 ) * 10000LL;   //100 nanosecond units
+    Windows::System::Threading::ThreadPoolTimer::CreateTimer( ref new Windows::System::Threading::TimerElapsedHandler( [ wire ]( Windows::System::Threading::ThreadPoolTimer ^timer_ ) -> void
+    {
+        wire->_scheduler->expire( I2cScheduler::clock::now() );
+    } ), timeout );
+}
+
+
+std::vector<I2cScheduler::Operation>
+TwoWire::splitWrite(
+    uint8_t address_,
+    uint8_t reg_,
+    const uint8_t *data_,
+    size_t length_
+    )
+{
+    //as for reads, a write past register 0xFF would wrap around to register 0
+    if( reg_ + static_cast<uint64_t>( length_ ) > 0x100 )
+    {
+        throw ref new Platform::Exception( E_INVALIDARG, L"The block extends past register 0xFF." );
+    }
+
+    size_t chunk_bytes = _chunk_bytes;
+    std::vector<I2cScheduler::Operation> operations;
+
+    //a write of no data still selects the register, so at least one request is always produced
+    size_t offset = 0;
+    do
+    {
+        size_t chunk_length = ( std::min )( chunk_bytes, length_ - offset );
+
+        I2cScheduler::Operation write;
+        write.address = address_;
+        write.reg = static_cast<uint8_t>( reg_ + offset );
+        write.read_length = 0;
+        write.data.reserve( chunk_length + 1 );
+        write.data.push_back( write.reg );
+        write.data.insert( write.data.end(), data_ + offset, data_ + offset + chunk_length );
+        write.completion = []( I2cScheduler::Result, const uint8_t *, size_t ) -> void {};
+        operations.push_back( std::move( write ) );
+
+        offset += chunk_length;
+    } while( offset < length_ );
+
+    return operations;
+}
+
+
+void
+TwoWire::sendI2cRequests(
+    const std::vector<I2cScheduler::Request> &requests_
+    )
+{
+    //the requests are written under one lock and flushed together, so they reach the transport as a single frame
+    _firmata->lock();
+    try
+    {
+        for( const I2cScheduler::Request &request : requests_ )
+        {
+            writeI2cRequest( request.address, request.rw_mask, request.payload.size(), request.payload.data() );
+        }
+
+        _firmata->flush();
+        _firmata->unlock();
+    }
+    catch( ... )
+    {
+        _firmata->unlock();
+        throw;
+    }
+}
+
+
 void
 TwoWire::sendI2cSysex(
     const uint8_t address_,
@@ -92,34 +610,89 @@ TwoWire::sendI2cSysex(
     _firmata->lock();
     try
     {
-        _firmata->write( static_cast<uint8_t>( Command::START_SYSEX ) );
-        _firmata->write( static_cast<uint8_t>( Microsoft::Maker::Firmata::SysexCommand::I2C_REQUEST ) );
-        _firmata->write( address_ );
-        _firmata->write( rw_mask_ );
-
-        if( data_ != nullptr )
-        {
-            for( size_t i = 0; i < len_; ++i )
-            {
-                _firmata->sendValueAsTwo7bitBytes( data_[i] );
-            }
-        }
-
-        _firmata->write( static_cast<uint8_t>( Command::END_SYSEX ) );
+        writeI2cRequest( address_, rw_mask_, len_, data_ );
         _firmata->flush();
         _firmata->unlock();
     }
     catch( ... )
     {
         _firmata->unlock();
+        throw;
     }
 }
 
 
+void
+TwoWire::writeI2cRequest(
+    const uint8_t address_,
+    const uint8_t rw_mask_,
+    const size_t len_,
+    const uint8_t *data_
+    )
+{
+    //a one-time read is answered by a single reply, so it can be timed
+    if( rw_mask_ == 0x08 )
+    {
+        PendingRequest &pending = _pending_reads[address_ & 0x7F];
+        auto now = LatencyHistogram::clock::now();
+        LatencyHistogram::clock::time_point sent;
+
+        //a read left unanswered for longer than a read may wait is abandoned, rather than timing this one from when it was sent
+        if( pending.outstanding( sent ) && ( now - sent ) >= std::chrono::milliseconds( DEFAULT_READ_TIMEOUT_MILLIS ) ) { pending.clear(); }
+        pending.mark( now );
+    }
+
+    _firmata->write( static_cast<uint8_t>( Command::START_SYSEX ) );
+    _firmata->write( static_cast<uint8_t>( Microsoft::Maker::Firmata::SysexCommand::I2C_REQUEST ) );
+    _firmata->write( address_ );
+    _firmata->write( rw_mask_ );
+
+    if( data_ != nullptr && len_ )
+    {
+        _firmata->sendBytesAsTwo7bitBytes( Platform::ArrayReference<uint8_t>( const_cast<uint8_t *>( data_ ), static_cast<unsigned int>( len_ ) ) );
+    }
+
+    _firmata->write( static_cast<uint8_t>( Command::END_SYSEX ) );
+}
+
+
 void
 TwoWire::onI2cReply(
     I2cCallbackEventArgs ^args
     )
 {
+    auto now = LatencyHistogram::clock::now();
+    uint8_t address = args->getAddress();
+    uint8_t reg = args->getRegister();
+
+    //the payload is read in place where the buffer allows it, and copied out otherwise
+    Windows::Storage::Streams::IBuffer ^buffer = args->getDataBuffer();
+    size_t length = buffer->Length;
+    const uint8_t *data = bufferBytes( buffer );
+    Platform::Array<uint8_t> ^copy = nullptr;
+    if( data == nullptr && length )
+    {
+        copy = ref new Platform::Array<uint8_t>( buffer->Length );
+        Windows::Storage::Streams::DataReader::FromBuffer( buffer )->ReadBytes( copy );
+        data = copy->Data;
+    }
+
+    //replies to a continuous read go straight into its ring and raise no event
+    {   //critical section
+        std::lock_guard<std::mutex> lock( _continuous_mutex );
+        for( ContinuousRead &read : _continuous_reads )
+        {
+            if( read.address != address || read.reg != reg ) continue;
+
+            read.ring->push( now, data, length );
+            return;
+        }
+    }
+
+    _pending_reads[address & 0x7F].complete( now, _request_latency );
+
+    //replies are passed on even with nothing in flight, so a late reply to a read which timed out is recognised and discarded
+    _scheduler->onReply( address, reg, data, length );
+
     I2cReplyEvent( args->getAddress(), args->getRegister(), Windows::Storage::Streams::DataReader::FromBuffer( args->getDataBuffer() ) );
 }
@@ -22,7 +22,14 @@
     THE SOFTWARE.
 */
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "I2cSampleRing.h"
+#include "I2cScheduler.h"
+#include "LatencyHistogram.h"
 
 namespace Microsoft {
 namespace Maker {
@@ -34,6 +41,106 @@ namespace I2c {
 
 public delegate void I2cReplyCallback( uint8_t address_, uint8_t reg_, Windows::Storage::Streams::DataReader ^response );
 
+///<summary>
+///A sequence of I2C operations submitted together with TwoWire::submitAsync, which sends them back-to-back.
+///</summary>
+public ref class I2cBatch sealed
+{
+public:
+    I2cBatch(
+        void
+        )
+    {
+    }
+
+    //number of operations in the batch
+    property uint32_t Count { uint32_t get() { return static_cast<uint32_t>( _operations.size() ); } }
+
+    ///<summary>
+    ///Adds a read of numBytes_ bytes from a register of the device at address_.
+    ///</summary>
+    void
+    read(
+        uint8_t address_,
+        uint8_t reg_,
+        uint8_t numBytes_
+    );
+
+    ///<summary>
+    ///Adds a write of the given bytes to the device at address_; as with write( uint8_t ), a register is given as the first byte.
+    ///</summary>
+    void
+    write(
+        uint8_t address_,
+        Windows::Storage::Streams::IBuffer ^data_
+    );
+
+internal:
+    std::vector<I2cScheduler::Operation> &
+    operations(
+        void
+        )
+    {
+        return _operations;
+    }
+
+private:
+    std::vector<I2cScheduler::Operation> _operations;
+};
+
+///<summary>
+///Samples drained from a continuous read, see TwoWire::startContinuousRead.
+///</summary>
+public ref class I2cSamples sealed
+{
+public:
+    //number of samples drained
+    property uint32_t Count { uint32_t get() { return _count; } }
+
+    //bytes in each sample
+    property uint32_t SampleLength { uint32_t get() { return _sample_length; } }
+
+    //samples dropped since the read started because the ring was full
+    property uint64_t DroppedSamples { uint64_t get() { return _dropped; } }
+
+    //the samples back-to-back, oldest first, SampleLength bytes each
+    property Windows::Storage::Streams::IBuffer ^ Data { Windows::Storage::Streams::IBuffer ^ get() { return _data; } }
+
+    ///<summary>
+    ///Returns the time each sample was received, in microseconds of a monotonic clock.
+    ///</summary>
+    Platform::Array<int64_t> ^
+    getTimestamps(
+        void
+        )
+    {
+        return _timestamps;
+    }
+
+internal:
+    I2cSamples(
+        uint32_t count_,
+        uint32_t sample_length_,
+        uint64_t dropped_,
+        Windows::Storage::Streams::IBuffer ^data_,
+        Platform::Array<int64_t> ^timestamps_
+    ) :
+        _count( count_ ),
+        _sample_length( sample_length_ ),
+        _dropped( dropped_ ),
+        _data( data_ ),
+        _timestamps( timestamps_ )
+    {
+    }
+
+private:
+    uint32_t _count;
+    uint32_t _sample_length;
+    uint64_t _dropped;
+    Windows::Storage::Streams::IBuffer ^_data;
+    Platform::Array<int64_t> ^_timestamps;
+};
+
 public ref class TwoWire sealed
 {
 public:
@@ -75,6 +182,8 @@ public:
     ///<summary>
     ///Writes raw byte data to the device
     ///<para>You must have an active device transmission open. Begin a new transmission with beginTransmission( uint8_t )</para>
+    ///<para>A transmission is sent as a single I2C request, so it may hold at most 30 bytes; use writeBlockAsync to write more to
+    ///consecutive registers.</para>
     ///</summary>
     void
     write(
@@ -84,6 +193,8 @@ public:
 
     ///<summary>
     ///ends an I2C transmission
+    ///<para>Throws E_INVALIDARG if more than 30 bytes were written, or another error if the transmission could not be sent; it is
+    ///discarded either way.</para>
     ///</summary>
     void
     endTransmission(
@@ -106,18 +217,192 @@ public:
         sendI2cSysex( address_, 0x08, 1, &numBytes_ );
     }
 
+
+    ///<summary>
+    ///Asks the firmware to read numBytes_ bytes from a register of the device at every sampling interval until stopContinuousRead is called.
+    ///<para>Each reply is stored, with the time it arrived, in a ring of capacity_ samples allocated up front and is not raised as an
+    ///I2cReplyEvent; collect the samples in bulk with drainSamples. Samples arriving while the ring is full are dropped and counted.</para>
+    ///</summary>
+    void
+    startContinuousRead(
+        uint8_t address_,
+        uint8_t reg_,
+        uint8_t numBytes_,
+        uint32_t capacity_
+    );
+
+
+    ///<summary>
+    ///Stops a continuous read started by startContinuousRead. Samples not yet drained are discarded.
+    ///<para>The firmware stops continuous reads by address, so this stops the first continuous read it holds for the device.</para>
+    ///</summary>
+    void
+    stopContinuousRead(
+        uint8_t address_,
+        uint8_t reg_
+    );
+
+
+    ///<summary>
+    ///Removes up to max_samples_ samples of a continuous read, oldest first, or returns nullptr if no such read is running.
+    ///</summary>
+    I2cSamples ^
+    drainSamples(
+        uint8_t address_,
+        uint8_t reg_,
+        uint32_t max_samples_
+    );
+
+
+    ///<summary>
+    ///Reads the given number of bytes from a register of the device, completing with the reply to this read.
+    ///<para>Replies are matched to reads by address and register, so reads of different devices and registers may be in flight at the
+    ///same time. The reply is also raised as an I2cReplyEvent. Fails with a timeout error if no reply arrives within one second.</para>
+    ///</summary>
+    inline
+    Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer ^> ^
+    readAsync(
+        uint8_t address_,
+        uint8_t reg_,
+        uint8_t numBytes_
+        )
+    {
+        return readAsync( address_, reg_, numBytes_, DEFAULT_READ_TIMEOUT_MILLIS );
+    }
+
+
+    ///<summary>
+    ///Reads the given number of bytes from a register of the device, completing with the reply to this read.
+    ///<para>Fails with a timeout error if no reply arrives within timeout_millis_ milliseconds.</para>
+    ///</summary>
+    Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer ^> ^
+    readAsync(
+        uint8_t address_,
+        uint8_t reg_,
+        uint8_t numBytes_,
+        uint32_t timeout_millis_
+    );
+
+
+    ///<summary>
+    ///Sends the operations of the batch back-to-back, completing with one buffer per operation in batch order: the reply for each read and
+    ///nullptr for each write. Fails with a timeout error if any read is not answered within one second.
+    ///</summary>
+    inline
+    Windows::Foundation::IAsyncOperation<Windows::Foundation::Collections::IVectorView<Windows::Storage::Streams::IBuffer ^> ^> ^
+    submitAsync(
+        I2cBatch ^batch_
+        )
+    {
+        return submitAsync( batch_, DEFAULT_READ_TIMEOUT_MILLIS );
+    }
+
+
+    ///<summary>
+    ///Sends the operations of the batch back-to-back, behind any operations already submitted, completing with one buffer per operation in
+    ///batch order: the reply for each read and nullptr for each write.
+    ///<para>Reads from any number of threads are pipelined up to the request window; see setRequestWindow. Fails with a timeout error if
+    ///any read is not answered within timeout_millis_ milliseconds of the batch being submitted.</para>
+    ///</summary>
+    Windows::Foundation::IAsyncOperation<Windows::Foundation::Collections::IVectorView<Windows::Storage::Streams::IBuffer ^> ^> ^
+    submitAsync(
+        I2cBatch ^batch_,
+        uint32_t timeout_millis_
+    );
+
+
+    ///<summary>
+    ///Reads length_ bytes starting at a register of the device, completing with all of them in one buffer. Fails with a timeout error
+    ///if any chunk is not answered within one second.
+    ///</summary>
+    inline
+    Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer ^> ^
+    readBlockAsync(
+        uint8_t address_,
+        uint8_t reg_,
+        uint32_t length_
+        )
+    {
+        return readBlockAsync( address_, reg_, length_, DEFAULT_READ_TIMEOUT_MILLIS );
+    }
+
+
+    ///<summary>
+    ///Reads length_ bytes starting at a register of the device, completing with all of them in one buffer.
+    ///<para>The transfer is split into reads of at most the transfer chunk size, each from the register following the last; the reads are
+    ///pipelined through the request window and their replies reassembled in order. Fails with a timeout error if any chunk is not answered
+    ///within timeout_millis_ milliseconds, or with E_FAIL if the reads could not be sent.</para>
+    ///<para>Throws E_INVALIDARG if the block would extend past register 0xFF.</para>
+    ///</summary>
+    Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer ^> ^
+    readBlockAsync(
+        uint8_t address_,
+        uint8_t reg_,
+        uint32_t length_,
+        uint32_t timeout_millis_
+    );
+
+
+    ///<summary>
+    ///Writes the given bytes starting at a register of the device.
+    ///<para>The transfer is split into writes of at most the transfer chunk size, each prefixed with the register following the last, and
+    ///the writes are sent back-to-back behind any operations already submitted. Completes once every chunk has been sent, or fails with
+    ///E_FAIL if they could not be sent.</para>
+    ///<para>Throws E_INVALIDARG if the block would extend past register 0xFF.</para>
+    ///</summary>
+    Windows::Foundation::IAsyncAction ^
+    writeBlockAsync(
+        uint8_t address_,
+        uint8_t reg_,
+        Windows::Storage::Streams::IBuffer ^data_
+    );
+
+
+    ///<summary>
+    ///Sets the largest number of data bytes carried by one I2C request when a transfer is split, between 1 and 29 (the most a request
+    ///can carry besides its register within the 64 byte sysex buffer of StandardFirmata). The default is 16; boards with smaller I2C
+    ///buffers need less.
+    ///</summary>
+    void
+    setTransferChunkSize(
+        uint8_t chunk_bytes_
+    );
+
+
+    ///<summary>
+    ///Sets how many reads started by readAsync or submitAsync may await their reply at once; further reads wait in order for a reply to
+    ///free a slot. Size the window so the requests fit the firmware's receive buffer. The default is 4.
+    ///</summary>
+    void
+    setRequestWindow(
+        uint8_t window_
+    );
+
 private:
     //since 16 bit values are sent as two 7 bit bytes, you can't send a value larger than this across the wire
     const uint16_t MAX_READ_DELAY_MICROS = 0x3FFF;
-    const size_t MAX_MESSAGE_LEN = 15;
+    const size_t DEFAULT_CHUNK_BYTES = 16;
+    //StandardFirmata buffers the command, address and mode, then each byte of the request as two 7 bit bytes, in 64 bytes: 30 bytes
+    //in all, which for a split transfer is the register and 29 data bytes
+    const size_t MAX_TRANSMISSION_BYTES = 30;
+    const size_t MAX_CHUNK_BYTES = MAX_TRANSMISSION_BYTES - 1;
+    const uint32_t DEFAULT_READ_TIMEOUT_MILLIS = 1000;
+    const size_t DEFAULT_REQUEST_WINDOW = 4;
+
+    //read/write mode bits of I2C_REQUEST
+    const uint8_t I2C_READ_CONTINUOUSLY = 0x10;
+    const uint8_t I2C_STOP_READING = 0x18;
 
     //singleton pattern w/ friend class to instantiate
     TwoWire(
         Firmata::UwpFirmata ^ firmata_
         ) :
-        _data_buffer( new uint8_t[ MAX_MESSAGE_LEN ] ),
-        _firmata( firmata_ )
+        _firmata( firmata_ ),
+        _address( 0 ),
+        _chunk_bytes( DEFAULT_CHUNK_BYTES ),
+        _scheduler( new I2cScheduler( [ this ]( const std::vector<I2cScheduler::Request> &requests_ ) -> void { sendI2cRequests( requests_ ); }, DEFAULT_REQUEST_WINDOW ) )
     {
+        _transmission.reserve( MAX_TRANSMISSION_BYTES );
         _firmata->I2cReplyReceived += ref new Firmata::I2cReplyCallbackFunction( [this]( Firmata::UwpFirmata ^caller, Firmata::I2cCallbackEventArgs^ args ) -> void { onI2cReply( args ); } );
     }
     
@@ -126,8 +411,46 @@ private:
 
     //transmission-building variables
     uint8_t _address;
-    uint8_t _position;
-    std::unique_ptr<uint8_t> _data_buffer;
+    std::vector<uint8_t> _transmission;
+
+    //most data bytes sent in one I2C request, see setTransferChunkSize
+    std::atomic<size_t> _chunk_bytes;
+
+    //times each one-time read until the reply from its address arrives, queried through RemoteDevice::getLatencyStatistics
+    LatencyHistogram _request_latency;
+    std::array<PendingRequest, 0x80> _pending_reads;
+
+    //pipelines the operations started by readAsync and submitAsync and correlates their replies
+    std::unique_ptr<I2cScheduler> _scheduler;
+
+    //continuous reads and the rings their replies are stored in
+    struct ContinuousRead
+    {
+        uint8_t address;
+        uint8_t reg;
+        std::shared_ptr<I2cSampleRing> ring;
+    };
+
+    std::mutex _continuous_mutex;
+    std::vector<ContinuousRead> _continuous_reads;
+
+    void
+    expireAfter(
+        uint32_t timeout_millis_
+    );
+
+    std::vector<I2cScheduler::Operation>
+    splitWrite(
+        uint8_t address_,
+        uint8_t reg_,
+        const uint8_t *data_,
+        size_t length_
+    );
+
+    void
+    sendI2cRequests(
+        const std::vector<I2cScheduler::Request> &requests_
+    );
 
     void
     sendI2cSysex(
@@ -137,6 +460,14 @@ private:
         uint8_t *data_
     );
 
+    void
+    writeI2cRequest(
+        const uint8_t address_,
+        const uint8_t rw_mask_,
+        const size_t len_,
+        const uint8_t *data_
+    );
+
     void
     onI2cReply(
         Firmata::I2cCallbackEventArgs ^argv